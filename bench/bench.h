@@ -0,0 +1,113 @@
+/*
+ * bench.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BODHI_BENCH_H
+#define BODHI_BENCH_H
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+typedef enum _bench_dist_t {
+    BENCH_UNIFORM,
+    BENCH_ZIPF,
+    BENCH_SEQ
+} bench_dist_t;
+
+typedef struct _bench_opts_t {
+    size_t count;
+    bench_dist_t dist;
+    /* 0 leaves it to the suite */
+    int threads;
+    int json;
+} bench_opts_t;
+
+/*
+ * Latency is sampled: every BENCH_SAMPLE'th operation is timed on its own,
+ * the rest run back to back so the sampling barely shows in ops/sec.
+ */
+#define BENCH_SAMPLE 64
+
+typedef struct _bench_lat_t {
+    double *samples;
+    size_t count;
+    size_t alloc;
+} bench_lat_t;
+
+#define BENCH_OP(lat, i, stmt) do {                                            \
+    if (((i) & (BENCH_SAMPLE - 1)) == 0) {                                      \
+        double bench_t_ = bench_now();                                          \
+        stmt;                                                                   \
+        bench_lat_add(lat, bench_now() - bench_t_);                             \
+    } else {                                                                    \
+        stmt;                                                                   \
+    }                                                                           \
+} while (0)
+
+typedef struct _bench_suite_t {
+    const char *name;
+    void (*run)(const bench_opts_t *opts);
+} bench_suite_t;
+
+double bench_now(void);
+uint64_t bench_rand(uint64_t *state);
+void bench_report(const char *suite, const char *op, size_t ops, double secs);
+void bench_report_lat(const char *suite, const char *op, size_t ops, double secs, bench_lat_t *lat);
+
+void bench_lat_init(bench_lat_t *lat, size_t ops);
+void bench_lat_add(bench_lat_t *lat, double secs);
+void bench_lat_free(bench_lat_t *lat);
+
+/*
+ * Keys are a bijection of their index (or the index itself for seq), so
+ * indices 0..n-1 are the keys present and n.. are sure misses. Queries pick
+ * indices following the distribution.
+ */
+uint32_t bench_mix32(uint32_t x);
+uint64_t bench_mix64(uint64_t x);
+uint32_t bench_key32(const bench_opts_t *opts, size_t i);
+uint64_t bench_key64(const bench_opts_t *opts, size_t i);
+void bench_queries(const bench_opts_t *opts, size_t *idx, size_t count, size_t n, uint64_t seed);
+
+typedef void (*bench_thread_fn)(void *arg, int thread, bench_lat_t *lat);
+double bench_parallel(int threads, bench_thread_fn fn, void *arg, size_t ops, bench_lat_t *lat);
+
+void bench_list(const bench_opts_t *opts);
+void bench_hmap(const bench_opts_t *opts);
+
+void bench_patricia(const bench_opts_t *opts);
+void bench_patricia64(const bench_opts_t *opts);
+void bench_patricia128(const bench_opts_t *opts);
+void bench_patricia_batch(const bench_opts_t *opts);
+void bench_cpatricia(const bench_opts_t *opts);
+void bench_ipatricia(const bench_opts_t *opts);
+void bench_snapshot(const bench_opts_t *opts);
+void bench_bulk(const bench_opts_t *opts);
+void bench_art(const bench_opts_t *opts);
+void bench_setops(const bench_opts_t *opts);
+void bench_typed(const bench_opts_t *opts);
+void bench_filter(const bench_opts_t *opts);
+void bench_heap(const bench_opts_t *opts);
+void bench_hamt(const bench_opts_t *opts);
+void bench_teardown(const bench_opts_t *opts);
+void bench_intern(const bench_opts_t *opts);
+void bench_rsort(const bench_opts_t *opts);
+void bench_btree(const bench_opts_t *opts);
+void bench_foreach(const bench_opts_t *opts);
+void bench_omap(const bench_opts_t *opts);
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * bench_art.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libbodhi/art.h>
+#include <libbodhi/hmap.h>
+
+#include "bench.h"
+
+/* fnv-1a over a nul terminated key */
+static size_t str_hash(void *key) {
+    const unsigned char *p = key;
+    size_t h = (size_t) 14695981039346656037ull;
+
+    while (*p != '\0') {
+        h = (h ^ *p++) * (size_t) 1099511628211ull;
+    }
+
+    return h;
+}
+
+static int str_cmp(const void *a, const void *b) {
+    return strcmp(a, b);
+}
+
+static void no_free(void *p) {
+    (void) p;
+}
+
+static int count_cb(const unsigned char *key, size_t len, void *val, void *udata) {
+    (void) key;
+    (void) len;
+    (void) val;
+    (*(size_t *) udata)++;
+    return 0;
+}
+
+/* path-like keys sharing long prefixes, the case the radix tree is for */
+void bench_art(const bench_opts_t *opts) {
+    bodhi_art_t *art = bodhi_art_new();
+    bodhi_hmap_t *hmap = bodhi_hmap_new(str_hash, str_cmp, no_free, no_free);
+    size_t n = opts->count;
+    char **keys, **miss;
+    size_t *lens;
+    uint64_t state = 1;
+    size_t i;
+    size_t found = 0;
+    double start;
+
+    keys = malloc(n * sizeof(char *));
+    miss = malloc(n * sizeof(char *));
+    lens = malloc(n * sizeof(size_t));
+    for (i = 0; i < n; i++) {
+        uint64_t r = bench_rand(&state);
+        char buf[64];
+
+        lens[i] = (size_t) sprintf(buf, "/srv/%u/metrics/%08lx", (unsigned int) (r % 64),
+                                   (unsigned long) i);
+        keys[i] = strdup(buf);
+        sprintf(buf, "/srv/%u/metrics/%08lx!", (unsigned int) (r % 64), (unsigned long) i);
+        miss[i] = strdup(buf);
+    }
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_art_insert(art, keys[i], lens[i], keys[i]);
+    }
+    bench_report("bodhi_art", "insert", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_hmap_insert_no_cpy(hmap, keys[i], keys[i]);
+    }
+    bench_report("bodhi_hmap", "insert", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += bodhi_art_find_val(art, keys[i], lens[i]) != NULL;
+    }
+    bench_report("bodhi_art", "lookup_hit", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += bodhi_hmap_value(hmap, keys[i]) != NULL;
+    }
+    bench_report("bodhi_hmap", "lookup_hit", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += bodhi_art_find_val(art, miss[i], lens[i] + 1) != NULL;
+    }
+    bench_report("bodhi_art", "lookup_miss", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += bodhi_hmap_value(hmap, miss[i]) != NULL;
+    }
+    bench_report("bodhi_hmap", "lookup_miss", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < 64; i++) {
+        char buf[32];
+        sprintf(buf, "/srv/%u/", (unsigned int) i);
+        bodhi_art_prefix(art, buf, strlen(buf), count_cb, &found);
+    }
+    bench_report("bodhi_art", "prefix_scan", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_art_delete(art, keys[i], lens[i], NULL);
+    }
+    bench_report("bodhi_art", "delete", n, bench_now() - start);
+
+    if (found == 0) {
+        printf("nothing found\n");
+    }
+
+    bodhi_art_free(art, NULL);
+    bodhi_hmap_free(hmap);
+    for (i = 0; i < n; i++) {
+        free(keys[i]);
+        free(miss[i]);
+    }
+    free(keys);
+    free(miss);
+    free(lens);
+}
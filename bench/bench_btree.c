@@ -0,0 +1,152 @@
+/*
+ * bench_btree.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libbodhi/btree.h>
+#include <libbodhi/patricia.h>
+
+#include "bench.h"
+
+/* range scans each cover about this many keys */
+#define SCAN_KEYS 100
+#define SCANS 10000
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+static int btree_visit(uint32_t key, void *val, void *udata) {
+    (void) key;
+    (void) val;
+    (void) udata;
+    return 0;
+}
+
+static int trie_visit(bodhi_patricia_t *node, void *udata) {
+    (void) node;
+    (void) udata;
+    return 0;
+}
+
+/* the B+-tree against bodhi_patricia_t: building, point lookups, range scans and bytes per key */
+void bench_btree(const bench_opts_t *opts) {
+    bodhi_patricia_stats_t stats;
+    bodhi_patricia_t *trie = bodhi_patricia_new_blank();
+    bodhi_btree_t *tree = bodhi_btree_new();
+    uint32_t *keys, *sorted;
+    size_t *idx;
+    size_t n = opts->count;
+    size_t i, uniq, visited, found = 0;
+    uint32_t width;
+    double start;
+
+    keys = malloc(n * sizeof(uint32_t));
+    sorted = malloc(n * sizeof(uint32_t));
+    idx = malloc(n * sizeof(size_t));
+    for (i = 0; i < n; i++) {
+        keys[i] = bench_key32(opts, i);
+    }
+    bench_queries(opts, idx, n, n, 3);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_btree_insert(tree, keys[i], &keys[i]);
+    }
+    bench_report("bodhi_btree", "insert", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_patricia_add(&trie, keys[i], &keys[i]);
+    }
+    bench_report("bodhi_patricia", "insert", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += bodhi_btree_find(tree, keys[idx[i]]) != NULL;
+    }
+    bench_report("bodhi_btree", "lookup_hit", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += bodhi_patricia_find_val(trie, keys[idx[i]]) != NULL;
+    }
+    bench_report("bodhi_patricia", "lookup_hit", n, bench_now() - start);
+
+    /* wide enough that the random keys give about SCAN_KEYS per range */
+    width = (uint32_t) (((uint64_t) 1 << 32) / (n + 1) * SCAN_KEYS);
+
+    visited = 0;
+    start = bench_now();
+    for (i = 0; i < SCANS; i++) {
+        uint32_t lo = keys[idx[i % n]];
+        visited += bodhi_btree_range(tree, lo, lo + width < lo ? UINT32_MAX : lo + width, btree_visit, NULL);
+    }
+    bench_report("bodhi_btree", "range_scan", visited, bench_now() - start);
+
+    visited = 0;
+    start = bench_now();
+    for (i = 0; i < SCANS; i++) {
+        uint32_t lo = keys[idx[i % n]];
+        visited += bodhi_patricia_range(trie, lo, lo + width < lo ? UINT32_MAX : lo + width, trie_visit, NULL);
+    }
+    bench_report("bodhi_patricia", "range_scan", visited, bench_now() - start);
+
+    bodhi_patricia_stats(trie, &stats);
+    printf("%-16s %-16s %12.1f bytes/key\n", "bodhi_btree", "memory",
+           (double) bodhi_btree_memory(tree) / (double) bodhi_btree_size(tree));
+    printf("%-16s %-16s %12.1f bytes/key\n", "bodhi_patricia", "memory",
+           (double) stats.memory / (double) stats.size);
+
+    bodhi_btree_free(tree, NULL);
+    bodhi_patricia_free(trie, NULL);
+
+    /* bulk loading from sorted keys, duplicates dropped */
+    memcpy(sorted, keys, n * sizeof(uint32_t));
+    qsort(sorted, n, sizeof(uint32_t), cmp_u32);
+    for (i = 1, uniq = n > 0; i < n; i++) {
+        if (sorted[i] != sorted[uniq - 1]) {
+            sorted[uniq++] = sorted[i];
+        }
+    }
+
+    start = bench_now();
+    tree = bodhi_btree_build_sorted(sorted, NULL, uniq);
+    bench_report("bodhi_btree", "build_sorted", uniq, bench_now() - start);
+    printf("%-16s %-16s %12.1f bytes/key\n", "bodhi_btree", "memory_bulk",
+           (double) bodhi_btree_memory(tree) / (double) bodhi_btree_size(tree));
+
+    start = bench_now();
+    trie = bodhi_patricia_build_sorted(sorted, NULL, uniq);
+    bench_report("bodhi_patricia", "build_sorted", uniq, bench_now() - start);
+
+    bodhi_btree_free(tree, NULL);
+    bodhi_patricia_free(trie, NULL);
+
+    if (found != 2 * n) {
+        printf("lookups found %lu of %lu\n", (unsigned long) found, (unsigned long) (2 * n));
+    }
+
+    free(keys);
+    free(sorted);
+    free(idx);
+}
@@ -0,0 +1,82 @@
+/*
+ * bench_bulk.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <libbodhi/ipatricia.h>
+#include <libbodhi/patricia.h>
+
+#include "bench.h"
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+/* loading sorted keys one add at a time against the bulk builders */
+void bench_bulk(const bench_opts_t *opts) {
+    bodhi_patricia_t *trie = bodhi_patricia_new_blank();
+    bodhi_ipatricia_t *itrie;
+    uint32_t *keys;
+    uint64_t state = 1;
+    size_t n = 0;
+    size_t i;
+    double start;
+    int threads = opts->threads > 0 ? opts->threads : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    char op[32];
+
+    keys = malloc(opts->count * sizeof(uint32_t));
+    for (i = 0; i < opts->count; i++) {
+        keys[i] = (uint32_t) bench_rand(&state);
+    }
+
+    qsort(keys, opts->count, sizeof(uint32_t), cmp_u32);
+    for (i = 0; i < opts->count; i++) {
+        if (n == 0 || keys[n - 1] != keys[i]) {
+            keys[n++] = keys[i];
+        }
+    }
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_patricia_add(&trie, keys[i], NULL);
+    }
+    bench_report("bodhi_patricia", "add_sorted", n, bench_now() - start);
+    bodhi_patricia_free(trie, NULL);
+
+    start = bench_now();
+    trie = bodhi_patricia_build_sorted(keys, NULL, n);
+    bench_report("bodhi_patricia", "build_sorted", n, bench_now() - start);
+    bodhi_patricia_free(trie, NULL);
+
+    start = bench_now();
+    trie = bodhi_patricia_build_sorted_parallel(keys, NULL, n, threads);
+    sprintf(op, "build_par_%d", threads);
+    bench_report("bodhi_patricia", op, n, bench_now() - start);
+    bodhi_patricia_free(trie, NULL);
+
+    start = bench_now();
+    itrie = bodhi_ipatricia_build_sorted(keys, NULL, n);
+    bench_report("bodhi_ipatricia", "build_sorted", n, bench_now() - start);
+    bodhi_ipatricia_free(itrie, NULL);
+
+    free(keys);
+}
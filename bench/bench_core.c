@@ -0,0 +1,316 @@
+/*
+ * bench_core.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libbodhi/hmap.h>
+#include <libbodhi/list.h>
+
+#include "bench.h"
+
+/* lookups and deletes on a list are linear, so only this many are timed */
+#define LIST_OPS 2000
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+static size_t hash_u32(void *key) {
+    return bench_mix32(*(const uint32_t *) key);
+}
+
+static void no_free(void *p) {
+    (void) p;
+}
+
+static int threads_of(const bench_opts_t *opts) {
+    return opts->threads > 0 ? opts->threads : 1;
+}
+
+/* the number of sorted runs merged by bench_list_merge */
+#define MERGE_RUNS 256
+
+static void bench_list_runs(uint32_t *keys, size_t n, bodhi_list_t **runs) {
+    size_t i;
+
+    memset(runs, 0, MERGE_RUNS * sizeof(bodhi_list_t *));
+    for (i = 0; i < n; i++) {
+        runs[i % MERGE_RUNS] = bodhi_list_add(runs[i % MERGE_RUNS], &keys[i]);
+    }
+    for (i = 0; i < MERGE_RUNS; i++) {
+        runs[i] = bodhi_list_msort(runs[i], cmp_u32);
+    }
+}
+
+/* compacting MERGE_RUNS sorted runs: one at a time with mmerge, merge_k, and the streaming merge */
+static void bench_list_merge(uint32_t *keys, size_t n) {
+    bodhi_list_t *runs[MERGE_RUNS];
+    bodhi_list_merge_t *merge;
+    bodhi_list_t *list = NULL;
+    size_t i, found = 0;
+    double start;
+
+    bench_list_runs(keys, n, runs);
+    start = bench_now();
+    for (i = 0; i < MERGE_RUNS; i++) {
+        list = bodhi_list_mmerge(list, runs[i], cmp_u32);
+    }
+    bench_report("bodhi_list", "merge_pairwise", n, bench_now() - start);
+    bodhi_list_free(list);
+
+    bench_list_runs(keys, n, runs);
+    start = bench_now();
+    list = bodhi_list_merge_k(runs, MERGE_RUNS, cmp_u32);
+    bench_report("bodhi_list", "merge_k", n, bench_now() - start);
+    bodhi_list_free(list);
+
+    bench_list_runs(keys, n, runs);
+    start = bench_now();
+    merge = bodhi_list_merge_new(runs, MERGE_RUNS, cmp_u32);
+    while (bodhi_list_merge_next(merge) != NULL) {
+        found++;
+    }
+    bodhi_list_merge_free(merge);
+    bench_report("bodhi_list", "merge_stream", n, bench_now() - start);
+
+    for (i = 0; i < MERGE_RUNS; i++) {
+        bodhi_list_free(runs[i]);
+    }
+
+    if (found != n) {
+        printf("merge_stream returned %lu of %lu\n", (unsigned long) found, (unsigned long) n);
+    }
+}
+
+void bench_list(const bench_opts_t *opts) {
+    bodhi_list_t *list = NULL;
+    bodhi_list_t *iter;
+    bench_lat_t lat;
+    uint32_t *keys;
+    size_t *idx;
+    size_t n = opts->count;
+    size_t ops = n < LIST_OPS ? n : LIST_OPS;
+    size_t i;
+    size_t found = 0;
+    uint32_t miss;
+    double start;
+
+    keys = malloc(n * sizeof(uint32_t));
+    idx = malloc(ops * sizeof(size_t));
+    for (i = 0; i < n; i++) {
+        keys[i] = bench_key32(opts, i);
+    }
+    bench_queries(opts, idx, ops, n, 2);
+
+    bench_lat_init(&lat, n);
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        BENCH_OP(&lat, i, list = bodhi_list_add(list, &keys[i]));
+    }
+    bench_report_lat("bodhi_list", "insert", n, bench_now() - start, &lat);
+    bench_lat_free(&lat);
+
+    bench_lat_init(&lat, ops);
+    start = bench_now();
+    for (i = 0; i < ops; i++) {
+        BENCH_OP(&lat, i, found += bodhi_list_find(list, &keys[idx[i]], cmp_u32) != NULL);
+    }
+    bench_report_lat("bodhi_list", "lookup_hit", ops, bench_now() - start, &lat);
+    bench_lat_free(&lat);
+
+    bench_lat_init(&lat, ops);
+    start = bench_now();
+    for (i = 0; i < ops; i++) {
+        miss = bench_key32(opts, n + i);
+        BENCH_OP(&lat, i, found += bodhi_list_find(list, &miss, cmp_u32) != NULL);
+    }
+    bench_report_lat("bodhi_list", "lookup_miss", ops, bench_now() - start, &lat);
+    bench_lat_free(&lat);
+
+    start = bench_now();
+    for (iter = list; iter != NULL; iter = iter->next) {
+        found += *(uint32_t *) iter->data & 1;
+    }
+    bench_report("bodhi_list", "iterate", n, bench_now() - start);
+
+    start = bench_now();
+    list = bodhi_list_msort(list, cmp_u32);
+    bench_report("bodhi_list", "sort", n, bench_now() - start);
+
+    bench_lat_init(&lat, ops);
+    start = bench_now();
+    for (i = 0; i < ops; i++) {
+        BENCH_OP(&lat, i, list = bodhi_list_remove(list, &keys[i], cmp_u32, NULL));
+    }
+    bench_report_lat("bodhi_list", "delete", ops, bench_now() - start, &lat);
+    bench_lat_free(&lat);
+
+    start = bench_now();
+    bodhi_list_free(list);
+    bench_report("bodhi_list", "free", n, bench_now() - start);
+
+    bench_list_merge(keys, n);
+
+    if (found == 0) {
+        printf("nothing found\n");
+    }
+
+    free(keys);
+    free(idx);
+}
+
+typedef struct _hmap_lookup_t {
+    bodhi_hmap_t *hmap;
+    uint32_t *keys;
+    const size_t *idx;
+    size_t count;
+} hmap_lookup_t;
+
+static void hmap_lookup(void *arg, int thread, bench_lat_t *lat) {
+    hmap_lookup_t *l = arg;
+    size_t i;
+
+    (void) thread;
+    for (i = 0; i < l->count; i++) {
+        BENCH_OP(lat, i, (void) bodhi_hmap_value(l->hmap, &l->keys[l->idx[i]]));
+    }
+}
+
+/* many maps of TINY_SIZE entries each, like per-request attributes */
+#define TINY_SIZE 6
+
+static void bench_hmap_tiny(uint32_t *keys, size_t n) {
+    size_t nmaps = n / TINY_SIZE;
+    bodhi_hmap_t **maps = malloc((nmaps + 1) * sizeof(bodhi_hmap_t *));
+    size_t i, j, found = 0;
+    double start;
+
+    start = bench_now();
+    for (i = 0; i < nmaps; i++) {
+        maps[i] = bodhi_hmap_new(hash_u32, cmp_u32, no_free, no_free);
+        for (j = 0; j < TINY_SIZE; j++) {
+            bodhi_hmap_insert_no_cpy(maps[i], &keys[i * TINY_SIZE + j], &keys[i * TINY_SIZE + j]);
+        }
+    }
+    bench_report("bodhi_hmap", "tiny_build", nmaps * TINY_SIZE, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < nmaps; i++) {
+        for (j = 0; j < TINY_SIZE; j++) {
+            found += bodhi_hmap_value(maps[i], &keys[i * TINY_SIZE + j]) != NULL;
+        }
+    }
+    bench_report("bodhi_hmap", "tiny_lookup", nmaps * TINY_SIZE, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < nmaps; i++) {
+        bodhi_hmap_free(maps[i]);
+    }
+    bench_report("bodhi_hmap", "tiny_free", nmaps * TINY_SIZE, bench_now() - start);
+
+    if (found != nmaps * TINY_SIZE) {
+        printf("tiny maps lost %lu keys\n", (unsigned long) (nmaps * TINY_SIZE - found));
+    }
+
+    free(maps);
+}
+
+void bench_hmap(const bench_opts_t *opts) {
+    bodhi_hmap_t *hmap = bodhi_hmap_new(hash_u32, cmp_u32, no_free, no_free);
+    bodhi_list_t *all, *iter;
+    hmap_lookup_t lookup;
+    bench_lat_t lat;
+    uint32_t *keys;
+    size_t *idx;
+    size_t n = opts->count;
+    size_t i;
+    size_t found = 0;
+    int threads = threads_of(opts);
+    double secs, start;
+
+    /* the second half of keys are misses */
+    keys = malloc(2 * n * sizeof(uint32_t));
+    idx = malloc(n * sizeof(size_t));
+    for (i = 0; i < 2 * n; i++) {
+        keys[i] = bench_key32(opts, i);
+    }
+    bench_queries(opts, idx, n, n, 2);
+
+    bench_lat_init(&lat, n);
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        BENCH_OP(&lat, i, bodhi_hmap_insert_no_cpy(hmap, &keys[i], &keys[i]));
+    }
+    bench_report_lat("bodhi_hmap", "insert", n, bench_now() - start, &lat);
+    bench_lat_free(&lat);
+
+    lookup.hmap = hmap;
+    lookup.keys = keys;
+    lookup.idx = idx;
+    lookup.count = n;
+    bench_lat_init(&lat, n * (size_t) threads);
+    secs = bench_parallel(threads, hmap_lookup, &lookup, n, &lat);
+    bench_report_lat("bodhi_hmap", "lookup_hit", n * (size_t) threads, secs, &lat);
+    bench_lat_free(&lat);
+
+    lookup.keys = keys + n;
+    bench_lat_init(&lat, n * (size_t) threads);
+    secs = bench_parallel(threads, hmap_lookup, &lookup, n, &lat);
+    bench_report_lat("bodhi_hmap", "lookup_miss", n * (size_t) threads, secs, &lat);
+    bench_lat_free(&lat);
+
+    start = bench_now();
+    all = bodhi_hmap_get_keys(hmap);
+    for (iter = all; iter != NULL; iter = iter->next) {
+        found += *(uint32_t *) iter->data & 1;
+    }
+    bodhi_list_free(all);
+    bench_report("bodhi_hmap", "iterate", n, bench_now() - start);
+
+    bench_lat_init(&lat, n);
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        BENCH_OP(&lat, i, bodhi_hmap_delete(hmap, &keys[i]));
+    }
+    bench_report_lat("bodhi_hmap", "delete", n, bench_now() - start, &lat);
+    bench_lat_free(&lat);
+
+    if (bodhi_hmap_size(hmap) != 0) {
+        bench_report("bodhi_hmap", "LEFT_OVER", bodhi_hmap_size(hmap), 0);
+    }
+
+    for (i = 0; i < n; i++) {
+        bodhi_hmap_insert_no_cpy(hmap, &keys[i], &keys[i]);
+    }
+    start = bench_now();
+    bodhi_hmap_free(hmap);
+    bench_report("bodhi_hmap", "free", n, bench_now() - start);
+
+    bench_hmap_tiny(keys, n);
+
+    if (found == 0) {
+        printf("nothing found\n");
+    }
+
+    free(keys);
+    free(idx);
+}
@@ -0,0 +1,183 @@
+/*
+ * bench_cpatricia.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <libbodhi/cpatricia.h>
+#include <libbodhi/patricia.h>
+
+#include "bench.h"
+
+#define LOOKUPS_PER_THREAD 2000000
+
+/*
+ * read throughput with 1..ncpu reader threads while a writer keeps adding
+ * and removing keys, for the lock free trie and for bodhi_patricia_t behind
+ * a reader-writer lock
+ */
+typedef struct _reader_arg_t {
+    bodhi_cpatricia_t *ctrie;
+    bodhi_patricia_t **trie;
+    pthread_rwlock_t *lock;
+    const uint32_t *keys;
+    size_t n;
+    uint64_t seed;
+    size_t found;
+} reader_arg_t;
+
+static volatile int writer_stop;
+
+static void *cpatricia_reader(void *p) {
+    reader_arg_t *arg = p;
+    bodhi_epoch_reader_t *reader = bodhi_cpatricia_reader(arg->ctrie);
+    uint64_t seed = arg->seed;
+    size_t found = 0;
+    size_t i;
+
+    /* counted locally, the args of neighbouring threads share cache lines */
+    for (i = 0; i < LOOKUPS_PER_THREAD; i++) {
+        bodhi_epoch_enter(reader);
+        found += bodhi_cpatricia_find_val(arg->ctrie, arg->keys[bench_rand(&seed) % arg->n]) != NULL;
+        bodhi_epoch_exit(reader);
+    }
+
+    bodhi_epoch_unregister(reader);
+    arg->found = found;
+    return NULL;
+}
+
+static void *rwlock_reader(void *p) {
+    reader_arg_t *arg = p;
+    uint64_t seed = arg->seed;
+    size_t found = 0;
+    size_t i;
+
+    for (i = 0; i < LOOKUPS_PER_THREAD; i++) {
+        pthread_rwlock_rdlock(arg->lock);
+        found += bodhi_patricia_find_val(*arg->trie, arg->keys[bench_rand(&seed) % arg->n]) != NULL;
+        pthread_rwlock_unlock(arg->lock);
+    }
+
+    arg->found = found;
+    return NULL;
+}
+
+static void *cpatricia_writer(void *p) {
+    reader_arg_t *arg = p;
+    uint32_t key;
+
+    while (!writer_stop) {
+        /* a key that was already there is one of the readers', leave it */
+        key = (uint32_t) bench_rand(&arg->seed);
+        if (bodhi_cpatricia_add(arg->ctrie, key, (void *) &writer_stop) == 1) {
+            bodhi_cpatricia_remove(arg->ctrie, key, NULL);
+        }
+        usleep(1000);
+    }
+
+    return NULL;
+}
+
+static void *rwlock_writer(void *p) {
+    reader_arg_t *arg = p;
+    uint32_t key;
+
+    while (!writer_stop) {
+        key = (uint32_t) bench_rand(&arg->seed);
+        pthread_rwlock_wrlock(arg->lock);
+        if (bodhi_patricia_add(arg->trie, key, (void *) &writer_stop) == 1) {
+            bodhi_patricia_remove(arg->trie, key, NULL);
+        }
+        pthread_rwlock_unlock(arg->lock);
+        usleep(1000);
+    }
+
+    return NULL;
+}
+
+static void run(const char *suite, void *(*reader)(void *), void *(*writer)(void *), reader_arg_t *tmpl,
+                int threads) {
+    pthread_t *tids = malloc((size_t) (threads + 1) * sizeof(pthread_t));
+    reader_arg_t *args = malloc((size_t) (threads + 1) * sizeof(reader_arg_t));
+    double start;
+    char op[32];
+    int i;
+
+    writer_stop = 0;
+    args[threads] = *tmpl;
+    pthread_create(&tids[threads], NULL, writer, &args[threads]);
+
+    start = bench_now();
+    for (i = 0; i < threads; i++) {
+        args[i] = *tmpl;
+        args[i].seed = (uint64_t) i + 2;
+        pthread_create(&tids[i], NULL, reader, &args[i]);
+    }
+
+    for (i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    sprintf(op, "read_%dthreads", threads);
+    bench_report(suite, op, (size_t) threads * LOOKUPS_PER_THREAD, bench_now() - start);
+
+    writer_stop = 1;
+    pthread_join(tids[threads], NULL);
+
+    free(tids);
+    free(args);
+}
+
+void bench_cpatricia(const bench_opts_t *opts) {
+    bodhi_patricia_t *trie = bodhi_patricia_new_blank();
+    pthread_rwlock_t lock;
+    reader_arg_t tmpl;
+    long ncpu = opts->threads > 0 ? opts->threads : sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t state = 1;
+    uint32_t *keys;
+    size_t i;
+    int threads;
+
+    keys = malloc(opts->count * sizeof(uint32_t));
+    tmpl.ctrie = bodhi_cpatricia_new((size_t) ncpu + 1);
+    for (i = 0; i < opts->count; i++) {
+        keys[i] = (uint32_t) bench_rand(&state);
+        bodhi_cpatricia_add(tmpl.ctrie, keys[i], &keys[i]);
+        bodhi_patricia_add(&trie, keys[i], &keys[i]);
+    }
+
+    pthread_rwlock_init(&lock, NULL);
+    tmpl.trie = &trie;
+    tmpl.lock = &lock;
+    tmpl.keys = keys;
+    tmpl.n = opts->count;
+    tmpl.seed = 1;
+    tmpl.found = 0;
+
+    for (threads = 1; threads <= ncpu; threads *= 2) {
+        run("bodhi_cpatricia", cpatricia_reader, cpatricia_writer, &tmpl, threads);
+        run("rwlock_patricia", rwlock_reader, rwlock_writer, &tmpl, threads);
+    }
+
+    pthread_rwlock_destroy(&lock);
+    bodhi_cpatricia_free(tmpl.ctrie, NULL);
+    bodhi_patricia_free(trie, NULL);
+    free(keys);
+}
@@ -0,0 +1,164 @@
+/*
+ * bench_filter.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libbodhi/bloom.h>
+#include <libbodhi/cuckoo.h>
+#include <libbodhi/hmap.h>
+
+#include "bench.h"
+
+#define FPR 0.01
+
+/* fnv-1a over a nul terminated key */
+static size_t str_hash(void *key) {
+    const unsigned char *p = key;
+    size_t h = (size_t) 14695981039346656037ull;
+
+    while (*p != '\0') {
+        h = (h ^ *p++) * (size_t) 1099511628211ull;
+    }
+
+    return h;
+}
+
+static int str_cmp(const void *a, const void *b) {
+    return strcmp(a, b);
+}
+
+static void no_free(void *p) {
+    (void) p;
+}
+
+static void bench_hmap_misses(const bench_opts_t *opts, char **keys, char **miss, double fpr) {
+    bodhi_hmap_t *hmap = bodhi_hmap_new(str_hash, str_cmp, no_free, no_free);
+    size_t n = opts->count;
+    size_t found = 0;
+    size_t i;
+    double start;
+
+    for (i = 0; i < n; i++) {
+        bodhi_hmap_insert_no_cpy(hmap, keys[i], keys[i]);
+    }
+
+    if (fpr > 0) {
+        bodhi_hmap_filter(hmap, fpr);
+    }
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += bodhi_hmap_value(hmap, miss[i]) != NULL;
+    }
+    bench_report(fpr > 0 ? "bodhi_hmap_filtered" : "bodhi_hmap", "lookup_miss", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += bodhi_hmap_value(hmap, keys[i]) != NULL;
+    }
+    bench_report(fpr > 0 ? "bodhi_hmap_filtered" : "bodhi_hmap", "lookup_hit", n, bench_now() - start);
+
+    if (found != n) {
+        fprintf(stderr, "bench_filter: found %lu of %lu\n", (unsigned long) found, (unsigned long) n);
+    }
+
+    bodhi_hmap_free(hmap);
+}
+
+/*
+ * keys are hashes already, the second half of them never added; the miss
+ * queries report the measured false positive rate in their name
+ */
+void bench_filter(const bench_opts_t *opts) {
+    bodhi_bloom_t *bloom = bodhi_bloom_new(opts->count, FPR);
+    bodhi_cuckoo_t *cuckoo = bodhi_cuckoo_new(opts->count, FPR);
+    size_t n = opts->count;
+    size_t positives;
+    uint64_t *keys;
+    char **skeys, **smiss;
+    size_t i;
+    double start;
+    char op[32];
+
+    keys = malloc(2 * n * sizeof(uint64_t));
+    for (i = 0; i < 2 * n; i++) {
+        keys[i] = bench_mix64(i);
+    }
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_bloom_add(bloom, keys[i]);
+    }
+    bench_report("bodhi_bloom", "add", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_cuckoo_add(cuckoo, keys[i]);
+    }
+    bench_report("bodhi_cuckoo", "add", n, bench_now() - start);
+
+    positives = 0;
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        positives += bodhi_bloom_maybe(bloom, keys[n + i]);
+    }
+    sprintf(op, "miss_fpr_%.4f", (double) positives / (double) n);
+    bench_report("bodhi_bloom", op, n, bench_now() - start);
+
+    positives = 0;
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        positives += bodhi_cuckoo_maybe(cuckoo, keys[n + i]);
+    }
+    sprintf(op, "miss_fpr_%.4f", (double) positives / (double) n);
+    bench_report("bodhi_cuckoo", op, n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_cuckoo_remove(cuckoo, keys[i]);
+    }
+    bench_report("bodhi_cuckoo", "remove", n, bench_now() - start);
+
+    bodhi_bloom_free(bloom);
+    bodhi_cuckoo_free(cuckoo);
+    free(keys);
+
+    /* string keys, where a miss that skips the chain saves real compares */
+    skeys = malloc(n * sizeof(char *));
+    smiss = malloc(n * sizeof(char *));
+    for (i = 0; i < n; i++) {
+        char buf[64];
+
+        sprintf(buf, "/srv/metrics/%016lx", (unsigned long) bench_mix64(i));
+        skeys[i] = strdup(buf);
+        sprintf(buf, "/srv/metrics/%016lx", (unsigned long) bench_mix64(n + i));
+        smiss[i] = strdup(buf);
+    }
+
+    bench_hmap_misses(opts, skeys, smiss, 0);
+    bench_hmap_misses(opts, skeys, smiss, FPR);
+
+    for (i = 0; i < n; i++) {
+        free(skeys[i]);
+        free(smiss[i]);
+    }
+    free(skeys);
+    free(smiss);
+}
@@ -0,0 +1,130 @@
+/*
+ * bench_foreach.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <libbodhi/hmap.h>
+#include <libbodhi/patricia.h>
+
+#include "bench.h"
+
+typedef struct _sum_t {
+    uint64_t sum;
+    uint64_t count;
+} sum_t;
+
+static size_t hash_u32(void *key) {
+    return bench_mix32(*(const uint32_t *) key);
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    return *(const uint32_t *) a != *(const uint32_t *) b;
+}
+
+static void hmap_each(void *key, void *val, void *acc, void *udata) {
+    sum_t *s = acc;
+
+    (void) val;
+    (void) udata;
+    s->sum += *(uint32_t *) key;
+    s->count++;
+}
+
+static void trie_each(bodhi_patricia_t *node, void *acc, void *udata) {
+    sum_t *s = acc;
+
+    (void) udata;
+    s->sum += bodhi_patricia_get_key(node);
+    s->count++;
+}
+
+static void trie_loop(bodhi_patricia_t *node, void *udata) {
+    trie_each(node, udata, NULL);
+}
+
+static void reduce(void *result, void *acc, void *udata) {
+    sum_t *r = result, *s = acc;
+
+    (void) udata;
+    r->sum += s->sum;
+    r->count += s->count;
+}
+
+/* summing every key of a map and a trie on one thread, then with 1..ncpu threads */
+void bench_foreach(const bench_opts_t *opts) {
+    bodhi_hmap_t *hmap = bodhi_hmap_new(hash_u32, cmp_u32, NULL, NULL);
+    bodhi_patricia_t *trie = bodhi_patricia_new_blank();
+    long ncpu = opts->threads > 0 ? opts->threads : sysconf(_SC_NPROCESSORS_ONLN);
+    bodhi_list_t *all, *iter;
+    uint32_t *keys;
+    size_t n = opts->count;
+    size_t i;
+    sum_t serial, sum;
+    double start;
+    char op[32];
+    int threads;
+
+    keys = malloc(n * sizeof(uint32_t));
+    for (i = 0; i < n; i++) {
+        keys[i] = bench_key32(opts, i);
+        bodhi_hmap_insert_no_cpy(hmap, &keys[i], &keys[i]);
+        bodhi_patricia_add(&trie, keys[i], &keys[i]);
+    }
+
+    serial.sum = serial.count = 0;
+    start = bench_now();
+    all = bodhi_hmap_get_keyvals(hmap);
+    for (iter = all; iter != NULL; iter = iter->next) {
+        hmap_each(((bodhi_hmap_keyval_t *) iter->data)->key, NULL, &serial, NULL);
+    }
+    bodhi_list_free(all);
+    bench_report("bodhi_hmap", "get_keyvals", n, bench_now() - start);
+
+    for (threads = 1; threads <= ncpu; threads *= 2) {
+        sum.sum = sum.count = 0;
+        start = bench_now();
+        bodhi_hmap_parallel_foreach(hmap, threads, hmap_each, sizeof(sum_t), reduce, &sum, NULL);
+        sprintf(op, "foreach_%dthreads", threads);
+        bench_report("bodhi_hmap", op, n, bench_now() - start);
+        if (sum.sum != serial.sum || sum.count != serial.count) {
+            fprintf(stderr, "bench_foreach: hmap sums differ with %d threads\n", threads);
+        }
+    }
+
+    serial.sum = serial.count = 0;
+    start = bench_now();
+    bodhi_patricia_loop(trie, trie_loop, &serial);
+    bench_report("bodhi_patricia", "loop", n, bench_now() - start);
+
+    for (threads = 1; threads <= ncpu; threads *= 2) {
+        sum.sum = sum.count = 0;
+        start = bench_now();
+        bodhi_patricia_parallel_foreach(trie, threads, trie_each, sizeof(sum_t), reduce, &sum, NULL);
+        sprintf(op, "foreach_%dthreads", threads);
+        bench_report("bodhi_patricia", op, n, bench_now() - start);
+        if (sum.sum != serial.sum || sum.count != serial.count) {
+            fprintf(stderr, "bench_foreach: patricia sums differ with %d threads\n", threads);
+        }
+    }
+
+    bodhi_hmap_free(hmap);
+    bodhi_patricia_free(trie, NULL);
+    free(keys);
+}
@@ -0,0 +1,123 @@
+/*
+ * bench_hamt.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libbodhi/hamt.h>
+#include <libbodhi/hmap.h>
+
+#include "bench.h"
+
+static int cmp_u64(const void *a, const void *b) {
+    return *(const uint64_t *) a != *(const uint64_t *) b;
+}
+
+static size_t hash_u64(void *key) {
+    return (size_t) bench_mix64(*(const uint64_t *) key);
+}
+
+/*
+ * the persistent map against bodhi_hmap_t, and what a point in time copy
+ * costs each: an O(1) snapshot plus path copies against a full key list
+ */
+void bench_hamt(const bench_opts_t *opts) {
+    bodhi_hamt_t *hamt = bodhi_hamt_new(hash_u64, cmp_u64, NULL, NULL);
+    bodhi_hamt_t *snap;
+    bodhi_hmap_t *hmap = bodhi_hmap_new(hash_u64, cmp_u64, NULL, NULL);
+    bodhi_list_t *copy;
+    uint64_t *keys;
+    size_t *idx;
+    size_t n = opts->count;
+    size_t i, found = 0;
+    size_t batch = n < 1000 ? n : 1000;
+    double start;
+
+    keys = malloc(2 * n * sizeof(uint64_t));
+    idx = malloc(n * sizeof(size_t));
+    for (i = 0; i < 2 * n; i++) {
+        keys[i] = bench_key64(opts, i);
+    }
+    bench_queries(opts, idx, n, n, 3);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_hamt_insert(hamt, &keys[i], &keys[i]);
+    }
+    bench_report("bodhi_hamt", "insert", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_hmap_insert_no_cpy(hmap, &keys[i], &keys[i]);
+    }
+    bench_report("bodhi_hmap", "insert", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += bodhi_hamt_value(hamt, &keys[idx[i]]) != NULL;
+    }
+    bench_report("bodhi_hamt", "lookup_hit", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += bodhi_hmap_value(hmap, &keys[idx[i]]) != NULL;
+    }
+    bench_report("bodhi_hmap", "lookup_hit", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += bodhi_hamt_value(hamt, &keys[n + i]) != NULL;
+    }
+    bench_report("bodhi_hamt", "lookup_miss", n, bench_now() - start);
+
+    start = bench_now();
+    copy = bodhi_hmap_get_keyvals(hmap);
+    bench_report("bodhi_hmap", "copy_keyvals", 1, bench_now() - start);
+    bodhi_list_free(copy);
+
+    start = bench_now();
+    snap = bodhi_hamt_snapshot(hamt);
+    bench_report("bodhi_hamt", "snapshot", 1, bench_now() - start);
+
+    /* the first updates after a snapshot copy their paths, later ones mostly do not */
+    start = bench_now();
+    for (i = 0; i < batch; i++) {
+        bodhi_hamt_delete(hamt, &keys[i]);
+    }
+    bench_report("bodhi_hamt", "delete_shared", batch, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < batch; i++) {
+        bodhi_hamt_insert(hamt, &keys[i], &keys[i]);
+    }
+    bench_report("bodhi_hamt", "insert_unshared", batch, bench_now() - start);
+
+    if (bodhi_hamt_size(snap) != n || bodhi_hamt_size(hamt) != n || found != 2 * n) {
+        fprintf(stderr, "bench_hamt: sizes %lu %lu, found %lu\n", (unsigned long) bodhi_hamt_size(snap),
+                (unsigned long) bodhi_hamt_size(hamt), (unsigned long) found);
+    }
+
+    start = bench_now();
+    bodhi_hamt_free(snap);
+    bodhi_hamt_free(hamt);
+    bench_report("bodhi_hamt", "free", n, bench_now() - start);
+
+    bodhi_hmap_free(hmap);
+    free(idx);
+    free(keys);
+}
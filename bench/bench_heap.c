@@ -0,0 +1,128 @@
+/*
+ * bench_heap.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libbodhi/heap.h>
+#include <libbodhi/list.h>
+#include <libbodhi/wheel.h>
+
+#include "bench.h"
+
+/* add_sorted is quadratic, its queue is kept to this many pending timers */
+#define LIST_MAX 20000
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+static void count_cb(void *data, void *udata) {
+    (void) data;
+    (*(size_t *) udata)++;
+}
+
+/* a timeout queue: schedule every deadline, then drain them in order */
+void bench_heap(const bench_opts_t *opts) {
+    bodhi_heap_t *heap;
+    bodhi_wheel_t *wheel;
+    bodhi_heap_node_t **handles;
+    void **items;
+    bodhi_list_t *list = NULL;
+    uint64_t *deadlines;
+    size_t n = opts->count;
+    size_t ln = n < LIST_MAX ? n : LIST_MAX;
+    size_t i, fired = 0;
+    double start;
+
+    deadlines = malloc(n * sizeof(uint64_t));
+    handles = malloc(n * sizeof(bodhi_heap_node_t *));
+    items = malloc(n * sizeof(void *));
+    for (i = 0; i < n; i++) {
+        deadlines[i] = bench_mix64(i) % ((uint64_t) 1 << 20);
+    }
+
+    start = bench_now();
+    for (i = 0; i < ln; i++) {
+        list = bodhi_list_add_sorted(list, &deadlines[i], cmp_u64);
+    }
+    bench_report("bodhi_list", "add_sorted", ln, bench_now() - start);
+    bodhi_list_free(list);
+
+    heap = bodhi_heap_new(cmp_u64, 0);
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        handles[i] = bodhi_heap_push(heap, &deadlines[i]);
+    }
+    bench_report("bodhi_heap", "push", n, bench_now() - start);
+
+    /* pushing deadlines later, as rescheduling a timeout does */
+    start = bench_now();
+    for (i = 0; i < n; i += 2) {
+        deadlines[i] += 1000;
+        bodhi_heap_update(heap, handles[i]);
+    }
+    bench_report("bodhi_heap", "update", n / 2, bench_now() - start);
+
+    start = bench_now();
+    while (bodhi_heap_pop(heap) != NULL) {
+        fired++;
+    }
+    bench_report("bodhi_heap", "pop", n, bench_now() - start);
+    bodhi_heap_free(heap, NULL);
+
+    heap = bodhi_heap_new(cmp_u64, 0);
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_heap_push(heap, &deadlines[i]);
+    }
+    bench_report("bodhi_heap", "heapify_by_push", n, bench_now() - start);
+    bodhi_heap_free(heap, NULL);
+
+    heap = bodhi_heap_new(cmp_u64, 0);
+    for (i = 0; i < n; i++) {
+        items[i] = &deadlines[i];
+    }
+    start = bench_now();
+    bodhi_heap_heapify(heap, items, n, NULL);
+    bench_report("bodhi_heap", "heapify", n, bench_now() - start);
+    bodhi_heap_free(heap, NULL);
+
+    wheel = bodhi_wheel_new(0);
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_wheel_add(wheel, deadlines[i], &deadlines[i]);
+    }
+    bench_report("bodhi_wheel", "add", n, bench_now() - start);
+
+    start = bench_now();
+    bodhi_wheel_advance(wheel, (uint64_t) 1 << 21, count_cb, &fired);
+    bench_report("bodhi_wheel", "advance", n, bench_now() - start);
+    bodhi_wheel_free(wheel, NULL);
+
+    /* popped from the heap once and fired by the wheel once */
+    if (fired != 2 * n) {
+        fprintf(stderr, "bench_heap: fired %lu of %lu\n", (unsigned long) fired, (unsigned long) 2 * n);
+    }
+
+    free(items);
+    free(handles);
+    free(deadlines);
+}
@@ -0,0 +1,124 @@
+/*
+ * bench_intern.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libbodhi/hmap.h>
+#include <libbodhi/intern.h>
+
+#include "bench.h"
+
+/* every distinct string shows up this many times on average */
+#define REPEAT 16
+
+/* fnv-1a over a nul terminated key */
+static size_t str_hash(void *key) {
+    const unsigned char *p = key;
+    size_t h = (size_t) 14695981039346656037ull;
+
+    while (*p != '\0') {
+        h = (h ^ *p++) * (size_t) 1099511628211ull;
+    }
+
+    return h;
+}
+
+static int str_cmp(const void *a, const void *b) {
+    return strcmp(a, b);
+}
+
+/*
+ * an ingestion loop counting hostnames: strdup'd keys compared with
+ * strcmp, against interning first and keying the map by pointer
+ */
+void bench_intern(const bench_opts_t *opts) {
+    bodhi_hmap_t *hmap = bodhi_hmap_new(str_hash, str_cmp, free, NULL);
+    bodhi_hmap_t *pmap = bodhi_hmap_new(bodhi_intern_hash, bodhi_intern_cmp, NULL, NULL);
+    bodhi_intern_t *intern = bodhi_intern_new();
+    const char **canonical;
+    char **input;
+    size_t n = opts->count;
+    size_t distinct = n / REPEAT + 1;
+    size_t *idx;
+    size_t i, found = 0;
+    double start;
+
+    input = malloc(n * sizeof(char *));
+    canonical = malloc(n * sizeof(char *));
+    idx = malloc(n * sizeof(size_t));
+    bench_queries(opts, idx, n, distinct, 4);
+    for (i = 0; i < n; i++) {
+        char buf[64];
+
+        sprintf(buf, "node-%08lx.rack%02u.example.com", (unsigned long) bench_mix64(idx[i]),
+                (unsigned int) (idx[i] % 64));
+        input[i] = strdup(buf);
+    }
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        if (bodhi_hmap_value(hmap, input[i]) == NULL) {
+            bodhi_hmap_insert_no_cpy(hmap, strdup(input[i]), input[i]);
+        }
+    }
+    bench_report("bodhi_hmap_strdup", "ingest", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        canonical[i] = bodhi_intern(intern, input[i]);
+        if (bodhi_hmap_value(pmap, (void *) canonical[i]) == NULL) {
+            bodhi_hmap_insert_no_cpy(pmap, (void *) canonical[i], input[i]);
+        }
+    }
+    bench_report("bodhi_intern", "ingest", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += bodhi_hmap_value(hmap, input[i]) != NULL;
+    }
+    bench_report("bodhi_hmap_strdup", "lookup", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += bodhi_hmap_value(pmap, (void *) canonical[i]) != NULL;
+    }
+    bench_report("bodhi_intern", "lookup_ptr", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += bodhi_intern_str(intern, bodhi_intern_id_of(canonical[i])) == canonical[i];
+    }
+    bench_report("bodhi_intern", "str_by_id", n, bench_now() - start);
+
+    if (found != 3 * n || bodhi_intern_size(intern) != bodhi_hmap_size(hmap)) {
+        fprintf(stderr, "bench_intern: found %lu, %lu strings against %lu keys\n", (unsigned long) found,
+                (unsigned long) bodhi_intern_size(intern), (unsigned long) bodhi_hmap_size(hmap));
+    }
+
+    bodhi_hmap_free(hmap);
+    bodhi_hmap_free(pmap);
+    bodhi_intern_free(intern);
+    for (i = 0; i < n; i++) {
+        free(input[i]);
+    }
+    free(input);
+    free(canonical);
+    free(idx);
+}
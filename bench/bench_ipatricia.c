@@ -0,0 +1,79 @@
+/*
+ * bench_ipatricia.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libbodhi/ipatricia.h>
+#include <libbodhi/patricia.h>
+
+#include "bench.h"
+
+/* the arena trie next to bodhi_patricia_t, including how long free takes */
+void bench_ipatricia(const bench_opts_t *opts) {
+    bodhi_ipatricia_t *itrie = bodhi_ipatricia_new();
+    bodhi_patricia_t *trie = bodhi_patricia_new_blank();
+    uint32_t *keys;
+    uint64_t state = 1;
+    size_t n = opts->count;
+    size_t i;
+    size_t found = 0;
+    double start;
+
+    keys = malloc(n * sizeof(uint32_t));
+    for (i = 0; i < n; i++) {
+        keys[i] = (uint32_t) bench_rand(&state);
+    }
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_ipatricia_add(itrie, keys[i], &keys[i]);
+    }
+    bench_report("bodhi_ipatricia", "insert", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_patricia_add(&trie, keys[i], &keys[i]);
+    }
+    bench_report("bodhi_patricia", "insert", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += bodhi_ipatricia_find_val(itrie, keys[i]) != NULL;
+    }
+    bench_report("bodhi_ipatricia", "lookup_hit", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += bodhi_patricia_find_val(trie, keys[i]) != NULL;
+    }
+    bench_report("bodhi_patricia", "lookup_hit", n, bench_now() - start);
+
+    printf("%-16s %-16s %12.1f bytes/key\n", "bodhi_ipatricia", "memory",
+           (double) bodhi_ipatricia_memory(itrie) / (double) bodhi_ipatricia_size(itrie));
+
+    start = bench_now();
+    bodhi_ipatricia_free(itrie, NULL);
+    bench_report("bodhi_ipatricia", "free", n, bench_now() - start);
+
+    start = bench_now();
+    bodhi_patricia_free(trie, NULL);
+    bench_report("bodhi_patricia", "free", n, bench_now() - start);
+
+    free(keys);
+}
@@ -0,0 +1,162 @@
+/*
+ * bench_omap.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libbodhi/hmap.h>
+#include <libbodhi/omap.h>
+
+#include "bench.h"
+
+static size_t hash_u32(void *key) {
+    return bench_mix32(*(const uint32_t *) key);
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    return *(const uint32_t *) a != *(const uint32_t *) b;
+}
+
+static int visit(void *key, void *val, void *udata) {
+    size_t *sum = udata;
+
+    (void) val;
+    *sum += *(uint32_t *) key;
+    return 0;
+}
+
+/*
+ * bytes per key of both maps after n/8, n/4, n/2 and n inserts, outside
+ * any timing; the growth steps show up as jumps between the rows
+ */
+static void report_memory(const uint32_t *keys, size_t n) {
+    bodhi_hmap_t *hmap = bodhi_hmap_new(hash_u32, cmp_u32, NULL, NULL);
+    bodhi_omap_t *omap = bodhi_omap_new(hash_u32, cmp_u32, NULL, NULL);
+    bodhi_hmap_stats_t stats;
+    size_t i = 0, at;
+    int step;
+    char label[32];
+
+    for (step = 3; step >= 0; step--) {
+        at = n >> step;
+        if (at == 0) {
+            continue;
+        }
+
+        for (; i < at; i++) {
+            bodhi_omap_insert(omap, (void *) &keys[i], (void *) &keys[i]);
+            bodhi_hmap_insert_no_cpy(hmap, (void *) &keys[i], (void *) &keys[i]);
+        }
+
+        bodhi_hmap_stats(hmap, &stats);
+        sprintf(label, "memory@%lu", (unsigned long) at);
+        printf("%-16s %-16s %12.1f bytes/key\n", "bodhi_omap", label,
+               (double) bodhi_omap_memory(omap) / (double) bodhi_omap_size(omap));
+        printf("%-16s %-16s %12.1f bytes/key\n", "bodhi_hmap", label,
+               (double) stats.memory / (double) stats.size);
+    }
+
+    bodhi_omap_free(omap);
+    bodhi_hmap_free(hmap);
+}
+
+/* the insertion ordered map next to bodhi_hmap_t, full scans and bytes per key included */
+void bench_omap(const bench_opts_t *opts) {
+    bodhi_hmap_t *hmap = bodhi_hmap_new(hash_u32, cmp_u32, NULL, NULL);
+    bodhi_omap_t *omap = bodhi_omap_new(hash_u32, cmp_u32, NULL, NULL);
+    bodhi_list_t *all, *iter;
+    uint32_t *keys;
+    size_t *idx;
+    size_t n = opts->count;
+    size_t i, found = 0, sum = 0;
+    double start;
+
+    keys = malloc(n * sizeof(uint32_t));
+    idx = malloc(n * sizeof(size_t));
+    for (i = 0; i < n; i++) {
+        keys[i] = bench_key32(opts, i);
+    }
+    bench_queries(opts, idx, n, n, 5);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_omap_insert(omap, &keys[i], &keys[i]);
+    }
+    bench_report("bodhi_omap", "insert", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_hmap_insert_no_cpy(hmap, &keys[i], &keys[i]);
+    }
+    bench_report("bodhi_hmap", "insert", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += bodhi_omap_value(omap, &keys[idx[i]]) != NULL;
+    }
+    bench_report("bodhi_omap", "lookup_hit", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += bodhi_hmap_value(hmap, &keys[idx[i]]) != NULL;
+    }
+    bench_report("bodhi_hmap", "lookup_hit", n, bench_now() - start);
+
+    start = bench_now();
+    bodhi_omap_loop(omap, visit, &sum);
+    bench_report("bodhi_omap", "loop", n, bench_now() - start);
+
+    start = bench_now();
+    all = bodhi_omap_get_keyvals(omap);
+    for (iter = all; iter != NULL; iter = iter->next) {
+        sum += *(uint32_t *) ((bodhi_hmap_keyval_t *) iter->data)->key;
+    }
+    bodhi_list_free(all);
+    bench_report("bodhi_omap", "get_keyvals", n, bench_now() - start);
+
+    start = bench_now();
+    all = bodhi_hmap_get_keyvals(hmap);
+    for (iter = all; iter != NULL; iter = iter->next) {
+        sum += *(uint32_t *) ((bodhi_hmap_keyval_t *) iter->data)->key;
+    }
+    bodhi_list_free(all);
+    bench_report("bodhi_hmap", "get_keyvals", n, bench_now() - start);
+
+    report_memory(keys, n);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_omap_delete(omap, &keys[i]);
+    }
+    bench_report("bodhi_omap", "delete", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_hmap_delete(hmap, &keys[i]);
+    }
+    bench_report("bodhi_hmap", "delete", n, bench_now() - start);
+
+    if (found != 2 * n || sum == 0) {
+        printf("lookups found %lu of %lu\n", (unsigned long) found, (unsigned long) (2 * n));
+    }
+
+    bodhi_omap_free(omap);
+    bodhi_hmap_free(hmap);
+    free(keys);
+    free(idx);
+}
@@ -0,0 +1,195 @@
+/*
+ * bench_patricia.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libbodhi/patricia.h>
+#include <libbodhi/patricia64.h>
+#include <libbodhi/patricia128.h>
+
+#include "bench.h"
+
+static uint32_t key32(uint64_t *state) {
+    return (uint32_t) bench_rand(state);
+}
+
+static bodhi_uint128_t key128_at(const bench_opts_t *opts, size_t i) {
+    bodhi_uint128_t k;
+
+    k.hi = opts->dist == BENCH_SEQ ? 0 : bench_mix64(~(uint64_t) i);
+    k.lo = bench_key64(opts, i);
+    return k;
+}
+
+/*
+ * the same benchmark for every key width: insert n keys, look them up
+ * (from opts->threads threads) in the order of the distribution, look up n
+ * keys that are not there, walk them in order, remove them and free a
+ * refilled trie
+ */
+#define BENCH_PATRICIA(name, prefix, trie_t, key_t, keygen)                    \
+typedef struct name##_lookup {                                                  \
+    trie_t *trie;                                                               \
+    const key_t *keys;                                                          \
+    const size_t *idx;                                                          \
+    size_t count;                                                               \
+} name##_lookup_t;                                                              \
+                                                                                \
+static void name##_lookup(void *arg, int thread, bench_lat_t *lat) {            \
+    name##_lookup_t *l = arg;                                                   \
+    size_t i;                                                                   \
+                                                                                \
+    (void) thread;                                                              \
+    for (i = 0; i < l->count; i++) {                                            \
+        BENCH_OP(lat, i, (void) prefix##_find_val(l->trie, l->keys[l->idx[i]])); \
+    }                                                                           \
+}                                                                               \
+                                                                                \
+static void name##_count(trie_t *node, void *udata) {                           \
+    (void) node;                                                                \
+    (*(size_t *) udata)++;                                                      \
+}                                                                               \
+                                                                                \
+void name(const bench_opts_t *opts) {                                           \
+    trie_t *trie = prefix##_new_blank();                                        \
+    name##_lookup_t lookup;                                                     \
+    bench_lat_t lat;                                                            \
+    key_t *keys;                                                                \
+    size_t *idx;                                                                \
+    size_t n = opts->count;                                                     \
+    size_t i;                                                                   \
+    size_t found = 0;                                                           \
+    int threads = opts->threads > 0 ? opts->threads : 1;                        \
+    double secs, start;                                                         \
+                                                                                \
+    keys = malloc(2 * n * sizeof(key_t));                                       \
+    idx = malloc(n * sizeof(size_t));                                           \
+    for (i = 0; i < 2 * n; i++) {                                               \
+        keys[i] = keygen(opts, i);                                              \
+    }                                                                           \
+    bench_queries(opts, idx, n, n, 2);                                          \
+                                                                                \
+    bench_lat_init(&lat, n);                                                    \
+    start = bench_now();                                                        \
+    for (i = 0; i < n; i++) {                                                   \
+        BENCH_OP(&lat, i, prefix##_add(&trie, keys[i], &keys[i]));              \
+    }                                                                           \
+    bench_report_lat(#prefix, "insert", n, bench_now() - start, &lat);          \
+    bench_lat_free(&lat);                                                       \
+                                                                                \
+    lookup.trie = trie;                                                         \
+    lookup.keys = keys;                                                         \
+    lookup.idx = idx;                                                           \
+    lookup.count = n;                                                           \
+    bench_lat_init(&lat, n * (size_t) threads);                                 \
+    secs = bench_parallel(threads, name##_lookup, &lookup, n, &lat);            \
+    bench_report_lat(#prefix, "lookup_hit", n * (size_t) threads, secs, &lat);  \
+    bench_lat_free(&lat);                                                       \
+                                                                                \
+    lookup.keys = keys + n;                                                     \
+    bench_lat_init(&lat, n * (size_t) threads);                                 \
+    secs = bench_parallel(threads, name##_lookup, &lookup, n, &lat);            \
+    bench_report_lat(#prefix, "lookup_miss", n * (size_t) threads, secs, &lat); \
+    bench_lat_free(&lat);                                                       \
+                                                                                \
+    start = bench_now();                                                        \
+    prefix##_loop(trie, name##_count, &found);                                  \
+    bench_report(#prefix, "iterate", n, bench_now() - start);                   \
+                                                                                \
+    bench_lat_init(&lat, n);                                                    \
+    start = bench_now();                                                        \
+    for (i = 0; i < n; i++) {                                                   \
+        BENCH_OP(&lat, i, prefix##_remove(&trie, keys[i], NULL));               \
+    }                                                                           \
+    bench_report_lat(#prefix, "remove", n, bench_now() - start, &lat);          \
+    bench_lat_free(&lat);                                                       \
+                                                                                \
+    if (found < n) {                                                            \
+        bench_report(#prefix, "MISSING", n - found, 0);                         \
+    }                                                                           \
+                                                                                \
+    prefix##_free(trie, NULL);                                                  \
+    trie = prefix##_new_blank();                                                \
+    for (i = 0; i < n; i++) {                                                   \
+        prefix##_add(&trie, keys[i], &keys[i]);                                 \
+    }                                                                           \
+    start = bench_now();                                                        \
+    prefix##_free(trie, NULL);                                                  \
+    bench_report(#prefix, "free", n, bench_now() - start);                      \
+                                                                                \
+    free(keys);                                                                 \
+    free(idx);                                                                  \
+}
+
+BENCH_PATRICIA(bench_patricia, bodhi_patricia, bodhi_patricia_t, uint32_t, bench_key32)
+BENCH_PATRICIA(bench_patricia64, bodhi_patricia64, bodhi_patricia64_t, uint64_t, bench_key64)
+BENCH_PATRICIA(bench_patricia128, bodhi_patricia128, bodhi_patricia128_t, bodhi_uint128_t, key128_at)
+
+/* single key lookups against bodhi_patricia_find_val_batch at several batch sizes */
+void bench_patricia_batch(const bench_opts_t *opts) {
+    static const size_t sizes[] = { 8, 16, 32, 64, 128, 256 };
+    bodhi_patricia_t *trie = bodhi_patricia_new_blank();
+    uint32_t *keys;
+    void **out;
+    uint64_t state = 1;
+    size_t n = opts->count;
+    size_t i;
+    size_t j;
+    size_t found = 0;
+    double start;
+    char op[32];
+
+    keys = malloc(n * sizeof(uint32_t));
+    out = malloc(n * sizeof(void*));
+    for (i = 0; i < n; i++) {
+        keys[i] = key32(&state);
+        bodhi_patricia_add(&trie, keys[i], &keys[i]);
+    }
+
+    /* look keys up in a different order than they were inserted */
+    for (i = n; i > 1; i--) {
+        uint32_t tmp;
+
+        j = bench_rand(&state) % i;
+        tmp = keys[i - 1];
+        keys[i - 1] = keys[j];
+        keys[j] = tmp;
+    }
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        out[i] = bodhi_patricia_find_val(trie, keys[i]);
+    }
+    bench_report("bodhi_patricia", "lookup_single", n, bench_now() - start);
+
+    for (j = 0; j < sizeof(sizes) / sizeof(sizes[0]); j++) {
+        found = 0;
+        start = bench_now();
+        for (i = 0; i < n; i += sizes[j]) {
+            size_t len = n - i < sizes[j] ? n - i : sizes[j];
+            found += bodhi_patricia_find_val_batch(trie, keys + i, len, out + i);
+        }
+        sprintf(op, "lookup_batch_%lu", (unsigned long) sizes[j]);
+        bench_report("bodhi_patricia", op, n, bench_now() - start);
+    }
+
+    bodhi_patricia_free(trie, NULL);
+    free(keys);
+    free(out);
+}
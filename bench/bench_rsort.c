@@ -0,0 +1,127 @@
+/*
+ * bench_rsort.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <libbodhi/list.h>
+
+#include "bench.h"
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+static int cmp_u64_ptr(const void *a, const void *b) {
+    return cmp_u64(*(void * const *) a, *(void * const *) b);
+}
+
+static uint64_t key_u64(const void *data) {
+    return *(const uint64_t *) data;
+}
+
+static bodhi_list_t *build(uint64_t *keys, size_t n) {
+    bodhi_list_t *list = NULL;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        list = bodhi_list_add(list, &keys[i]);
+    }
+
+    return list;
+}
+
+static void check(const char *suite, void **items, size_t n) {
+    size_t i;
+
+    for (i = 1; i < n; i++) {
+        if (key_u64(items[i - 1]) > key_u64(items[i])) {
+            fprintf(stderr, "%s: out of order at %lu\n", suite, (unsigned long) i);
+            return;
+        }
+    }
+}
+
+/*
+ * sorting the same keys as a list with msort and rsort, and as a pointer
+ * array with rsort and qsort, single threaded and across every cpu
+ */
+void bench_rsort(const bench_opts_t *opts) {
+    long ncpu = opts->threads > 0 ? opts->threads : sysconf(_SC_NPROCESSORS_ONLN);
+    size_t n = opts->count, i;
+    bodhi_list_t *list;
+    uint64_t *keys;
+    void **items;
+    double start;
+    char op[32];
+
+    keys = malloc(n * sizeof(uint64_t));
+    for (i = 0; i < n; i++) {
+        keys[i] = bench_key64(opts, i);
+    }
+
+    list = build(keys, n);
+    start = bench_now();
+    list = bodhi_list_msort(list, cmp_u64);
+    bench_report("bodhi_list", "msort", n, bench_now() - start);
+    bodhi_list_free(list);
+
+    list = build(keys, n);
+    start = bench_now();
+    list = bodhi_list_rsort(list, key_u64, 1);
+    bench_report("bodhi_list", "rsort", n, bench_now() - start);
+    bodhi_list_free(list);
+
+    list = build(keys, n);
+    start = bench_now();
+    list = bodhi_list_rsort(list, key_u64, (int) ncpu);
+    sprintf(op, "rsort_%ldthreads", ncpu);
+    bench_report("bodhi_list", op, n, bench_now() - start);
+    items = bodhi_list_to_array(list, sizeof(void *));
+    check("bodhi_list_rsort", items, n);
+    free(items);
+    bodhi_list_free(list);
+
+    items = malloc(n * sizeof(void *));
+    for (i = 0; i < n; i++) {
+        items[i] = &keys[i];
+    }
+    start = bench_now();
+    qsort(items, n, sizeof(void *), cmp_u64_ptr);
+    bench_report("array", "qsort", n, bench_now() - start);
+
+    for (i = 0; i < n; i++) {
+        items[i] = &keys[i];
+    }
+    start = bench_now();
+    bodhi_array_rsort(items, n, key_u64, 1);
+    bench_report("array", "rsort", n, bench_now() - start);
+
+    for (i = 0; i < n; i++) {
+        items[i] = &keys[i];
+    }
+    start = bench_now();
+    bodhi_array_rsort(items, n, key_u64, (int) ncpu);
+    bench_report("array", op, n, bench_now() - start);
+    check("bodhi_array_rsort", items, n);
+
+    free(items);
+    free(keys);
+}
@@ -0,0 +1,101 @@
+/*
+ * bench_setops.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libbodhi/patricia.h>
+
+#include "bench.h"
+
+typedef struct _probe_t {
+    bodhi_patricia_t *other;
+    bodhi_patricia_t *out;
+} probe_t;
+
+static void probe_cb(bodhi_patricia_t *node, void *udata) {
+    probe_t *p = udata;
+    uint32_t key = bodhi_patricia_get_key(node);
+
+    if (bodhi_patricia_find_val(p->other, key) != NULL) {
+        bodhi_patricia_add(&p->out, key, bodhi_patricia_get_data(node));
+    }
+}
+
+/* two half-overlapping sets of clustered ids */
+static void fill(uint32_t *keys, size_t n, uint32_t base) {
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        keys[i] = base + (uint32_t) i * 3;
+    }
+}
+
+/* intersecting by probing one trie per key of the other against merging */
+void bench_setops(const bench_opts_t *opts) {
+    bodhi_patricia_t *a, *b, *r;
+    uint32_t *ka, *kb;
+    void **vals;
+    size_t n = opts->count;
+    size_t i;
+    probe_t p;
+    double start;
+
+    ka = malloc(n * sizeof(uint32_t));
+    kb = malloc(n * sizeof(uint32_t));
+    fill(ka, n, 0);
+    fill(kb, n, (uint32_t) (n / 2) * 3);
+
+    vals = malloc(n * sizeof(void *));
+    for (i = 0; i < n; i++) {
+        vals[i] = &ka[i];
+    }
+
+    a = bodhi_patricia_build_sorted(ka, vals, n);
+    b = bodhi_patricia_build_sorted(kb, vals, n);
+
+    p.other = b;
+    p.out = bodhi_patricia_new_blank();
+    start = bench_now();
+    bodhi_patricia_loop(a, probe_cb, &p);
+    bench_report("bodhi_patricia", "probe_intersect", n, bench_now() - start);
+    bodhi_patricia_free(p.out, NULL);
+
+    start = bench_now();
+    r = bodhi_patricia_intersect(a, b, NULL, NULL, NULL);
+    bench_report("bodhi_patricia", "intersect", n, bench_now() - start);
+    bodhi_patricia_free(r, NULL);
+
+    a = bodhi_patricia_build_sorted(ka, vals, n);
+    b = bodhi_patricia_build_sorted(kb, vals, n);
+    start = bench_now();
+    r = bodhi_patricia_union(a, b, NULL, NULL, NULL);
+    bench_report("bodhi_patricia", "union", n, bench_now() - start);
+    bodhi_patricia_free(r, NULL);
+
+    a = bodhi_patricia_build_sorted(ka, vals, n);
+    b = bodhi_patricia_build_sorted(kb, vals, n);
+    start = bench_now();
+    r = bodhi_patricia_difference(a, b, NULL);
+    bench_report("bodhi_patricia", "difference", n, bench_now() - start);
+    bodhi_patricia_free(r, NULL);
+
+    free(vals);
+    free(ka);
+    free(kb);
+}
@@ -0,0 +1,77 @@
+/*
+ * bench_snapshot.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libbodhi/patricia.h>
+#include <libbodhi/snapshot.h>
+
+#include "bench.h"
+
+#define SNAPSHOT_PATH "bodhi_bench.snap"
+
+static const void *key_bytes(void *data, size_t *len, void *udata) {
+    (void) udata;
+    *len = sizeof(uint32_t);
+    return data;
+}
+
+/* rebuilding a trie key by key against opening a snapshot of it */
+void bench_snapshot(const bench_opts_t *opts) {
+    bodhi_patricia_t *trie = bodhi_patricia_new_blank();
+    bodhi_snapshot_t *snap;
+    uint32_t *keys;
+    uint64_t state = 1;
+    size_t n = opts->count;
+    size_t i;
+    size_t found = 0;
+    double start;
+
+    keys = malloc(n * sizeof(uint32_t));
+    for (i = 0; i < n; i++) {
+        keys[i] = (uint32_t) bench_rand(&state);
+    }
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_patricia_add(&trie, keys[i], &keys[i]);
+    }
+    bench_report("bodhi_patricia", "rebuild", n, bench_now() - start);
+
+    start = bench_now();
+    bodhi_snapshot_write(trie, SNAPSHOT_PATH, key_bytes, NULL);
+    bench_report("bodhi_snapshot", "write", n, bench_now() - start);
+
+    start = bench_now();
+    snap = bodhi_snapshot_open(SNAPSHOT_PATH);
+    bench_report("bodhi_snapshot", "open", n, bench_now() - start);
+
+    if (snap != NULL) {
+        start = bench_now();
+        for (i = 0; i < n; i++) {
+            found += bodhi_snapshot_find_val(snap, keys[i], NULL) != NULL;
+        }
+        bench_report("bodhi_snapshot", "lookup_hit", n, bench_now() - start);
+        bodhi_snapshot_close(snap);
+    }
+
+    remove(SNAPSHOT_PATH);
+    bodhi_patricia_free(trie, NULL);
+    free(keys);
+}
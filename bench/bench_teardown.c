@@ -0,0 +1,124 @@
+/*
+ * bench_teardown.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libbodhi/hmap.h>
+#include <libbodhi/patricia.h>
+#include <libbodhi/reaper.h>
+
+#include "bench.h"
+
+/* entries per free_step call, the latency columns are the pauses */
+#define STEP 10000
+
+static int cmp_u32(const void *a, const void *b) {
+    return *(const uint32_t *) a != *(const uint32_t *) b;
+}
+
+static size_t hash_u32(void *key) {
+    return bench_mix32(*(const uint32_t *) key);
+}
+
+static bodhi_hmap_t *build_hmap(const uint32_t *keys, size_t n) {
+    bodhi_hmap_t *hmap = bodhi_hmap_new(hash_u32, cmp_u32, NULL, NULL);
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        bodhi_hmap_insert_no_cpy(hmap, (void *) &keys[i], (void *) &keys[i]);
+    }
+
+    return hmap;
+}
+
+static bodhi_patricia_t *build_trie(const uint32_t *keys, size_t n) {
+    bodhi_patricia_t *trie = bodhi_patricia_new_blank();
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        bodhi_patricia_add(&trie, keys[i], (void *) &keys[i]);
+    }
+
+    return trie;
+}
+
+/* how long the owning thread is held up dropping a big structure */
+void bench_teardown(const bench_opts_t *opts) {
+    bodhi_hmap_t *hmap;
+    bodhi_patricia_t *trie;
+    bench_lat_t lat;
+    uint32_t *keys;
+    size_t n = opts->count;
+    size_t i;
+    int more;
+    double start;
+
+    keys = malloc(n * sizeof(uint32_t));
+    for (i = 0; i < n; i++) {
+        keys[i] = bench_key32(opts, i);
+    }
+
+    hmap = build_hmap(keys, n);
+    start = bench_now();
+    bodhi_hmap_free(hmap);
+    bench_report("bodhi_hmap", "free", n, bench_now() - start);
+
+    hmap = build_hmap(keys, n);
+    start = bench_now();
+    bodhi_hmap_free_detached(hmap);
+    bench_report("bodhi_hmap", "free_detached", n, bench_now() - start);
+    bodhi_reaper_wait();
+
+    hmap = build_hmap(keys, n);
+    bench_lat_init(&lat, n);
+    start = bench_now();
+    do {
+        double t = bench_now();
+
+        more = bodhi_hmap_free_step(hmap, STEP);
+        bench_lat_add(&lat, bench_now() - t);
+    } while (more);
+    bench_report_lat("bodhi_hmap", "free_step", n, bench_now() - start, &lat);
+    bench_lat_free(&lat);
+
+    trie = build_trie(keys, n);
+    start = bench_now();
+    bodhi_patricia_free(trie, NULL);
+    bench_report("bodhi_patricia", "free", n, bench_now() - start);
+
+    trie = build_trie(keys, n);
+    start = bench_now();
+    bodhi_patricia_free_detached(trie, NULL);
+    bench_report("bodhi_patricia", "free_detached", n, bench_now() - start);
+    bodhi_reaper_wait();
+
+    trie = build_trie(keys, n);
+    bench_lat_init(&lat, n);
+    start = bench_now();
+    do {
+        double t = bench_now();
+
+        more = bodhi_patricia_free_step(&trie, NULL, STEP);
+        bench_lat_add(&lat, bench_now() - t);
+    } while (more);
+    bench_report_lat("bodhi_patricia", "free_step", n, bench_now() - start, &lat);
+    bench_lat_free(&lat);
+
+    free(keys);
+}
@@ -0,0 +1,137 @@
+/*
+ * bench_typed.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libbodhi/hmap.h>
+#include <libbodhi/list.h>
+#include <libbodhi/typed.h>
+
+#include "bench.h"
+
+BODHI_HMAP_DECLARE(u64map, uint64_t, uint64_t *, bodhi_hash_u64, BODHI_EQ)
+BODHI_LIST_DECLARE(u64list, uint64_t, BODHI_CMP)
+
+static size_t hash_u64(void *key) {
+    return bodhi_hash_u64(*(const uint64_t *) key);
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+static void no_free(void *p) {
+    (void) p;
+}
+
+/* the generated map and list against bodhi_hmap_t and bodhi_list_t on uint64_t keys */
+void bench_typed(const bench_opts_t *opts) {
+    bodhi_hmap_t *hmap = bodhi_hmap_new(hash_u64, cmp_u64, no_free, no_free);
+    u64map_t *map = u64map_new();
+    bodhi_list_t *list = NULL;
+    u64list_t *tlist = NULL;
+    uint64_t *keys;
+    size_t *idx;
+    size_t n = opts->count;
+    size_t i;
+    size_t found = 0;
+    double start;
+
+    /* the second half of keys are misses */
+    keys = malloc(2 * n * sizeof(uint64_t));
+    idx = malloc(n * sizeof(size_t));
+    for (i = 0; i < 2 * n; i++) {
+        keys[i] = bench_key64(opts, i);
+    }
+    bench_queries(opts, idx, n, n, 2);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_hmap_insert_no_cpy(hmap, &keys[i], &keys[i]);
+    }
+    bench_report("bodhi_hmap", "insert", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        u64map_insert(map, keys[i], &keys[i]);
+    }
+    bench_report("typed_hmap", "insert", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += bodhi_hmap_value(hmap, &keys[idx[i]]) != NULL;
+    }
+    bench_report("bodhi_hmap", "lookup_hit", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += u64map_get(map, keys[idx[i]]) != NULL;
+    }
+    bench_report("typed_hmap", "lookup_hit", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += bodhi_hmap_value(hmap, &keys[n + i]) != NULL;
+    }
+    bench_report("bodhi_hmap", "lookup_miss", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        found += u64map_get(map, keys[n + i]) != NULL;
+    }
+    bench_report("typed_hmap", "lookup_miss", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        bodhi_hmap_delete(hmap, &keys[i]);
+    }
+    bench_report("bodhi_hmap", "delete", n, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < n; i++) {
+        u64map_delete(map, keys[i], NULL);
+    }
+    bench_report("typed_hmap", "delete", n, bench_now() - start);
+
+    for (i = 0; i < n; i++) {
+        list = bodhi_list_add(list, &keys[i]);
+        tlist = u64list_add(tlist, keys[i]);
+    }
+
+    start = bench_now();
+    list = bodhi_list_msort(list, cmp_u64);
+    bench_report("bodhi_list", "sort", n, bench_now() - start);
+
+    start = bench_now();
+    tlist = u64list_msort(tlist);
+    bench_report("typed_list", "sort", n, bench_now() - start);
+
+    if (found == 0) {
+        printf("nothing found\n");
+    }
+
+    bodhi_list_free(list);
+    u64list_free(tlist);
+    bodhi_hmap_free(hmap);
+    u64map_free(map);
+    free(keys);
+    free(idx);
+}
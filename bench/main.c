@@ -0,0 +1,417 @@
+/*
+ * main.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "bench.h"
+
+static const bench_suite_t suites[] = {
+    { "list", bench_list },
+    { "hmap", bench_hmap },
+    { "patricia", bench_patricia },
+    { "patricia64", bench_patricia64 },
+    { "patricia128", bench_patricia128 },
+    { "patricia_batch", bench_patricia_batch },
+    { "cpatricia", bench_cpatricia },
+    { "ipatricia", bench_ipatricia },
+    { "snapshot", bench_snapshot },
+    { "bulk", bench_bulk },
+    { "art", bench_art },
+    { "setops", bench_setops },
+    { "typed", bench_typed },
+    { "filter", bench_filter },
+    { "heap", bench_heap },
+    { "hamt", bench_hamt },
+    { "teardown", bench_teardown },
+    { "intern", bench_intern },
+    { "rsort", bench_rsort },
+    { "btree", bench_btree },
+    { "foreach", bench_foreach },
+    { "omap", bench_omap },
+    { NULL, NULL }
+};
+
+static const char *dist_names[] = { "uniform", "zipf", "seq" };
+
+/* the options of the suite being run, for the report lines */
+static const bench_opts_t *current;
+
+double bench_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* splitmix64, good enough for generating keys */
+uint64_t bench_rand(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/* the murmur3 finalizer, a bijection so distinct indices give distinct keys */
+uint32_t bench_mix32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x85EBCA6Bu;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35u;
+    x ^= x >> 16;
+    return x;
+}
+
+uint64_t bench_mix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+uint32_t bench_key32(const bench_opts_t *opts, size_t i) {
+    return opts->dist == BENCH_SEQ ? (uint32_t) i : bench_mix32((uint32_t) i);
+}
+
+uint64_t bench_key64(const bench_opts_t *opts, size_t i) {
+    return opts->dist == BENCH_SEQ ? (uint64_t) i : bench_mix64((uint64_t) i);
+}
+
+/*
+ * Zipfian ranks with theta 0.99 as generated by YCSB (Gray et al., "Quickly
+ * generating billion-record synthetic databases"), so rank 0 is the most
+ * popular key and a few keys take most of the queries.
+ */
+#define ZIPF_THETA 0.99
+
+void bench_queries(const bench_opts_t *opts, size_t *idx, size_t count, size_t n, uint64_t seed) {
+    uint64_t state = seed;
+    double zetan = 0, zeta2, alpha, eta;
+    size_t i;
+
+    if (opts->dist != BENCH_ZIPF) {
+        for (i = 0; i < count; i++) {
+            idx[i] = opts->dist == BENCH_SEQ ? i % n : (size_t) (bench_rand(&state) % n);
+        }
+        return;
+    }
+
+    for (i = 1; i <= n; i++) {
+        zetan += 1.0 / pow((double) i, ZIPF_THETA);
+    }
+    zeta2 = 1.0 + pow(0.5, ZIPF_THETA);
+    alpha = 1.0 / (1.0 - ZIPF_THETA);
+    eta = (1.0 - pow(2.0 / (double) n, 1.0 - ZIPF_THETA)) / (1.0 - zeta2 / zetan);
+
+    for (i = 0; i < count; i++) {
+        double u = (double) (bench_rand(&state) >> 11) / 9007199254740992.0;
+        double uz = u * zetan;
+        size_t rank;
+
+        if (uz < 1.0) {
+            rank = 0;
+        } else if (uz < zeta2) {
+            rank = 1;
+        } else {
+            rank = (size_t) ((double) n * pow(eta * u - eta + 1.0, alpha));
+        }
+        idx[i] = rank < n ? rank : n - 1;
+    }
+}
+
+/* without memory for samples latency is simply not reported, see bench_lat_add */
+void bench_lat_init(bench_lat_t *lat, size_t ops) {
+    lat->count = 0;
+    lat->alloc = ops / BENCH_SAMPLE + 1;
+    lat->samples = malloc(lat->alloc * sizeof(double));
+    if (lat->samples == NULL) {
+        lat->alloc = 0;
+    }
+}
+
+void bench_lat_add(bench_lat_t *lat, double secs) {
+    if (lat->samples == NULL) {
+        return;
+    }
+
+    if (lat->count == lat->alloc) {
+        double *tmp = realloc(lat->samples, lat->alloc * 2 * sizeof(double));
+        if (tmp == NULL) {
+            return;
+        }
+        lat->samples = tmp;
+        lat->alloc *= 2;
+    }
+
+    lat->samples[lat->count++] = secs;
+}
+
+void bench_lat_free(bench_lat_t *lat) {
+    free(lat->samples);
+    lat->samples = NULL;
+    lat->count = 0;
+    lat->alloc = 0;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return x < y ? -1 : x > y;
+}
+
+/* nearest rank percentile in nanoseconds */
+static double percentile(const bench_lat_t *lat, double p) {
+    size_t rank = (size_t) (p * (double) lat->count);
+
+    if (rank >= lat->count) {
+        rank = lat->count - 1;
+    }
+    return lat->samples[rank] * 1e9;
+}
+
+/* peak resident set size in kilobytes */
+static long peak_rss(void) {
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru) != 0) {
+        return 0;
+    }
+    return ru.ru_maxrss;
+}
+
+void bench_report_lat(const char *suite, const char *op, size_t ops, double secs, bench_lat_t *lat) {
+    double rate = secs > 0 ? (double) ops / secs : 0.0;
+    int have_lat = lat != NULL && lat->count > 0;
+    double p50 = 0, p90 = 0, p99 = 0, p999 = 0;
+
+    if (have_lat) {
+        qsort(lat->samples, lat->count, sizeof(double), cmp_double);
+        p50 = percentile(lat, 0.50);
+        p90 = percentile(lat, 0.90);
+        p99 = percentile(lat, 0.99);
+        p999 = percentile(lat, 0.999);
+    }
+
+    if (current != NULL && current->json) {
+        printf("{\"suite\":\"%s\",\"op\":\"%s\",\"n\":%lu,\"dist\":\"%s\",\"threads\":%d,"
+               "\"ops\":%lu,\"secs\":%.6f,\"ops_per_sec\":%.0f",
+               suite, op, (unsigned long) current->count, dist_names[current->dist],
+               current->threads, (unsigned long) ops, secs, rate);
+        if (have_lat) {
+            printf(",\"p50_ns\":%.0f,\"p90_ns\":%.0f,\"p99_ns\":%.0f,\"p999_ns\":%.0f",
+                   p50, p90, p99, p999);
+        }
+        printf(",\"peak_rss_kb\":%ld}\n", peak_rss());
+    } else if (have_lat) {
+        printf("%-16s %-16s %12lu ops %14.0f ops/sec  p50 %6.0fns p99 %7.0fns p99.9 %8.0fns\n",
+               suite, op, (unsigned long) ops, rate, p50, p99, p999);
+    } else {
+        printf("%-16s %-16s %12lu ops %14.0f ops/sec\n", suite, op, (unsigned long) ops, rate);
+    }
+    fflush(stdout);
+}
+
+void bench_report(const char *suite, const char *op, size_t ops, double secs) {
+    bench_report_lat(suite, op, ops, secs, NULL);
+}
+
+typedef struct _bench_worker_t {
+    bench_thread_fn fn;
+    void *arg;
+    int thread;
+    bench_lat_t lat;
+} bench_worker_t;
+
+static void *bench_worker(void *p) {
+    bench_worker_t *w = p;
+
+    w->fn(w->arg, w->thread, &w->lat);
+    return NULL;
+}
+
+/* runs fn on threads at once and gathers their latency samples into lat */
+double bench_parallel(int threads, bench_thread_fn fn, void *arg, size_t ops, bench_lat_t *lat) {
+    bench_worker_t *workers;
+    pthread_t *tids;
+    double start, secs;
+    int i;
+    size_t j;
+
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    workers = malloc((size_t) threads * sizeof(bench_worker_t));
+    tids = malloc((size_t) threads * sizeof(pthread_t));
+    for (i = 0; i < threads; i++) {
+        workers[i].fn = fn;
+        workers[i].arg = arg;
+        workers[i].thread = i;
+        bench_lat_init(&workers[i].lat, ops);
+    }
+
+    start = bench_now();
+    for (i = 1; i < threads; i++) {
+        pthread_create(&tids[i], NULL, bench_worker, &workers[i]);
+    }
+    bench_worker(&workers[0]);
+    for (i = 1; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    secs = bench_now() - start;
+
+    for (i = 0; i < threads; i++) {
+        for (j = 0; j < workers[i].lat.count; j++) {
+            bench_lat_add(lat, workers[i].lat.samples[j]);
+        }
+        bench_lat_free(&workers[i].lat);
+    }
+
+    free(workers);
+    free(tids);
+    return secs;
+}
+
+static void usage(const char *argv0) {
+    const bench_suite_t *s;
+
+    fprintf(stderr, "usage: %s [-n count[,count...]] [-d uniform|zipf|seq] [-t threads] [-j] [suite...]\n"
+                    "  -n  element counts, every suite runs once per count\n"
+                    "  -d  key distribution of the lookups (seq also makes keys sequential)\n"
+                    "  -t  lookup threads, the scaling suites default to every cpu\n"
+                    "  -j  print one JSON object per result instead of a table\n"
+                    "suites:", argv0);
+    for (s = suites; s->name != NULL; s++) {
+        fprintf(stderr, " %s", s->name);
+    }
+    fprintf(stderr, "\n");
+}
+
+static int parse_dist(const char *name, bench_dist_t *dist) {
+    int i;
+
+    for (i = 0; i < (int) (sizeof(dist_names) / sizeof(dist_names[0])); i++) {
+        if (strcmp(name, dist_names[i]) == 0) {
+            *dist = (bench_dist_t) i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+#define MAX_COUNTS 16
+
+static void run_suites(int argc, char **argv, bench_opts_t *opts) {
+    const bench_suite_t *s;
+    int ran = 0;
+    int i;
+
+    current = opts;
+
+    for (i = 1; i < argc; i++) {
+        if (argv[i][0] == '-') {
+            /* every option but -j takes a value */
+            i += strcmp(argv[i], "-j") != 0;
+            continue;
+        }
+
+        for (s = suites; s->name != NULL; s++) {
+            if (strcmp(s->name, argv[i]) == 0) {
+                s->run(opts);
+                ran = 1;
+                break;
+            }
+        }
+    }
+
+    if (!ran) {
+        for (s = suites; s->name != NULL; s++) {
+            s->run(opts);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    const bench_suite_t *s;
+    bench_opts_t opts;
+    size_t counts[MAX_COUNTS];
+    int ncounts = 1;
+    int i;
+
+    counts[0] = 1000000;
+    opts.dist = BENCH_UNIFORM;
+    opts.threads = 0;
+    opts.json = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            char *p = argv[++i];
+
+            ncounts = 0;
+            while (*p != '\0' && ncounts < MAX_COUNTS) {
+                counts[ncounts++] = strtoul(p, &p, 10);
+                if (*p == ',') {
+                    p++;
+                } else if (*p != '\0') {
+                    usage(argv[0]);
+                    return 1;
+                }
+            }
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            if (parse_dist(argv[++i], &opts.dist) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            opts.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-j") == 0) {
+            opts.json = 1;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            for (s = suites; s->name != NULL; s++) {
+                if (strcmp(s->name, argv[i]) == 0) {
+                    break;
+                }
+            }
+
+            if (s->name == NULL) {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+    }
+
+    for (i = 0; i < ncounts; i++) {
+        if (counts[i] == 0) {
+            usage(argv[0]);
+            return 1;
+        }
+
+        opts.count = counts[i];
+        run_suites(argc, argv, &opts);
+    }
+
+    return 0;
+}
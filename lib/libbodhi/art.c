@@ -0,0 +1,955 @@
+/*
+ * art.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "art.h"
+#include "util.h"
+
+/*
+ * Children are stored as tagged pointers: leaves have the low bit set. A
+ * key that ends inside the tree (a prefix of another key) hangs off the
+ * inner node where it ends in the value slot rather than under a child, so
+ * no terminator byte is needed and keys may contain any byte.
+ *
+ * Only the first MAX_PREFIX bytes of a compressed path are kept in the
+ * node. Lookups skip the rest and verify the whole key at the leaf; updates
+ * that need the missing bytes read them from the smallest leaf below.
+ */
+#define MAX_PREFIX 10
+
+#define NODE4 0
+#define NODE16 1
+#define NODE48 2
+#define NODE256 3
+
+#define IS_LEAF(p) (((uintptr_t) (p) & 1) != 0)
+#define TO_LEAF(p) ((bodhi_art_leaf_t *) ((uintptr_t) (p) & ~(uintptr_t) 1))
+#define TAG_LEAF(l) ((void *) ((uintptr_t) (l) | 1))
+
+typedef struct _bodhi_art_leaf_t {
+    void *val;
+    size_t len;
+    unsigned char key[1];
+} bodhi_art_leaf_t;
+
+typedef struct _bodhi_art_node_t {
+    unsigned char type;
+    unsigned short count;
+    size_t prefix_len;
+    unsigned char prefix[MAX_PREFIX];
+    bodhi_art_leaf_t *value;
+} bodhi_art_node_t;
+
+typedef struct _bodhi_art_node4_t {
+    bodhi_art_node_t n;
+    unsigned char keys[4];
+    void *children[4];
+} bodhi_art_node4_t;
+
+typedef struct _bodhi_art_node16_t {
+    bodhi_art_node_t n;
+    unsigned char keys[16];
+    void *children[16];
+} bodhi_art_node16_t;
+
+/* index holds slot + 1, 0 means no child */
+typedef struct _bodhi_art_node48_t {
+    bodhi_art_node_t n;
+    unsigned char index[256];
+    void *children[48];
+} bodhi_art_node48_t;
+
+typedef struct _bodhi_art_node256_t {
+    bodhi_art_node_t n;
+    void *children[256];
+} bodhi_art_node256_t;
+
+struct _bodhi_art_t {
+    void *root;
+    size_t size;
+};
+
+static bodhi_art_node_t *_node_new(unsigned char type) {
+    bodhi_art_node_t *ret;
+    size_t size;
+
+    switch (type) {
+        case NODE4:
+            size = sizeof(bodhi_art_node4_t);
+            break;
+        case NODE16:
+            size = sizeof(bodhi_art_node16_t);
+            break;
+        case NODE48:
+            size = sizeof(bodhi_art_node48_t);
+            break;
+        default:
+            size = sizeof(bodhi_art_node256_t);
+            break;
+    }
+
+    CALLOC(ret, 1, size, return NULL);
+    ret->type = type;
+
+    return ret;
+}
+
+static bodhi_art_leaf_t *_leaf_new(const unsigned char *key, size_t len, void *val) {
+    bodhi_art_leaf_t *ret;
+
+    MALLOC(ret, sizeof(bodhi_art_leaf_t) + len, return NULL);
+    ret->val = val;
+    ret->len = len;
+    memcpy(ret->key, key, len);
+
+    return ret;
+}
+
+static int _leaf_matches(const bodhi_art_leaf_t *l, const unsigned char *key, size_t len) {
+    return l->len == len && memcmp(l->key, key, len) == 0;
+}
+
+static void _copy_header(bodhi_art_node_t *dst, const bodhi_art_node_t *src) {
+    dst->count = src->count;
+    dst->prefix_len = src->prefix_len;
+    memcpy(dst->prefix, src->prefix, MAX_PREFIX);
+    dst->value = src->value;
+}
+
+static void **_find_child(bodhi_art_node_t *n, unsigned char c) {
+    int i;
+
+    switch (n->type) {
+        case NODE4: {
+            bodhi_art_node4_t *p = (bodhi_art_node4_t *) n;
+            for (i = 0; i < n->count; i++) {
+                if (p->keys[i] == c) {
+                    return &p->children[i];
+                }
+            }
+            break;
+        }
+        case NODE16: {
+            bodhi_art_node16_t *p = (bodhi_art_node16_t *) n;
+#ifdef __SSE2__
+            __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char) c),
+                                         _mm_loadu_si128((const __m128i *) p->keys));
+            unsigned int mask = (unsigned int) _mm_movemask_epi8(cmp) & ((1u << n->count) - 1);
+            if (mask != 0) {
+                return &p->children[CTZ32(mask)];
+            }
+#else
+            for (i = 0; i < n->count; i++) {
+                if (p->keys[i] == c) {
+                    return &p->children[i];
+                }
+            }
+#endif
+            break;
+        }
+        case NODE48: {
+            bodhi_art_node48_t *p = (bodhi_art_node48_t *) n;
+            if (p->index[c] != 0) {
+                return &p->children[p->index[c] - 1];
+            }
+            break;
+        }
+        default: {
+            bodhi_art_node256_t *p = (bodhi_art_node256_t *) n;
+            if (p->children[c] != NULL) {
+                return &p->children[c];
+            }
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/* the smallest leaf below a child reference */
+static bodhi_art_leaf_t *_min_leaf(void *ref) {
+    while (ref != NULL && !IS_LEAF(ref)) {
+        bodhi_art_node_t *n = ref;
+        int i;
+
+        if (n->value != NULL) {
+            return n->value;
+        }
+
+        switch (n->type) {
+            case NODE4:
+                ref = ((bodhi_art_node4_t *) n)->children[0];
+                break;
+            case NODE16:
+                ref = ((bodhi_art_node16_t *) n)->children[0];
+                break;
+            case NODE48: {
+                bodhi_art_node48_t *p = (bodhi_art_node48_t *) n;
+                for (i = 0; p->index[i] == 0; i++);
+                ref = p->children[p->index[i] - 1];
+                break;
+            }
+            default: {
+                bodhi_art_node256_t *p = (bodhi_art_node256_t *) n;
+                for (i = 0; p->children[i] == NULL; i++);
+                ref = p->children[i];
+                break;
+            }
+        }
+    }
+
+    return ref == NULL ? NULL : TO_LEAF(ref);
+}
+
+/* number of stored prefix bytes that match, as used by lookups */
+static size_t _check_prefix(const bodhi_art_node_t *n, const unsigned char *key, size_t len,
+                            size_t depth) {
+    size_t max = n->prefix_len < MAX_PREFIX ? n->prefix_len : MAX_PREFIX;
+    size_t i;
+
+    if (max > len - depth) {
+        max = len - depth;
+    }
+
+    for (i = 0; i < max; i++) {
+        if (n->prefix[i] != key[depth + i]) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+/* number of prefix bytes that match, looking past MAX_PREFIX if needed */
+static size_t _prefix_mismatch(bodhi_art_node_t *n, const unsigned char *key, size_t len,
+                               size_t depth) {
+    size_t i = _check_prefix(n, key, len, depth);
+    bodhi_art_leaf_t *l;
+    size_t max;
+
+    if (i < MAX_PREFIX || n->prefix_len <= MAX_PREFIX) {
+        return i;
+    }
+
+    l = _min_leaf(n);
+    max = n->prefix_len < len - depth ? n->prefix_len : len - depth;
+    for (; i < max; i++) {
+        if (l->key[depth + i] != key[depth + i]) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+/*
+ * returns -1 if a full node can't be grown; the grown node is allocated
+ * before anything is touched, so the tree is unchanged then
+ */
+static int _add_child(void **ref, bodhi_art_node_t *n, unsigned char c, void *child);
+
+static int _add_child4(void **ref, bodhi_art_node4_t *n, unsigned char c, void *child) {
+    if (n->n.count < 4) {
+        int i;
+
+        for (i = 0; i < n->n.count && n->keys[i] < c; i++);
+        memmove(n->keys + i + 1, n->keys + i, n->n.count - i);
+        memmove(n->children + i + 1, n->children + i, (n->n.count - i) * sizeof(void *));
+        n->keys[i] = c;
+        n->children[i] = child;
+        n->n.count++;
+        return 0;
+    } else {
+        bodhi_art_node16_t *grown = (bodhi_art_node16_t *) _node_new(NODE16);
+
+        if (grown == NULL) {
+            return -1;
+        }
+
+        _copy_header(&grown->n, &n->n);
+        memcpy(grown->keys, n->keys, 4);
+        memcpy(grown->children, n->children, 4 * sizeof(void *));
+        *ref = grown;
+        free(n);
+        return _add_child(ref, &grown->n, c, child);
+    }
+}
+
+static int _add_child16(void **ref, bodhi_art_node16_t *n, unsigned char c, void *child) {
+    if (n->n.count < 16) {
+        int i;
+
+        for (i = 0; i < n->n.count && n->keys[i] < c; i++);
+        memmove(n->keys + i + 1, n->keys + i, n->n.count - i);
+        memmove(n->children + i + 1, n->children + i, (n->n.count - i) * sizeof(void *));
+        n->keys[i] = c;
+        n->children[i] = child;
+        n->n.count++;
+        return 0;
+    } else {
+        bodhi_art_node48_t *grown = (bodhi_art_node48_t *) _node_new(NODE48);
+        int i;
+
+        if (grown == NULL) {
+            return -1;
+        }
+
+        _copy_header(&grown->n, &n->n);
+        memcpy(grown->children, n->children, 16 * sizeof(void *));
+        for (i = 0; i < 16; i++) {
+            grown->index[n->keys[i]] = (unsigned char) (i + 1);
+        }
+        *ref = grown;
+        free(n);
+        return _add_child(ref, &grown->n, c, child);
+    }
+}
+
+static int _add_child48(void **ref, bodhi_art_node48_t *n, unsigned char c, void *child) {
+    if (n->n.count < 48) {
+        int slot;
+
+        /* slots are compacted on removal, so the next free one is at count */
+        slot = n->n.count;
+        n->children[slot] = child;
+        n->index[c] = (unsigned char) (slot + 1);
+        n->n.count++;
+        return 0;
+    } else {
+        bodhi_art_node256_t *grown = (bodhi_art_node256_t *) _node_new(NODE256);
+        int i;
+
+        if (grown == NULL) {
+            return -1;
+        }
+
+        _copy_header(&grown->n, &n->n);
+        for (i = 0; i < 256; i++) {
+            if (n->index[i] != 0) {
+                grown->children[i] = n->children[n->index[i] - 1];
+            }
+        }
+        *ref = grown;
+        free(n);
+        return _add_child(ref, &grown->n, c, child);
+    }
+}
+
+static int _add_child(void **ref, bodhi_art_node_t *n, unsigned char c, void *child) {
+    switch (n->type) {
+        case NODE4:
+            return _add_child4(ref, (bodhi_art_node4_t *) n, c, child);
+        case NODE16:
+            return _add_child16(ref, (bodhi_art_node16_t *) n, c, child);
+        case NODE48:
+            return _add_child48(ref, (bodhi_art_node48_t *) n, c, child);
+        default:
+            ((bodhi_art_node256_t *) n)->children[c] = child;
+            n->count++;
+            return 0;
+    }
+}
+
+/*
+ * hang a leaf off a fresh node4, in the value slot if the key ends at
+ * depth; it holds at most two entries, so this never has to grow it
+ */
+static void _place_leaf(void **ref, bodhi_art_node_t *n, bodhi_art_leaf_t *l, size_t depth) {
+    if (l->len == depth) {
+        n->value = l;
+    } else {
+        (void) _add_child(ref, n, l->key[depth], TAG_LEAF(l));
+    }
+}
+
+bodhi_art_t *bodhi_art_new(void) {
+    bodhi_art_t *ret;
+
+    CALLOC(ret, 1, sizeof(bodhi_art_t), return NULL);
+
+    return ret;
+}
+
+static void _free_ref(void *ref, bodhi_art_free_fn fn) {
+    bodhi_art_node_t *n;
+    int i;
+
+    if (ref == NULL) {
+        return;
+    }
+
+    if (IS_LEAF(ref)) {
+        bodhi_art_leaf_t *l = TO_LEAF(ref);
+        if (fn != NULL && l->val != NULL) {
+            fn(l->val);
+        }
+        free(l);
+        return;
+    }
+
+    n = ref;
+    if (n->value != NULL) {
+        _free_ref(TAG_LEAF(n->value), fn);
+    }
+
+    switch (n->type) {
+        case NODE4:
+            for (i = 0; i < n->count; i++) {
+                _free_ref(((bodhi_art_node4_t *) n)->children[i], fn);
+            }
+            break;
+        case NODE16:
+            for (i = 0; i < n->count; i++) {
+                _free_ref(((bodhi_art_node16_t *) n)->children[i], fn);
+            }
+            break;
+        case NODE48:
+            for (i = 0; i < n->count; i++) {
+                _free_ref(((bodhi_art_node48_t *) n)->children[i], fn);
+            }
+            break;
+        default:
+            for (i = 0; i < 256; i++) {
+                _free_ref(((bodhi_art_node256_t *) n)->children[i], fn);
+            }
+            break;
+    }
+
+    free(n);
+}
+
+void bodhi_art_free(bodhi_art_t *art, bodhi_art_free_fn fn) {
+    ASSERT(art != NULL, return);
+    _free_ref(art->root, fn);
+    free(art);
+}
+
+static int _insert(void **ref, const unsigned char *key, size_t len, size_t depth, void *val) {
+    void *cur = *ref;
+    bodhi_art_node_t *n;
+    bodhi_art_leaf_t *l;
+    void **child;
+
+    if (cur == NULL) {
+        if ((l = _leaf_new(key, len, val)) == NULL) {
+            return -1;
+        }
+        *ref = TAG_LEAF(l);
+        return 0;
+    }
+
+    if (IS_LEAF(cur)) {
+        bodhi_art_leaf_t *old = TO_LEAF(cur);
+        size_t max, i;
+
+        if (_leaf_matches(old, key, len)) {
+            return 1;
+        }
+
+        if ((l = _leaf_new(key, len, val)) == NULL) {
+            return -1;
+        }
+        if ((n = _node_new(NODE4)) == NULL) {
+            free(l);
+            return -1;
+        }
+
+        max = old->len < len ? old->len : len;
+        for (i = depth; i < max && old->key[i] == key[i]; i++);
+        n->prefix_len = i - depth;
+        memcpy(n->prefix, key + depth, n->prefix_len < MAX_PREFIX ? n->prefix_len : MAX_PREFIX);
+
+        *ref = n;
+        _place_leaf(ref, n, old, i);
+        _place_leaf(ref, n, l, i);
+        return 0;
+    }
+
+    n = cur;
+    if (n->prefix_len != 0) {
+        size_t p = _prefix_mismatch(n, key, len, depth);
+
+        if (p < n->prefix_len) {
+            bodhi_art_node_t *split;
+            unsigned char edge;
+
+            if ((l = _leaf_new(key, len, val)) == NULL) {
+                return -1;
+            }
+            if ((split = _node_new(NODE4)) == NULL) {
+                free(l);
+                return -1;
+            }
+
+            split->prefix_len = p;
+            memcpy(split->prefix, n->prefix, p < MAX_PREFIX ? p : MAX_PREFIX);
+
+            /* the old node keeps whatever follows the split byte */
+            if (n->prefix_len <= MAX_PREFIX) {
+                edge = n->prefix[p];
+                n->prefix_len -= p + 1;
+                memmove(n->prefix, n->prefix + p + 1, n->prefix_len);
+            } else {
+                bodhi_art_leaf_t *min = _min_leaf(n);
+                edge = min->key[depth + p];
+                n->prefix_len -= p + 1;
+                memcpy(n->prefix, min->key + depth + p + 1,
+                       n->prefix_len < MAX_PREFIX ? n->prefix_len : MAX_PREFIX);
+            }
+
+            /* split is a fresh node4 with room for both */
+            *ref = split;
+            (void) _add_child(ref, split, edge, n);
+            _place_leaf(ref, split, l, depth + p);
+            return 0;
+        }
+
+        depth += n->prefix_len;
+    }
+
+    if (depth == len) {
+        if (n->value != NULL) {
+            return 1;
+        }
+        if ((n->value = _leaf_new(key, len, val)) == NULL) {
+            return -1;
+        }
+        return 0;
+    }
+
+    child = _find_child(n, key[depth]);
+    if (child != NULL) {
+        return _insert(child, key, len, depth + 1, val);
+    }
+
+    if ((l = _leaf_new(key, len, val)) == NULL) {
+        return -1;
+    }
+    if (_add_child(ref, n, key[depth], TAG_LEAF(l)) != 0) {
+        free(l);
+        return -1;
+    }
+    return 0;
+}
+
+int bodhi_art_insert(bodhi_art_t *art, const void *key, size_t len, void *val) {
+    int ret;
+
+    ASSERT(art != NULL, return -1);
+    ASSERT(key != NULL || len == 0, return -1);
+
+    ret = _insert(&art->root, key, len, 0, val);
+    if (ret == 0) {
+        art->size++;
+    }
+
+    return ret;
+}
+
+void *bodhi_art_find_val(bodhi_art_t *art, const void *key, size_t len) {
+    const unsigned char *k = key;
+    void *cur;
+    size_t depth = 0;
+
+    ASSERT(art != NULL, return NULL);
+
+    cur = art->root;
+    while (cur != NULL) {
+        bodhi_art_node_t *n;
+        void **child;
+
+        if (IS_LEAF(cur)) {
+            bodhi_art_leaf_t *l = TO_LEAF(cur);
+            return _leaf_matches(l, k, len) ? l->val : NULL;
+        }
+
+        n = cur;
+        if (n->prefix_len != 0) {
+            size_t stored = n->prefix_len < MAX_PREFIX ? n->prefix_len : MAX_PREFIX;
+            if (depth + n->prefix_len > len || _check_prefix(n, k, len, depth) != stored) {
+                return NULL;
+            }
+            depth += n->prefix_len;
+        }
+
+        if (depth == len) {
+            if (n->value != NULL && _leaf_matches(n->value, k, len)) {
+                return n->value->val;
+            }
+            return NULL;
+        }
+
+        child = _find_child(n, k[depth]);
+        cur = child == NULL ? NULL : *child;
+        depth++;
+    }
+
+    return NULL;
+}
+
+static void _remove_child(void **ref, bodhi_art_node_t *n, unsigned char c, void **child) {
+    int i;
+
+    switch (n->type) {
+        case NODE4: {
+            bodhi_art_node4_t *p = (bodhi_art_node4_t *) n;
+            i = (int) (child - p->children);
+            memmove(p->keys + i, p->keys + i + 1, n->count - i - 1);
+            memmove(p->children + i, p->children + i + 1, (n->count - i - 1) * sizeof(void *));
+            n->count--;
+            break;
+        }
+        case NODE16: {
+            bodhi_art_node16_t *p = (bodhi_art_node16_t *) n;
+            i = (int) (child - p->children);
+            memmove(p->keys + i, p->keys + i + 1, n->count - i - 1);
+            memmove(p->children + i, p->children + i + 1, (n->count - i - 1) * sizeof(void *));
+            n->count--;
+
+            if (n->count == 3) {
+                bodhi_art_node4_t *shrunk = (bodhi_art_node4_t *) _node_new(NODE4);
+                if (shrunk != NULL) {
+                    _copy_header(&shrunk->n, n);
+                    memcpy(shrunk->keys, p->keys, 3);
+                    memcpy(shrunk->children, p->children, 3 * sizeof(void *));
+                    *ref = shrunk;
+                    free(n);
+                    n = &shrunk->n;
+                }
+            }
+            break;
+        }
+        case NODE48: {
+            bodhi_art_node48_t *p = (bodhi_art_node48_t *) n;
+            int slot = p->index[c] - 1;
+            int last = n->count - 1;
+
+            /* keep slots dense by moving the last one into the hole */
+            if (slot != last) {
+                for (i = 0; i < 256 && p->index[i] != last + 1; i++);
+                p->children[slot] = p->children[last];
+                p->index[i] = (unsigned char) (slot + 1);
+            }
+            p->children[last] = NULL;
+            p->index[c] = 0;
+            n->count--;
+
+            if (n->count == 12) {
+                bodhi_art_node16_t *shrunk = (bodhi_art_node16_t *) _node_new(NODE16);
+                if (shrunk != NULL) {
+                    int j = 0;
+                    _copy_header(&shrunk->n, n);
+                    for (i = 0; i < 256; i++) {
+                        if (p->index[i] != 0) {
+                            shrunk->keys[j] = (unsigned char) i;
+                            shrunk->children[j++] = p->children[p->index[i] - 1];
+                        }
+                    }
+                    *ref = shrunk;
+                    free(n);
+                    n = &shrunk->n;
+                }
+            }
+            break;
+        }
+        default: {
+            bodhi_art_node256_t *p = (bodhi_art_node256_t *) n;
+            p->children[c] = NULL;
+            n->count--;
+
+            if (n->count == 37) {
+                bodhi_art_node48_t *shrunk = (bodhi_art_node48_t *) _node_new(NODE48);
+                if (shrunk != NULL) {
+                    int j = 0;
+                    _copy_header(&shrunk->n, n);
+                    for (i = 0; i < 256; i++) {
+                        if (p->children[i] != NULL) {
+                            shrunk->children[j] = p->children[i];
+                            shrunk->index[i] = (unsigned char) ++j;
+                        }
+                    }
+                    *ref = shrunk;
+                    free(n);
+                    n = &shrunk->n;
+                }
+            }
+            break;
+        }
+    }
+}
+
+/*
+ * A node left with a single way down is folded into what remains: its
+ * value leaf or only child takes its place, with the path bytes prepended
+ * to the child's prefix.
+ */
+static void _collapse(void **ref) {
+    bodhi_art_node4_t *n = *ref;
+    bodhi_art_node_t *child;
+    size_t stored;
+
+    if (IS_LEAF(n) || n->n.type != NODE4) {
+        return;
+    }
+
+    if (n->n.count == 0) {
+        *ref = n->n.value == NULL ? NULL : TAG_LEAF(n->n.value);
+        free(n);
+        return;
+    }
+
+    if (n->n.count != 1 || n->n.value != NULL) {
+        return;
+    }
+
+    if (IS_LEAF(n->children[0])) {
+        *ref = n->children[0];
+        free(n);
+        return;
+    }
+
+    child = n->children[0];
+    stored = n->n.prefix_len;
+    if (stored < MAX_PREFIX) {
+        unsigned char merged[MAX_PREFIX];
+        size_t room, take;
+
+        memcpy(merged, n->n.prefix, stored);
+        merged[stored++] = n->keys[0];
+        room = MAX_PREFIX - stored;
+        take = child->prefix_len < room ? child->prefix_len : room;
+        memcpy(merged + stored, child->prefix, take);
+        memcpy(child->prefix, merged, stored + take);
+    } else {
+        memcpy(child->prefix, n->n.prefix, MAX_PREFIX);
+    }
+    child->prefix_len += n->n.prefix_len + 1;
+
+    *ref = child;
+    free(n);
+}
+
+static int _delete(void **ref, const unsigned char *key, size_t len, size_t depth,
+                   void **retval) {
+    void *cur = *ref;
+    bodhi_art_node_t *n;
+    void **child;
+
+    if (cur == NULL) {
+        return 1;
+    }
+
+    if (IS_LEAF(cur)) {
+        bodhi_art_leaf_t *l = TO_LEAF(cur);
+        if (!_leaf_matches(l, key, len)) {
+            return 1;
+        }
+        if (retval != NULL) {
+            *retval = l->val;
+        }
+        free(l);
+        *ref = NULL;
+        return 0;
+    }
+
+    n = cur;
+    if (n->prefix_len != 0) {
+        size_t stored = n->prefix_len < MAX_PREFIX ? n->prefix_len : MAX_PREFIX;
+        if (depth + n->prefix_len > len || _check_prefix(n, key, len, depth) != stored) {
+            return 1;
+        }
+        depth += n->prefix_len;
+    }
+
+    if (depth == len) {
+        if (n->value == NULL || !_leaf_matches(n->value, key, len)) {
+            return 1;
+        }
+        if (retval != NULL) {
+            *retval = n->value->val;
+        }
+        free(n->value);
+        n->value = NULL;
+        _collapse(ref);
+        return 0;
+    }
+
+    child = _find_child(n, key[depth]);
+    if (child == NULL) {
+        return 1;
+    }
+
+    if (IS_LEAF(*child)) {
+        bodhi_art_leaf_t *l = TO_LEAF(*child);
+        if (!_leaf_matches(l, key, len)) {
+            return 1;
+        }
+        if (retval != NULL) {
+            *retval = l->val;
+        }
+        free(l);
+        _remove_child(ref, n, key[depth], child);
+        _collapse(ref);
+        return 0;
+    }
+
+    if (_delete(child, key, len, depth + 1, retval) != 0) {
+        return 1;
+    }
+
+    /* an inner child only vanishes by collapsing into a leaf, never to NULL */
+    return 0;
+}
+
+int bodhi_art_delete(bodhi_art_t *art, const void *key, size_t len, void **retval) {
+    ASSERT(art != NULL, return -1);
+    ASSERT(key != NULL || len == 0, return -1);
+
+    if (_delete(&art->root, key, len, 0, retval) != 0) {
+        return 1;
+    }
+
+    art->size--;
+    return 0;
+}
+
+size_t bodhi_art_size(bodhi_art_t *art) {
+    ASSERT(art != NULL, return 0);
+    return art->size;
+}
+
+static int _walk(void *ref, bodhi_art_cb cb, void *udata) {
+    bodhi_art_node_t *n;
+    int ret, i;
+
+    if (ref == NULL) {
+        return 0;
+    }
+
+    if (IS_LEAF(ref)) {
+        bodhi_art_leaf_t *l = TO_LEAF(ref);
+        return cb(l->key, l->len, l->val, udata);
+    }
+
+    n = ref;
+    if (n->value != NULL && (ret = cb(n->value->key, n->value->len, n->value->val, udata)) != 0) {
+        return ret;
+    }
+
+    switch (n->type) {
+        case NODE4:
+            for (i = 0; i < n->count; i++) {
+                if ((ret = _walk(((bodhi_art_node4_t *) n)->children[i], cb, udata)) != 0) {
+                    return ret;
+                }
+            }
+            break;
+        case NODE16:
+            for (i = 0; i < n->count; i++) {
+                if ((ret = _walk(((bodhi_art_node16_t *) n)->children[i], cb, udata)) != 0) {
+                    return ret;
+                }
+            }
+            break;
+        case NODE48: {
+            bodhi_art_node48_t *p = (bodhi_art_node48_t *) n;
+            for (i = 0; i < 256; i++) {
+                if (p->index[i] != 0 &&
+                    (ret = _walk(p->children[p->index[i] - 1], cb, udata)) != 0) {
+                    return ret;
+                }
+            }
+            break;
+        }
+        default:
+            for (i = 0; i < 256; i++) {
+                if ((ret = _walk(((bodhi_art_node256_t *) n)->children[i], cb, udata)) != 0) {
+                    return ret;
+                }
+            }
+            break;
+    }
+
+    return 0;
+}
+
+/* visits every key in byte-wise lexicographic order */
+int bodhi_art_loop(bodhi_art_t *art, bodhi_art_cb cb, void *udata) {
+    ASSERT(art != NULL, return -1);
+    ASSERT(cb != NULL, return -1);
+
+    return _walk(art->root, cb, udata);
+}
+
+/* visits every key starting with prefix, in order */
+int bodhi_art_prefix(bodhi_art_t *art, const void *prefix, size_t len, bodhi_art_cb cb,
+                     void *udata) {
+    const unsigned char *k = prefix;
+    void *cur;
+    size_t depth = 0;
+
+    ASSERT(art != NULL, return -1);
+    ASSERT(cb != NULL, return -1);
+    ASSERT(prefix != NULL || len == 0, return -1);
+
+    cur = art->root;
+    while (cur != NULL) {
+        bodhi_art_node_t *n;
+        bodhi_art_leaf_t *l;
+        void **child;
+
+        if (IS_LEAF(cur)) {
+            l = TO_LEAF(cur);
+            if (l->len >= len && memcmp(l->key, k, len) == 0) {
+                return _walk(cur, cb, udata);
+            }
+            return 0;
+        }
+
+        n = cur;
+        if (depth + n->prefix_len >= len) {
+            /* the prefix runs out here, every key below shares the min leaf's path */
+            l = _min_leaf(n);
+            if (memcmp(l->key, k, len) == 0) {
+                return _walk(cur, cb, udata);
+            }
+            return 0;
+        }
+
+        if (n->prefix_len != 0) {
+            size_t stored = n->prefix_len < MAX_PREFIX ? n->prefix_len : MAX_PREFIX;
+            if (_check_prefix(n, k, len, depth) != stored) {
+                return 0;
+            }
+            depth += n->prefix_len;
+        }
+
+        child = _find_child(n, k[depth]);
+        cur = child == NULL ? NULL : *child;
+        depth++;
+    }
+
+    return 0;
+}
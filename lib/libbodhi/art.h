@@ -0,0 +1,45 @@
+/*
+ * art.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BODHI_ART_H
+#define BODHI_ART_H
+
+#include <stdlib.h>
+
+/*
+ * An adaptive radix tree over arbitrary byte strings. Inner nodes grow from
+ * 4 to 16, 48 and 256 children as needed and shared prefixes are stored
+ * once, so keys with common prefixes (paths, URLs, metric names) stay
+ * compact and can be enumerated by prefix and in byte order.
+ */
+typedef struct _bodhi_art_t bodhi_art_t;
+
+typedef void (*bodhi_art_free_fn)(void *);
+/* return non-zero to stop the walk */
+typedef int (*bodhi_art_cb)(const unsigned char *key, size_t len, void *val, void *udata);
+
+bodhi_art_t *bodhi_art_new(void);
+void bodhi_art_free(bodhi_art_t *art, bodhi_art_free_fn fn);
+int bodhi_art_insert(bodhi_art_t *art, const void *key, size_t len, void *val);
+int bodhi_art_delete(bodhi_art_t *art, const void *key, size_t len, void **retval);
+void *bodhi_art_find_val(bodhi_art_t *art, const void *key, size_t len);
+size_t bodhi_art_size(bodhi_art_t *art);
+int bodhi_art_loop(bodhi_art_t *art, bodhi_art_cb cb, void *udata);
+int bodhi_art_prefix(bodhi_art_t *art, const void *prefix, size_t len, bodhi_art_cb cb, void *udata);
+
+#endif
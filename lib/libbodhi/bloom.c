@@ -0,0 +1,141 @@
+/*
+ * bloom.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bloom.h"
+#include "util.h"
+
+#define BLOCK_WORDS 8
+
+/* one cache line */
+typedef struct _bodhi_bloom_block_t {
+    uint64_t words[BLOCK_WORDS];
+} bodhi_bloom_block_t;
+
+struct _bodhi_bloom_t {
+    bodhi_bloom_block_t *blocks;
+    size_t nblocks;
+};
+
+/* odd constants, one per word, as in the split block filters of Parquet */
+static const uint32_t salts[BLOCK_WORDS] = {
+    0x47B6137Bu, 0x44974D91u, 0x8824AD5Bu, 0xA2B7289Du,
+    0x705495C7u, 0x2DF1424Bu, 0x9EFC4947u, 0x5C6BFB31u
+};
+
+static uint64_t _mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+/*
+ * Keys per block for the wanted rate. With one bit per word set by each
+ * key, a word with l keys in it has a bit clear with probability
+ * (63/64)^l, and a false positive needs all 8 words to hit. The uneven
+ * spread of keys over blocks costs a bit more, so aim at half the rate.
+ */
+static size_t _keys_per_block(double fpr) {
+    double clear = 1.0;
+    size_t keys = 0;
+
+    fpr /= 2;
+    while (keys < 512) {
+        double p = 1.0 - clear * (63.0 / 64.0);
+        p *= p;
+        p *= p;
+        p *= p;
+        if (p > fpr) {
+            break;
+        }
+        clear *= 63.0 / 64.0;
+        keys++;
+    }
+
+    return keys > 0 ? keys : 1;
+}
+
+bodhi_bloom_t *bodhi_bloom_new(size_t expected, double fpr) {
+    bodhi_bloom_t *ret;
+    void *blocks;
+
+    ASSERT(fpr > 0 && fpr < 1, return NULL);
+
+    CALLOC(ret, 1, sizeof(bodhi_bloom_t), return NULL);
+    ret->nblocks = expected / _keys_per_block(fpr) + 1;
+
+    if (posix_memalign(&blocks, sizeof(bodhi_bloom_block_t),
+                       ret->nblocks * sizeof(bodhi_bloom_block_t)) != 0) {
+        free(ret);
+        return NULL;
+    }
+    ret->blocks = blocks;
+    bodhi_bloom_clear(ret);
+
+    return ret;
+}
+
+void bodhi_bloom_free(bodhi_bloom_t *bloom) {
+    ASSERT(bloom != NULL, return);
+    free(bloom->blocks);
+    free(bloom);
+}
+
+/* the high half picks the block, the low half the bit in every word */
+static bodhi_bloom_block_t *_block(const bodhi_bloom_t *bloom, uint64_t h) {
+    return &bloom->blocks[(size_t) (((h >> 32) * (uint64_t) bloom->nblocks) >> 32)];
+}
+
+void bodhi_bloom_add(bodhi_bloom_t *bloom, uint64_t hash) {
+    uint64_t h = _mix(hash);
+    bodhi_bloom_block_t *block = _block(bloom, h);
+    uint32_t low = (uint32_t) h;
+    int i;
+
+    /* a fixed count of independent lanes, which compilers vectorize */
+    for (i = 0; i < BLOCK_WORDS; i++) {
+        block->words[i] |= (uint64_t) 1 << ((low * salts[i]) >> 26);
+    }
+}
+
+int bodhi_bloom_maybe(const bodhi_bloom_t *bloom, uint64_t hash) {
+    uint64_t h = _mix(hash);
+    const bodhi_bloom_block_t *block = _block(bloom, h);
+    uint32_t low = (uint32_t) h;
+    uint64_t miss = 0;
+    int i;
+
+    for (i = 0; i < BLOCK_WORDS; i++) {
+        miss |= ~block->words[i] & ((uint64_t) 1 << ((low * salts[i]) >> 26));
+    }
+
+    return miss == 0;
+}
+
+void bodhi_bloom_clear(bodhi_bloom_t *bloom) {
+    ASSERT(bloom != NULL, return);
+    memset(bloom->blocks, 0, bloom->nblocks * sizeof(bodhi_bloom_block_t));
+}
+
+size_t bodhi_bloom_memory(const bodhi_bloom_t *bloom) {
+    ASSERT(bloom != NULL, return 0);
+    return sizeof(bodhi_bloom_t) + bloom->nblocks * sizeof(bodhi_bloom_block_t);
+}
@@ -0,0 +1,42 @@
+/*
+ * bloom.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BODHI_BLOOM_H
+#define BODHI_BLOOM_H
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+/*
+ * A blocked Bloom filter: every key sets and tests 8 bits inside a single
+ * 64 byte block, so a lookup costs one cache miss at most. Keys are given
+ * as 64 bit hashes (any reasonable hash works, it is mixed again). A
+ * negative answer is exact, a positive one is wrong about fpr of the time
+ * once the filter holds the expected count.
+ */
+typedef struct _bodhi_bloom_t bodhi_bloom_t;
+
+bodhi_bloom_t *bodhi_bloom_new(size_t expected, double fpr);
+void bodhi_bloom_free(bodhi_bloom_t *bloom);
+void bodhi_bloom_add(bodhi_bloom_t *bloom, uint64_t hash);
+/* 0 if the key was never added, 1 if it may have been */
+int bodhi_bloom_maybe(const bodhi_bloom_t *bloom, uint64_t hash);
+void bodhi_bloom_clear(bodhi_bloom_t *bloom);
+size_t bodhi_bloom_memory(const bodhi_bloom_t *bloom);
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * btree.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BODHI_BTREE_H
+#define BODHI_BTREE_H
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+/*
+ * An ordered map from 32 bit integers to pointers, kept in a B+-tree
+ * whose nodes hold 32 keys each. Lookups touch a handful of nodes
+ * instead of one per bit like bodhi_patricia_t, and the leaves are linked
+ * so ranges are read in order from consecutive slots.
+ */
+typedef struct _bodhi_btree_t bodhi_btree_t;
+
+typedef void (*bodhi_btree_free_fn)(void *);
+/* called with each key and value in a range, non-zero stops the walk */
+typedef int (*bodhi_btree_cb)(uint32_t key, void *val, void *udata);
+
+/* walks the keys in [lo, hi] in order, see bodhi_btree_cursor_init */
+typedef struct _bodhi_btree_cursor_t {
+    void *leaf;
+    int pos;
+    uint32_t hi;
+} bodhi_btree_cursor_t;
+
+bodhi_btree_t *bodhi_btree_new(void);
+/* builds a tree from strictly ascending keys, values may be NULL */
+bodhi_btree_t *bodhi_btree_build_sorted(const uint32_t *keys, void **values, size_t n);
+/* fn, if not NULL, is called on every value that is not NULL */
+void bodhi_btree_free(bodhi_btree_t *tree, bodhi_btree_free_fn fn);
+
+/*
+ * insert returns 0, 1 if the key is already there (leaving its value) or
+ * -1 if memory ran out. delete returns 0 and the value in retval if the
+ * key was removed, 1 if it was not there.
+ */
+int bodhi_btree_insert(bodhi_btree_t *tree, uint32_t key, void *val);
+int bodhi_btree_delete(bodhi_btree_t *tree, uint32_t key, void **retval);
+void *bodhi_btree_find(bodhi_btree_t *tree, uint32_t key);
+size_t bodhi_btree_size(bodhi_btree_t *tree);
+/* bytes allocated for the tree and its nodes */
+size_t bodhi_btree_memory(bodhi_btree_t *tree);
+
+/*
+ * range calls cb for the keys in [lo, hi] in ascending order and returns
+ * how many it visited. A cursor hands them out one at a time, next
+ * returning 0 once it is past hi; the tree must not change meanwhile.
+ */
+size_t bodhi_btree_range(bodhi_btree_t *tree, uint32_t lo, uint32_t hi, bodhi_btree_cb cb, void *udata);
+void bodhi_btree_cursor_init(bodhi_btree_cursor_t *cursor, bodhi_btree_t *tree, uint32_t lo, uint32_t hi);
+int bodhi_btree_cursor_next(bodhi_btree_cursor_t *cursor, uint32_t *key, void **val);
+
+#endif
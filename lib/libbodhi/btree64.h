@@ -0,0 +1,52 @@
+/*
+ * btree64.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BODHI_BTREE64_H
+#define BODHI_BTREE64_H
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include <libbodhi/btree.h>
+
+/* the same tree as bodhi_btree_t keyed by 64 bit integers, 16 keys a node */
+typedef struct _bodhi_btree64_t bodhi_btree64_t;
+
+typedef int (*bodhi_btree64_cb)(uint64_t key, void *val, void *udata);
+
+typedef struct _bodhi_btree64_cursor_t {
+    void *leaf;
+    int pos;
+    uint64_t hi;
+} bodhi_btree64_cursor_t;
+
+bodhi_btree64_t *bodhi_btree64_new(void);
+bodhi_btree64_t *bodhi_btree64_build_sorted(const uint64_t *keys, void **values, size_t n);
+void bodhi_btree64_free(bodhi_btree64_t *tree, bodhi_btree_free_fn fn);
+
+int bodhi_btree64_insert(bodhi_btree64_t *tree, uint64_t key, void *val);
+int bodhi_btree64_delete(bodhi_btree64_t *tree, uint64_t key, void **retval);
+void *bodhi_btree64_find(bodhi_btree64_t *tree, uint64_t key);
+size_t bodhi_btree64_size(bodhi_btree64_t *tree);
+size_t bodhi_btree64_memory(bodhi_btree64_t *tree);
+
+size_t bodhi_btree64_range(bodhi_btree64_t *tree, uint64_t lo, uint64_t hi, bodhi_btree64_cb cb, void *udata);
+void bodhi_btree64_cursor_init(bodhi_btree64_cursor_t *cursor, bodhi_btree64_t *tree, uint64_t lo, uint64_t hi);
+int bodhi_btree64_cursor_next(bodhi_btree64_cursor_t *cursor, uint64_t *key, void **val);
+
+#endif
@@ -0,0 +1,610 @@
+/*
+ * btree_impl.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * The B+-tree itself, written once for every key width. Like
+ * patricia_impl.h it is included by btree.c and btree64.c after they
+ * define the following.
+ *
+ *   BT_PREFIX           function prefix, e.g. bodhi_btree64
+ *   BT_T, BT_STRUCT     the public typedef and its struct tag
+ *   BT_CB               the range callback type
+ *   BT_CURSOR_T         the cursor type
+ *   BT_KEY_T, BT_BITS   the key type and its width
+ *   BT_ORDER            keys per node, a multiple of 4
+ *
+ * Every node starts with its keys in one array, searched by counting the
+ * keys below the one wanted instead of branching on each; with SSE2 the
+ * 32 bit version compares four at a time. Inner node key i is the
+ * smallest key that can be under child i + 1. Leaves hold the values and
+ * are chained in key order for scans.
+ */
+
+#if BT_BITS == 32 && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define BT_SSE2
+#endif
+
+#define BT_CAT_(a, b) a##b
+#define BT_CAT(a, b) BT_CAT_(a, b)
+#define BT_FN(name) BT_CAT(BT_PREFIX, name)
+
+/* fewest keys a node other than the root may have */
+#define BT_MIN_LEAF (BT_ORDER / 2)
+#define BT_MIN_INNER ((BT_ORDER - 1) / 2)
+#define BT_MIN(node) ((node)->leaf ? BT_MIN_LEAF : BT_MIN_INNER)
+
+typedef struct BT_CAT(BT_STRUCT, _node) {
+    int leaf;
+    int count;
+    BT_KEY_T keys[BT_ORDER];
+} BT_FN(_node_t);
+
+typedef struct BT_CAT(BT_STRUCT, _leaf) {
+    BT_FN(_node_t) hdr;
+    void *vals[BT_ORDER];
+    struct BT_CAT(BT_STRUCT, _leaf) *next;
+} BT_FN(_leaf_t);
+
+typedef struct BT_CAT(BT_STRUCT, _inner) {
+    BT_FN(_node_t) hdr;
+    BT_FN(_node_t) *children[BT_ORDER + 1];
+} BT_FN(_inner_t);
+
+#define BT_LEAF(node) ((BT_FN(_leaf_t) *) (node))
+#define BT_INNER(node) ((BT_FN(_inner_t) *) (node))
+
+struct BT_STRUCT {
+    BT_FN(_node_t) *root;
+    size_t size;
+    size_t leaves;
+    size_t inners;
+};
+
+#ifdef BT_SSE2
+/* the number of keys[0..n) below key, or above it with gt set */
+static int BT_FN(_count)(const BT_KEY_T *keys, int n, BT_KEY_T key, int gt) {
+    const __m128i sign = _mm_set1_epi32((int) 0x80000000u);
+    __m128i k = _mm_set1_epi32((int) (key ^ 0x80000000u));
+    int i, c = 0;
+
+    /* unused slots are read but masked off, the array is a multiple of 4 long */
+    for (i = 0; i < n; i += 4) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *) (keys + i)), sign);
+        __m128i m = gt ? _mm_cmpgt_epi32(v, k) : _mm_cmplt_epi32(v, k);
+        unsigned int bits = (unsigned int) _mm_movemask_ps(_mm_castsi128_ps(m));
+
+        if (n - i < 4) {
+            bits &= (1u << (n - i)) - 1;
+        }
+        c += (int) POPCOUNT64(bits);
+    }
+
+    return c;
+}
+#else
+static int BT_FN(_count)(const BT_KEY_T *keys, int n, BT_KEY_T key, int gt) {
+    int i, c = 0;
+
+    if (gt) {
+        for (i = 0; i < n; i++) {
+            c += keys[i] > key;
+        }
+    } else {
+        for (i = 0; i < n; i++) {
+            c += keys[i] < key;
+        }
+    }
+
+    return c;
+}
+#endif
+
+/* where key is or would go in a leaf */
+static int BT_FN(_lower)(BT_FN(_node_t) *node, BT_KEY_T key) {
+    return BT_FN(_count)(node->keys, node->count, key, 0);
+}
+
+/* the child of an inner node key is under */
+static int BT_FN(_child)(BT_FN(_node_t) *node, BT_KEY_T key) {
+    return node->count - BT_FN(_count)(node->keys, node->count, key, 1);
+}
+
+static BT_FN(_node_t) *BT_FN(_alloc)(BT_T *tree, int leaf) {
+    BT_FN(_node_t) *node;
+
+    node = malloc(leaf ? sizeof(BT_FN(_leaf_t)) : sizeof(BT_FN(_inner_t)));
+    if (node == NULL) {
+        return NULL;
+    }
+
+    node->leaf = leaf;
+    node->count = 0;
+    if (leaf) {
+        BT_LEAF(node)->next = NULL;
+        tree->leaves++;
+    } else {
+        tree->inners++;
+    }
+
+    return node;
+}
+
+static void BT_FN(_dealloc)(BT_T *tree, BT_FN(_node_t) *node) {
+    if (node->leaf) {
+        tree->leaves--;
+    } else {
+        tree->inners--;
+    }
+    free(node);
+}
+
+BT_T *BT_FN(_new)(void) {
+    BT_T *tree;
+
+    CALLOC(tree, 1, sizeof(BT_T), return NULL);
+    tree->root = BT_FN(_alloc)(tree, 1);
+    if (tree->root == NULL) {
+        free(tree);
+        return NULL;
+    }
+
+    return tree;
+}
+
+static void BT_FN(_free_node)(BT_FN(_node_t) *node, bodhi_btree_free_fn fn) {
+    int i;
+
+    if (node->leaf) {
+        for (i = 0; fn != NULL && i < node->count; i++) {
+            if (BT_LEAF(node)->vals[i] != NULL) {
+                fn(BT_LEAF(node)->vals[i]);
+            }
+        }
+    } else {
+        for (i = 0; i <= node->count; i++) {
+            BT_FN(_free_node)(BT_INNER(node)->children[i], fn);
+        }
+    }
+
+    free(node);
+}
+
+void BT_FN(_free)(BT_T *tree, bodhi_btree_free_fn fn) {
+    ASSERT(tree != NULL, return);
+    BT_FN(_free_node)(tree->root, fn);
+    free(tree);
+}
+
+static BT_FN(_leaf_t) *BT_FN(_find_leaf)(BT_T *tree, BT_KEY_T key) {
+    BT_FN(_node_t) *node = tree->root;
+
+    while (!node->leaf) {
+        node = BT_INNER(node)->children[BT_FN(_child)(node, key)];
+    }
+
+    return BT_LEAF(node);
+}
+
+void *BT_FN(_find)(BT_T *tree, BT_KEY_T key) {
+    BT_FN(_leaf_t) *leaf;
+    int i;
+
+    ASSERT(tree != NULL, return NULL);
+
+    leaf = BT_FN(_find_leaf)(tree, key);
+    i = BT_FN(_lower)(&leaf->hdr, key);
+    if (i < leaf->hdr.count && leaf->hdr.keys[i] == key) {
+        return leaf->vals[i];
+    }
+
+    return NULL;
+}
+
+/* splits the full child c of parent, which has room for one more key */
+static int BT_FN(_split)(BT_T *tree, BT_FN(_node_t) *parent, int c) {
+    BT_FN(_node_t) *child = BT_INNER(parent)->children[c];
+    BT_FN(_node_t) *right = BT_FN(_alloc)(tree, child->leaf);
+    BT_KEY_T sep;
+    int mid = BT_ORDER / 2;
+
+    if (right == NULL) {
+        return -1;
+    }
+
+    if (child->leaf) {
+        /* both halves keep mid keys, the right one's first goes up */
+        right->count = BT_ORDER - mid;
+        memcpy(right->keys, child->keys + mid, (size_t) right->count * sizeof(BT_KEY_T));
+        memcpy(BT_LEAF(right)->vals, BT_LEAF(child)->vals + mid, (size_t) right->count * sizeof(void *));
+        BT_LEAF(right)->next = BT_LEAF(child)->next;
+        BT_LEAF(child)->next = BT_LEAF(right);
+        sep = right->keys[0];
+    } else {
+        /* key mid moves up, the ones after it go right */
+        right->count = BT_ORDER - mid - 1;
+        memcpy(right->keys, child->keys + mid + 1, (size_t) right->count * sizeof(BT_KEY_T));
+        memcpy(BT_INNER(right)->children, BT_INNER(child)->children + mid + 1,
+               (size_t) (right->count + 1) * sizeof(BT_FN(_node_t) *));
+        sep = child->keys[mid];
+    }
+    child->count = mid;
+
+    memmove(parent->keys + c + 1, parent->keys + c, (size_t) (parent->count - c) * sizeof(BT_KEY_T));
+    memmove(BT_INNER(parent)->children + c + 2, BT_INNER(parent)->children + c + 1,
+            (size_t) (parent->count - c) * sizeof(BT_FN(_node_t) *));
+    parent->keys[c] = sep;
+    BT_INNER(parent)->children[c + 1] = right;
+    parent->count++;
+
+    return 0;
+}
+
+/*
+ * Full nodes are split on the way down, so there is always room for
+ * what a split below pushes up and running out of memory leaves a valid
+ * tree behind.
+ */
+int BT_FN(_insert)(BT_T *tree, BT_KEY_T key, void *val) {
+    BT_FN(_node_t) *node;
+    int i;
+
+    ASSERT(tree != NULL, return -1);
+
+    if (tree->root->count == BT_ORDER) {
+        BT_FN(_node_t) *root = BT_FN(_alloc)(tree, 0);
+
+        if (root == NULL) {
+            return -1;
+        }
+        BT_INNER(root)->children[0] = tree->root;
+        if (BT_FN(_split)(tree, root, 0) != 0) {
+            BT_FN(_dealloc)(tree, root);
+            return -1;
+        }
+        tree->root = root;
+    }
+
+    node = tree->root;
+    while (!node->leaf) {
+        i = BT_FN(_child)(node, key);
+        if (BT_INNER(node)->children[i]->count == BT_ORDER) {
+            if (BT_FN(_split)(tree, node, i) != 0) {
+                return -1;
+            }
+            if (key >= node->keys[i]) {
+                i++;
+            }
+        }
+        node = BT_INNER(node)->children[i];
+    }
+
+    i = BT_FN(_lower)(node, key);
+    if (i < node->count && node->keys[i] == key) {
+        return 1;
+    }
+
+    memmove(node->keys + i + 1, node->keys + i, (size_t) (node->count - i) * sizeof(BT_KEY_T));
+    memmove(BT_LEAF(node)->vals + i + 1, BT_LEAF(node)->vals + i, (size_t) (node->count - i) * sizeof(void *));
+    node->keys[i] = key;
+    BT_LEAF(node)->vals[i] = val;
+    node->count++;
+    tree->size++;
+
+    return 0;
+}
+
+/* folds child i + 1 of parent into child i */
+static BT_FN(_node_t) *BT_FN(_merge)(BT_T *tree, BT_FN(_node_t) *parent, int i) {
+    BT_FN(_node_t) *left = BT_INNER(parent)->children[i];
+    BT_FN(_node_t) *right = BT_INNER(parent)->children[i + 1];
+
+    if (left->leaf) {
+        memcpy(left->keys + left->count, right->keys, (size_t) right->count * sizeof(BT_KEY_T));
+        memcpy(BT_LEAF(left)->vals + left->count, BT_LEAF(right)->vals, (size_t) right->count * sizeof(void *));
+        BT_LEAF(left)->next = BT_LEAF(right)->next;
+        left->count += right->count;
+    } else {
+        left->keys[left->count] = parent->keys[i];
+        memcpy(left->keys + left->count + 1, right->keys, (size_t) right->count * sizeof(BT_KEY_T));
+        memcpy(BT_INNER(left)->children + left->count + 1, BT_INNER(right)->children,
+               (size_t) (right->count + 1) * sizeof(BT_FN(_node_t) *));
+        left->count += right->count + 1;
+    }
+
+    memmove(parent->keys + i, parent->keys + i + 1, (size_t) (parent->count - i - 1) * sizeof(BT_KEY_T));
+    memmove(BT_INNER(parent)->children + i + 1, BT_INNER(parent)->children + i + 2,
+            (size_t) (parent->count - i - 1) * sizeof(BT_FN(_node_t) *));
+    parent->count--;
+    BT_FN(_dealloc)(tree, right);
+
+    return left;
+}
+
+/* gives child c of parent a key more than the minimum, returning where c's keys now are */
+static BT_FN(_node_t) *BT_FN(_fill)(BT_T *tree, BT_FN(_node_t) *parent, int c) {
+    BT_FN(_node_t) **children = BT_INNER(parent)->children;
+    BT_FN(_node_t) *child = children[c];
+    BT_FN(_node_t) *sib;
+
+    if (c > 0 && children[c - 1]->count > BT_MIN(child)) {
+        /* the left sibling's last key moves over */
+        sib = children[c - 1];
+        memmove(child->keys + 1, child->keys, (size_t) child->count * sizeof(BT_KEY_T));
+        if (child->leaf) {
+            memmove(BT_LEAF(child)->vals + 1, BT_LEAF(child)->vals, (size_t) child->count * sizeof(void *));
+            child->keys[0] = sib->keys[sib->count - 1];
+            BT_LEAF(child)->vals[0] = BT_LEAF(sib)->vals[sib->count - 1];
+            parent->keys[c - 1] = child->keys[0];
+        } else {
+            memmove(BT_INNER(child)->children + 1, BT_INNER(child)->children,
+                    (size_t) (child->count + 1) * sizeof(BT_FN(_node_t) *));
+            child->keys[0] = parent->keys[c - 1];
+            BT_INNER(child)->children[0] = BT_INNER(sib)->children[sib->count];
+            parent->keys[c - 1] = sib->keys[sib->count - 1];
+        }
+        child->count++;
+        sib->count--;
+        return child;
+    }
+
+    if (c < parent->count && children[c + 1]->count > BT_MIN(child)) {
+        /* and the right one's first */
+        sib = children[c + 1];
+        if (child->leaf) {
+            child->keys[child->count] = sib->keys[0];
+            BT_LEAF(child)->vals[child->count] = BT_LEAF(sib)->vals[0];
+            memmove(BT_LEAF(sib)->vals, BT_LEAF(sib)->vals + 1, (size_t) (sib->count - 1) * sizeof(void *));
+            memmove(sib->keys, sib->keys + 1, (size_t) (sib->count - 1) * sizeof(BT_KEY_T));
+            parent->keys[c] = sib->keys[0];
+        } else {
+            child->keys[child->count] = parent->keys[c];
+            BT_INNER(child)->children[child->count + 1] = BT_INNER(sib)->children[0];
+            parent->keys[c] = sib->keys[0];
+            memmove(sib->keys, sib->keys + 1, (size_t) (sib->count - 1) * sizeof(BT_KEY_T));
+            memmove(BT_INNER(sib)->children, BT_INNER(sib)->children + 1,
+                    (size_t) sib->count * sizeof(BT_FN(_node_t) *));
+        }
+        child->count++;
+        sib->count--;
+        return child;
+    }
+
+    return c < parent->count ? BT_FN(_merge)(tree, parent, c) : BT_FN(_merge)(tree, parent, c - 1);
+}
+
+/* nodes at the minimum are filled on the way down, so the leaf can always give up a key */
+int BT_FN(_delete)(BT_T *tree, BT_KEY_T key, void **retval) {
+    BT_FN(_node_t) *node;
+    int i;
+
+    ASSERT(tree != NULL, return 1);
+
+    node = tree->root;
+    while (!node->leaf) {
+        i = BT_FN(_child)(node, key);
+        if (BT_INNER(node)->children[i]->count <= BT_MIN(BT_INNER(node)->children[i])) {
+            node = BT_FN(_fill)(tree, node, i);
+        } else {
+            node = BT_INNER(node)->children[i];
+        }
+    }
+
+    /* merges below may have left the root with a single child */
+    while (!tree->root->leaf && tree->root->count == 0) {
+        BT_FN(_node_t) *root = tree->root;
+
+        tree->root = BT_INNER(root)->children[0];
+        BT_FN(_dealloc)(tree, root);
+    }
+
+    i = BT_FN(_lower)(node, key);
+    if (i == node->count || node->keys[i] != key) {
+        return 1;
+    }
+
+    if (retval != NULL) {
+        *retval = BT_LEAF(node)->vals[i];
+    }
+    memmove(node->keys + i, node->keys + i + 1, (size_t) (node->count - i - 1) * sizeof(BT_KEY_T));
+    memmove(BT_LEAF(node)->vals + i, BT_LEAF(node)->vals + i + 1, (size_t) (node->count - i - 1) * sizeof(void *));
+    node->count--;
+    tree->size--;
+
+    return 0;
+}
+
+size_t BT_FN(_size)(BT_T *tree) {
+    ASSERT(tree != NULL, return 0);
+    return tree->size;
+}
+
+size_t BT_FN(_memory)(BT_T *tree) {
+    ASSERT(tree != NULL, return 0);
+    return sizeof(BT_T) + tree->leaves * sizeof(BT_FN(_leaf_t)) + tree->inners * sizeof(BT_FN(_inner_t));
+}
+
+void BT_FN(_cursor_init)(BT_CURSOR_T *cursor, BT_T *tree, BT_KEY_T lo, BT_KEY_T hi) {
+    BT_FN(_leaf_t) *leaf;
+
+    ASSERT(cursor != NULL, return);
+
+    cursor->leaf = NULL;
+    cursor->pos = 0;
+    cursor->hi = hi;
+    if (tree == NULL || lo > hi) {
+        return;
+    }
+
+    leaf = BT_FN(_find_leaf)(tree, lo);
+    cursor->leaf = leaf;
+    cursor->pos = BT_FN(_lower)(&leaf->hdr, lo);
+}
+
+int BT_FN(_cursor_next)(BT_CURSOR_T *cursor, BT_KEY_T *key, void **val) {
+    BT_FN(_leaf_t) *leaf;
+
+    ASSERT(cursor != NULL, return 0);
+
+    leaf = cursor->leaf;
+    while (leaf != NULL && cursor->pos == leaf->hdr.count) {
+        leaf = leaf->next;
+        cursor->pos = 0;
+    }
+    cursor->leaf = leaf;
+
+    if (leaf == NULL || leaf->hdr.keys[cursor->pos] > cursor->hi) {
+        cursor->leaf = NULL;
+        return 0;
+    }
+
+    if (key != NULL) {
+        *key = leaf->hdr.keys[cursor->pos];
+    }
+    if (val != NULL) {
+        *val = leaf->vals[cursor->pos];
+    }
+    cursor->pos++;
+
+    return 1;
+}
+
+size_t BT_FN(_range)(BT_T *tree, BT_KEY_T lo, BT_KEY_T hi, BT_CB cb, void *udata) {
+    BT_CURSOR_T cursor;
+    BT_KEY_T key;
+    void *val;
+    size_t n = 0;
+
+    ASSERT(tree != NULL, return 0);
+
+    BT_FN(_cursor_init)(&cursor, tree, lo, hi);
+    while (BT_FN(_cursor_next)(&cursor, &key, &val)) {
+        n++;
+        if (cb != NULL && cb(key, val, udata) != 0) {
+            break;
+        }
+    }
+
+    return n;
+}
+
+/*
+ * Bulk loading fills the leaves left to right and then each level of
+ * inner nodes above them, spreading entries evenly so no node ends up
+ * below the minimum. Nodes are packed full, the first insert into one
+ * splits it.
+ */
+BT_T *BT_FN(_build_sorted)(const BT_KEY_T *keys, void **values, size_t n) {
+    BT_FN(_node_t) **level;
+    BT_KEY_T *mins;
+    BT_T *tree;
+    size_t count, parents, i, j, at;
+
+    ASSERT(keys != NULL || n == 0, return NULL);
+    for (i = 1; i < n; i++) {
+        ASSERT(keys[i - 1] < keys[i], return NULL);
+    }
+
+    tree = BT_FN(_new)();
+    if (tree == NULL || n == 0) {
+        return tree;
+    }
+
+    count = (n + BT_ORDER - 1) / BT_ORDER;
+    level = malloc(count * sizeof(BT_FN(_node_t) *));
+    mins = malloc(count * sizeof(BT_KEY_T));
+    if (level == NULL || mins == NULL) {
+        goto fail;
+    }
+
+    /* the root from _new is the first leaf */
+    level[0] = tree->root;
+    for (i = 1; i < count; i++) {
+        if ((level[i] = BT_FN(_alloc)(tree, 1)) == NULL) {
+            count = i;
+            goto fail_level;
+        }
+        BT_LEAF(level[i - 1])->next = BT_LEAF(level[i]);
+    }
+
+    for (i = 0, at = 0; i < count; i++) {
+        BT_FN(_node_t) *leaf = level[i];
+
+        leaf->count = (int) (n / count + (i < n % count));
+        memcpy(leaf->keys, keys + at, (size_t) leaf->count * sizeof(BT_KEY_T));
+        for (j = 0; j < (size_t) leaf->count; j++) {
+            BT_LEAF(leaf)->vals[j] = values != NULL ? values[at + j] : NULL;
+        }
+        mins[i] = keys[at];
+        at += (size_t) leaf->count;
+    }
+
+    while (count > 1) {
+        parents = (count + BT_ORDER) / (BT_ORDER + 1);
+
+        for (i = 0, at = 0; i < parents; i++) {
+            BT_FN(_node_t) *parent = BT_FN(_alloc)(tree, 0);
+            size_t children = count / parents + (i < count % parents);
+
+            if (parent == NULL) {
+                /* the rest of this level is still in level[], parents so far in level[0..i) */
+                tree->root = NULL;
+                for (j = at; j < count; j++) {
+                    BT_FN(_free_node)(level[j], NULL);
+                }
+                count = i;
+                goto fail_level;
+            }
+
+            BT_INNER(parent)->children[0] = level[at];
+            for (j = 1; j < children; j++) {
+                parent->keys[j - 1] = mins[at + j];
+                BT_INNER(parent)->children[j] = level[at + j];
+            }
+            parent->count = (int) children - 1;
+
+            mins[i] = mins[at];
+            level[i] = parent;
+            at += children;
+        }
+
+        count = parents;
+    }
+
+    tree->root = level[0];
+    tree->size = n;
+    free(level);
+    free(mins);
+    return tree;
+
+fail_level:
+    tree->root = NULL;
+    for (i = 0; i < count; i++) {
+        BT_FN(_free_node)(level[i], NULL);
+    }
+    free(level);
+    free(mins);
+    free(tree);
+    return NULL;
+
+fail:
+    free(level);
+    free(mins);
+    BT_FN(_free)(tree, NULL);
+    return NULL;
+}
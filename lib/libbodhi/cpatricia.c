@@ -0,0 +1,223 @@
+/*
+ * cpatricia.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include "cpatricia.h"
+#include "util.h"
+
+/* writers reclaim once this many nodes are waiting */
+#define RECLAIM_THRESHOLD 128
+
+typedef struct _bodhi_cpatricia_node_t {
+    struct _bodhi_cpatricia_node_t *left;
+    struct _bodhi_cpatricia_node_t *right;
+
+    uint32_t key;
+    int isset;
+    int pos;
+    void *data;
+} bodhi_cpatricia_node_t;
+
+struct _bodhi_cpatricia_t {
+    bodhi_cpatricia_node_t *root;
+    size_t size;
+    bodhi_epoch_t *epoch;
+};
+
+#define KEY_BIT(k, i) (((k) >> (31 - (i))) & 1)
+
+bodhi_cpatricia_t *bodhi_cpatricia_new(size_t max_readers) {
+    bodhi_cpatricia_t *ret;
+
+    CALLOC(ret, 1, sizeof(bodhi_cpatricia_t), return NULL);
+
+    ret->epoch = bodhi_epoch_new(max_readers);
+    if (ret->epoch == NULL) {
+        free(ret);
+        return NULL;
+    }
+
+    return ret;
+}
+
+static void _bodhi_cpatricia_node_free(bodhi_cpatricia_node_t *node, trie_free_fn fn) {
+    if (node == NULL) {
+        return;
+    }
+
+    _bodhi_cpatricia_node_free(node->left, fn);
+    _bodhi_cpatricia_node_free(node->right, fn);
+
+    if (node->isset && node->data != NULL && fn != NULL) {
+        fn(node->data);
+    }
+    free(node);
+}
+
+void bodhi_cpatricia_free(bodhi_cpatricia_t *trie, trie_free_fn fn) {
+    ASSERT(trie != NULL, return);
+
+    _bodhi_cpatricia_node_free(trie->root, fn);
+    bodhi_epoch_free(trie->epoch);
+    free(trie);
+}
+
+bodhi_epoch_t *bodhi_cpatricia_epoch(bodhi_cpatricia_t *trie) {
+    ASSERT(trie != NULL, return NULL);
+    return trie->epoch;
+}
+
+bodhi_epoch_reader_t *bodhi_cpatricia_reader(bodhi_cpatricia_t *trie) {
+    ASSERT(trie != NULL, return NULL);
+    return bodhi_epoch_register(trie->epoch);
+}
+
+int bodhi_cpatricia_add(bodhi_cpatricia_t *trie, uint32_t key, void *data) {
+    bodhi_cpatricia_node_t **link;
+    bodhi_cpatricia_node_t *node;
+    bodhi_cpatricia_node_t *new;
+    bodhi_cpatricia_node_t *new_parent;
+    int shared_bits;
+
+    ASSERT(trie != NULL, return 0);
+
+    CALLOC(new, 1, sizeof(bodhi_cpatricia_node_t), return 0);
+    new->key = key;
+    new->data = data;
+    new->pos = 32;
+    new->isset = 1;
+
+    if (trie->root == NULL) {
+        ATOMIC_STORE(&trie->root, new);
+        trie->size++;
+        return 1;
+    }
+
+    /* only the writer changes links, so they can be read without atomics */
+    for (link = &trie->root; ; ) {
+        node = *link;
+
+        if (node->isset && node->key == key) {
+            free(new);
+            return 0;
+        }
+
+        shared_bits = (int) CLZ32(key ^ node->key);
+        if (node->pos > shared_bits) {
+            break;
+        }
+
+        link = KEY_BIT(key, node->pos) ? &node->right : &node->left;
+    }
+
+    CALLOC(new_parent, 1, sizeof(bodhi_cpatricia_node_t), free(new); return 0);
+    new_parent->pos = shared_bits;
+    new_parent->key = shared_bits == 0 ? 0 : key & (0xFFFFFFFFu << (32 - shared_bits));
+
+    if (KEY_BIT(key, shared_bits)) {
+        new_parent->left = node;
+        new_parent->right = new;
+    } else {
+        new_parent->left = new;
+        new_parent->right = node;
+    }
+
+    /* the new subtree is complete before readers can see it */
+    ATOMIC_STORE(link, new_parent);
+    trie->size++;
+
+    return 1;
+}
+
+/* hands an unlinked node to the epoch, or frees it after a grace period if that fails */
+static void _bodhi_cpatricia_retire(bodhi_cpatricia_t *trie, bodhi_cpatricia_node_t *node) {
+    if (bodhi_epoch_retire(trie->epoch, node, free) != 0) {
+        bodhi_epoch_synchronize(trie->epoch);
+        free(node);
+    }
+}
+
+int bodhi_cpatricia_remove(bodhi_cpatricia_t *trie, uint32_t key, void **retval) {
+    bodhi_cpatricia_node_t **plink = NULL;
+    bodhi_cpatricia_node_t **link;
+    bodhi_cpatricia_node_t *node;
+    bodhi_cpatricia_node_t *parent;
+
+    ASSERT(trie != NULL, return 0);
+
+    link = &trie->root;
+    if (*link == NULL) {
+        return 0;
+    }
+
+    while (!(*link)->isset) {
+        plink = link;
+        link = KEY_BIT(key, (*link)->pos) ? &(*link)->right : &(*link)->left;
+    }
+
+    node = *link;
+    if (node->key != key) {
+        return 0;
+    }
+
+    if (retval != NULL) {
+        *retval = node->data;
+    }
+
+    if (plink == NULL) {
+        ATOMIC_STORE(&trie->root, NULL);
+    } else {
+        /*
+         * the sister replaces the parent; readers already on the parent
+         * still find both its children intact
+         */
+        parent = *plink;
+        ATOMIC_STORE(plink, link == &parent->left ? parent->right : parent->left);
+        _bodhi_cpatricia_retire(trie, parent);
+    }
+
+    _bodhi_cpatricia_retire(trie, node);
+    trie->size--;
+
+    if (bodhi_epoch_pending(trie->epoch) >= RECLAIM_THRESHOLD) {
+        bodhi_epoch_reclaim(trie->epoch);
+    }
+
+    return 1;
+}
+
+size_t bodhi_cpatricia_size(bodhi_cpatricia_t *trie) {
+    ASSERT(trie != NULL, return 0);
+    return trie->size;
+}
+
+void *bodhi_cpatricia_find_val(bodhi_cpatricia_t *trie, uint32_t key) {
+    bodhi_cpatricia_node_t *node = ATOMIC_LOAD(&trie->root);
+
+    while (node != NULL) {
+        if (node->isset) {
+            return node->key == key ? node->data : NULL;
+        }
+
+        node = KEY_BIT(key, node->pos) ? ATOMIC_LOAD(&node->right) : ATOMIC_LOAD(&node->left);
+    }
+
+    return NULL;
+}
@@ -0,0 +1,51 @@
+/*
+ * cpatricia.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BODHI_CPATRICIA_H
+#define BODHI_CPATRICIA_H
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include <libbodhi/epoch.h>
+#include <libbodhi/patricia.h>
+
+/*
+ * A patricia trie for many readers and one writer. Readers take no locks:
+ * they register once, then bracket lookups with bodhi_epoch_enter and
+ * bodhi_epoch_exit on their reader. Values found are only safe to use until
+ * the matching exit. Writers must be serialised by the caller; changes are
+ * published with release stores and unlinked nodes are freed once no reader
+ * can reach them.
+ */
+typedef struct _bodhi_cpatricia_t bodhi_cpatricia_t;
+
+bodhi_cpatricia_t *bodhi_cpatricia_new(size_t max_readers);
+void bodhi_cpatricia_free(bodhi_cpatricia_t *trie, trie_free_fn fn);
+bodhi_epoch_t *bodhi_cpatricia_epoch(bodhi_cpatricia_t *trie);
+bodhi_epoch_reader_t *bodhi_cpatricia_reader(bodhi_cpatricia_t *trie);
+
+/* writer side; a removed value should go through bodhi_epoch_retire */
+int bodhi_cpatricia_add(bodhi_cpatricia_t *trie, uint32_t key, void *data);
+int bodhi_cpatricia_remove(bodhi_cpatricia_t *trie, uint32_t key, void **retval);
+size_t bodhi_cpatricia_size(bodhi_cpatricia_t *trie);
+
+/* reader side, call between bodhi_epoch_enter and bodhi_epoch_exit */
+void *bodhi_cpatricia_find_val(bodhi_cpatricia_t *trie, uint32_t key);
+
+#endif
@@ -0,0 +1,249 @@
+/*
+ * cuckoo.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cuckoo.h"
+#include "util.h"
+
+#define SLOTS 4
+#define MAX_KICKS 500
+
+/*
+ * Fingerprints are stored in 1 or 2 bytes, 0 marking an empty slot. The
+ * other bucket of a fingerprint is found from the one it is in and the
+ * fingerprint alone, which is what lets entries be moved without the key.
+ */
+struct _bodhi_cuckoo_t {
+    unsigned char *slots;
+    size_t nbuckets;
+    size_t size;
+    int width;
+    uint32_t fp_mask;
+
+    /* the entry that could not be placed once the table filled up */
+    int has_victim;
+    size_t victim_bucket;
+    uint32_t victim_fp;
+
+    uint64_t rng;
+};
+
+static uint64_t _mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+static uint32_t _get(const bodhi_cuckoo_t *c, size_t bucket, int slot) {
+    size_t i = bucket * SLOTS + (size_t) slot;
+    uint16_t v;
+
+    if (c->width == 1) {
+        return c->slots[i];
+    }
+
+    memcpy(&v, c->slots + i * 2, 2);
+    return v;
+}
+
+static void _set(bodhi_cuckoo_t *c, size_t bucket, int slot, uint32_t fp) {
+    size_t i = bucket * SLOTS + (size_t) slot;
+    uint16_t v = (uint16_t) fp;
+
+    if (c->width == 1) {
+        c->slots[i] = (unsigned char) fp;
+    } else {
+        memcpy(c->slots + i * 2, &v, 2);
+    }
+}
+
+static size_t _alt(const bodhi_cuckoo_t *c, size_t bucket, uint32_t fp) {
+    return (bucket ^ (size_t) _mix(fp)) & (c->nbuckets - 1);
+}
+
+static void _locate(const bodhi_cuckoo_t *c, uint64_t hash, size_t *bucket, uint32_t *fp) {
+    uint64_t h = _mix(hash);
+
+    *fp = (uint32_t) (h >> 32) & c->fp_mask;
+    if (*fp == 0) {
+        *fp = 1;
+    }
+    *bucket = (size_t) h & (c->nbuckets - 1);
+}
+
+bodhi_cuckoo_t *bodhi_cuckoo_new(size_t expected, double fpr) {
+    bodhi_cuckoo_t *ret;
+    size_t want;
+
+    ASSERT(fpr > 0 && fpr < 1, return NULL);
+
+    CALLOC(ret, 1, sizeof(bodhi_cuckoo_t), return NULL);
+
+    /* a lookup compares against 8 slots, so the rate is about 8 / 2^bits */
+    ret->width = fpr >= 8.0 / 256 ? 1 : 2;
+    ret->fp_mask = ret->width == 1 ? 0xFFu : 0xFFFFu;
+
+    /* buckets are a power of two, filled to at most 95% */
+    want = expected / SLOTS + expected / (SLOTS * 19) + 1;
+    ret->nbuckets = 1;
+    while (ret->nbuckets < want) {
+        ret->nbuckets *= 2;
+    }
+
+    CALLOC(ret->slots, ret->nbuckets * SLOTS, (size_t) ret->width, free(ret); return NULL);
+    ret->rng = 0x9E3779B97F4A7C15ull;
+
+    return ret;
+}
+
+void bodhi_cuckoo_free(bodhi_cuckoo_t *cuckoo) {
+    ASSERT(cuckoo != NULL, return);
+    free(cuckoo->slots);
+    free(cuckoo);
+}
+
+static int _put(bodhi_cuckoo_t *c, size_t bucket, uint32_t fp) {
+    int i;
+
+    for (i = 0; i < SLOTS; i++) {
+        if (_get(c, bucket, i) == 0) {
+            _set(c, bucket, i, fp);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int bodhi_cuckoo_add(bodhi_cuckoo_t *cuckoo, uint64_t hash) {
+    size_t bucket;
+    uint32_t fp;
+    int kick;
+
+    ASSERT(cuckoo != NULL, return -1);
+
+    if (cuckoo->has_victim) {
+        return -1;
+    }
+
+    _locate(cuckoo, hash, &bucket, &fp);
+    cuckoo->size++;
+
+    if (_put(cuckoo, bucket, fp) || _put(cuckoo, bucket = _alt(cuckoo, bucket, fp), fp)) {
+        return 0;
+    }
+
+    /* evict a random resident to its other bucket until something fits */
+    for (kick = 0; kick < MAX_KICKS; kick++) {
+        int slot = (int) ((cuckoo->rng = _mix(cuckoo->rng)) % SLOTS);
+        uint32_t old = _get(cuckoo, bucket, slot);
+
+        _set(cuckoo, bucket, slot, fp);
+        fp = old;
+        bucket = _alt(cuckoo, bucket, fp);
+        if (_put(cuckoo, bucket, fp)) {
+            return 0;
+        }
+    }
+
+    /* the key is in, but some older fingerprint is now homeless; keep it aside */
+    cuckoo->has_victim = 1;
+    cuckoo->victim_bucket = bucket;
+    cuckoo->victim_fp = fp;
+    return 0;
+}
+
+static int _victim_is(const bodhi_cuckoo_t *c, size_t bucket, uint32_t fp) {
+    return c->has_victim && c->victim_fp == fp &&
+           (c->victim_bucket == bucket || c->victim_bucket == _alt(c, bucket, fp));
+}
+
+int bodhi_cuckoo_remove(bodhi_cuckoo_t *cuckoo, uint64_t hash) {
+    size_t bucket, alt;
+    uint32_t fp;
+    int i;
+
+    ASSERT(cuckoo != NULL, return 1);
+
+    _locate(cuckoo, hash, &bucket, &fp);
+    alt = _alt(cuckoo, bucket, fp);
+
+    if (_victim_is(cuckoo, bucket, fp)) {
+        cuckoo->has_victim = 0;
+        cuckoo->size--;
+        return 0;
+    }
+
+    for (i = 0; i < SLOTS; i++) {
+        if (_get(cuckoo, bucket, i) == fp) {
+            _set(cuckoo, bucket, i, 0);
+            break;
+        } else if (_get(cuckoo, alt, i) == fp) {
+            _set(cuckoo, alt, i, 0);
+            break;
+        }
+    }
+
+    if (i == SLOTS) {
+        return 1;
+    }
+
+    cuckoo->size--;
+
+    /* a slot opened up, give the victim another chance */
+    if (cuckoo->has_victim) {
+        size_t vb = cuckoo->victim_bucket;
+        uint32_t vfp = cuckoo->victim_fp;
+
+        if (_put(cuckoo, vb, vfp) || _put(cuckoo, _alt(cuckoo, vb, vfp), vfp)) {
+            cuckoo->has_victim = 0;
+        }
+    }
+
+    return 0;
+}
+
+int bodhi_cuckoo_maybe(const bodhi_cuckoo_t *cuckoo, uint64_t hash) {
+    size_t bucket, alt;
+    uint32_t fp;
+    int i;
+
+    _locate(cuckoo, hash, &bucket, &fp);
+    alt = _alt(cuckoo, bucket, fp);
+
+    for (i = 0; i < SLOTS; i++) {
+        if (_get(cuckoo, bucket, i) == fp || _get(cuckoo, alt, i) == fp) {
+            return 1;
+        }
+    }
+
+    return _victim_is(cuckoo, bucket, fp);
+}
+
+size_t bodhi_cuckoo_size(const bodhi_cuckoo_t *cuckoo) {
+    ASSERT(cuckoo != NULL, return 0);
+    return cuckoo->size;
+}
+
+size_t bodhi_cuckoo_memory(const bodhi_cuckoo_t *cuckoo) {
+    ASSERT(cuckoo != NULL, return 0);
+    return sizeof(bodhi_cuckoo_t) + cuckoo->nbuckets * SLOTS * (size_t) cuckoo->width;
+}
@@ -0,0 +1,45 @@
+/*
+ * cuckoo.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BODHI_CUCKOO_H
+#define BODHI_CUCKOO_H
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+/*
+ * A cuckoo filter: a fingerprint of each key lives in one of two buckets
+ * of four slots, so unlike a Bloom filter keys can be removed again. Keys
+ * are 64 bit hashes as for bodhi_bloom_t, fpr picks 8 or 16 bit
+ * fingerprints. An add can fail once the table is nearly full; the filter
+ * stays correct for everything added before.
+ */
+typedef struct _bodhi_cuckoo_t bodhi_cuckoo_t;
+
+bodhi_cuckoo_t *bodhi_cuckoo_new(size_t expected, double fpr);
+void bodhi_cuckoo_free(bodhi_cuckoo_t *cuckoo);
+/* 0 when added, -1 when the filter is full */
+int bodhi_cuckoo_add(bodhi_cuckoo_t *cuckoo, uint64_t hash);
+/* 0 when removed, 1 if no such fingerprint; only remove what was added */
+int bodhi_cuckoo_remove(bodhi_cuckoo_t *cuckoo, uint64_t hash);
+/* 0 if the key is not in the filter, 1 if it may be */
+int bodhi_cuckoo_maybe(const bodhi_cuckoo_t *cuckoo, uint64_t hash);
+size_t bodhi_cuckoo_size(const bodhi_cuckoo_t *cuckoo);
+size_t bodhi_cuckoo_memory(const bodhi_cuckoo_t *cuckoo);
+
+#endif
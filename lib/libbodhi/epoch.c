@@ -0,0 +1,224 @@
+/*
+ * epoch.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <inttypes.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "epoch.h"
+#include "util.h"
+
+#define CACHE_LINE 64
+
+/* widest field first, so the pad is all that follows used and the slot is exactly a line */
+struct _bodhi_epoch_reader_t {
+    uint64_t epoch; /* 0 when not reading */
+    bodhi_epoch_t *domain;
+    int used;
+    char pad[CACHE_LINE - sizeof(uint64_t) - sizeof(void*) - sizeof(int)];
+};
+
+/* fails to compile if a reader slot is not one cache line */
+typedef char _bodhi_epoch_reader_size_check[sizeof(struct _bodhi_epoch_reader_t) == CACHE_LINE ? 1 : -1];
+
+typedef struct _bodhi_epoch_retired_t {
+    void *ptr;
+    bodhi_epoch_free_fn fn;
+    uint64_t epoch;
+} bodhi_epoch_retired_t;
+
+struct _bodhi_epoch_t {
+    uint64_t epoch;
+    char pad[CACHE_LINE - sizeof(uint64_t)];
+
+    bodhi_epoch_reader_t *readers;
+    size_t max_readers;
+
+    bodhi_epoch_retired_t *retired;
+    size_t retired_count;
+    size_t retired_size;
+};
+
+bodhi_epoch_t *bodhi_epoch_new(size_t max_readers) {
+    bodhi_epoch_t *ret;
+    void *p;
+    size_t i;
+
+    /* both line aligned, so the epoch and every reader slot start a line of their own */
+    if (posix_memalign(&p, CACHE_LINE, sizeof(bodhi_epoch_t)) != 0) {
+        return NULL;
+    }
+    ret = p;
+    memset(ret, 0, sizeof(bodhi_epoch_t));
+
+    if (posix_memalign(&p, CACHE_LINE, (max_readers > 0 ? max_readers : 1) * sizeof(bodhi_epoch_reader_t)) != 0) {
+        free(ret);
+        return NULL;
+    }
+    ret->readers = p;
+    memset(ret->readers, 0, max_readers * sizeof(bodhi_epoch_reader_t));
+
+    for (i = 0; i < max_readers; i++) {
+        ret->readers[i].domain = ret;
+    }
+
+    ret->max_readers = max_readers;
+    ret->epoch = 1;
+
+    return ret;
+}
+
+void bodhi_epoch_free(bodhi_epoch_t *epoch) {
+    size_t i;
+
+    ASSERT(epoch != NULL, return);
+
+    /* nobody can be reading anymore, so everything goes */
+    for (i = 0; i < epoch->retired_count; i++) {
+        epoch->retired[i].fn(epoch->retired[i].ptr);
+    }
+
+    free(epoch->retired);
+    free(epoch->readers);
+    free(epoch);
+}
+
+bodhi_epoch_reader_t *bodhi_epoch_register(bodhi_epoch_t *epoch) {
+    size_t i;
+
+    ASSERT(epoch != NULL, return NULL);
+
+    for (i = 0; i < epoch->max_readers; i++) {
+        int unused = 0;
+
+        if (ATOMIC_CAS(&epoch->readers[i].used, &unused, 1)) {
+            return &epoch->readers[i];
+        }
+    }
+
+    return NULL;
+}
+
+void bodhi_epoch_unregister(bodhi_epoch_reader_t *reader) {
+    ASSERT(reader != NULL, return);
+    ATOMIC_STORE(&reader->epoch, 0);
+    ATOMIC_STORE(&reader->used, 0);
+}
+
+void bodhi_epoch_enter(bodhi_epoch_reader_t *reader) {
+    ATOMIC_STORE_RELAXED(&reader->epoch, ATOMIC_LOAD_RELAXED(&reader->domain->epoch));
+
+    /* the announcement must be visible before any shared pointer is loaded */
+    ATOMIC_FENCE();
+}
+
+void bodhi_epoch_exit(bodhi_epoch_reader_t *reader) {
+    ATOMIC_STORE(&reader->epoch, 0);
+}
+
+int bodhi_epoch_retire(bodhi_epoch_t *epoch, void *ptr, bodhi_epoch_free_fn fn) {
+    ASSERT(epoch != NULL, return -1);
+
+    if (ptr == NULL) {
+        return 0;
+    }
+
+    if (epoch->retired_count == epoch->retired_size) {
+        size_t new_size = epoch->retired_size == 0 ? 64 : epoch->retired_size * 2;
+        bodhi_epoch_retired_t *tmp = realloc(epoch->retired, new_size * sizeof(bodhi_epoch_retired_t));
+
+        if (tmp == NULL) {
+            return -1;
+        }
+
+        epoch->retired = tmp;
+        epoch->retired_size = new_size;
+    }
+
+    epoch->retired[epoch->retired_count].ptr = ptr;
+    epoch->retired[epoch->retired_count].fn = fn == NULL ? free : fn;
+    epoch->retired[epoch->retired_count].epoch = ATOMIC_LOAD_RELAXED(&epoch->epoch);
+    epoch->retired_count++;
+
+    return 0;
+}
+
+size_t bodhi_epoch_reclaim(bodhi_epoch_t *epoch) {
+    uint64_t oldest;
+    size_t i;
+    size_t kept = 0;
+    size_t freed;
+
+    ASSERT(epoch != NULL, return 0);
+
+    /*
+     * anybody entering from here on sees the new epoch and none of the
+     * retired memory, so only readers already inside can hold it
+     */
+    oldest = ATOMIC_LOAD_RELAXED(&epoch->epoch) + 1;
+    ATOMIC_STORE_RELAXED(&epoch->epoch, oldest);
+    ATOMIC_FENCE();
+
+    for (i = 0; i < epoch->max_readers; i++) {
+        uint64_t e = ATOMIC_LOAD(&epoch->readers[i].epoch);
+        if (e != 0 && e < oldest) {
+            oldest = e;
+        }
+    }
+
+    for (i = 0; i < epoch->retired_count; i++) {
+        if (epoch->retired[i].epoch < oldest) {
+            epoch->retired[i].fn(epoch->retired[i].ptr);
+        } else {
+            epoch->retired[kept++] = epoch->retired[i];
+        }
+    }
+
+    freed = epoch->retired_count - kept;
+    epoch->retired_count = kept;
+    return freed;
+}
+
+/* waits out a full grace period, so memory unlinked before the call is safe to free after it */
+void bodhi_epoch_synchronize(bodhi_epoch_t *epoch) {
+    uint64_t target;
+    size_t i;
+
+    ASSERT(epoch != NULL, return);
+
+    /* readers entering from here on see nothing unlinked before the bump */
+    target = ATOMIC_LOAD_RELAXED(&epoch->epoch) + 1;
+    ATOMIC_STORE_RELAXED(&epoch->epoch, target);
+    ATOMIC_FENCE();
+
+    for (i = 0; i < epoch->max_readers; i++) {
+        uint64_t e;
+
+        while ((e = ATOMIC_LOAD(&epoch->readers[i].epoch)) != 0 && e < target) {
+            sched_yield();
+        }
+    }
+
+    bodhi_epoch_reclaim(epoch);
+}
+
+size_t bodhi_epoch_pending(bodhi_epoch_t *epoch) {
+    ASSERT(epoch != NULL, return 0);
+    return epoch->retired_count;
+}
@@ -0,0 +1,55 @@
+/*
+ * epoch.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BODHI_EPOCH_H
+#define BODHI_EPOCH_H
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+/*
+ * Epoch based reclamation. Readers announce the epoch they entered in, in
+ * a slot on a cache line of their own. A single writer retires memory it has
+ * unlinked and frees it once every reader that could still see it has left.
+ */
+typedef struct _bodhi_epoch_t bodhi_epoch_t;
+typedef struct _bodhi_epoch_reader_t bodhi_epoch_reader_t;
+
+typedef void (*bodhi_epoch_free_fn)(void *);
+
+bodhi_epoch_t *bodhi_epoch_new(size_t max_readers);
+void bodhi_epoch_free(bodhi_epoch_t *epoch);
+
+/* reader side, each thread registers once and brackets its reads */
+bodhi_epoch_reader_t *bodhi_epoch_register(bodhi_epoch_t *epoch);
+void bodhi_epoch_unregister(bodhi_epoch_reader_t *reader);
+void bodhi_epoch_enter(bodhi_epoch_reader_t *reader);
+void bodhi_epoch_exit(bodhi_epoch_reader_t *reader);
+
+/*
+ * writer side, only ever called from one thread at a time. retire returns
+ * -1 if it can't keep track of ptr; the caller can then synchronize,
+ * which returns once every reader inside at the time has left, and free
+ * ptr itself.
+ */
+int bodhi_epoch_retire(bodhi_epoch_t *epoch, void *ptr, bodhi_epoch_free_fn fn);
+size_t bodhi_epoch_reclaim(bodhi_epoch_t *epoch);
+void bodhi_epoch_synchronize(bodhi_epoch_t *epoch);
+size_t bodhi_epoch_pending(bodhi_epoch_t *epoch);
+
+#endif
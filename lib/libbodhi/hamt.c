@@ -0,0 +1,546 @@
+/*
+ * hamt.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hamt.h"
+#include "util.h"
+
+#define HAMT_BITS 5
+#define HAMT_MASK 31
+#define HASH_BITS (sizeof(size_t) * 8)
+
+/* slots hold either a child node or a leaf, leaves tagged in the low bit */
+#define IS_LEAF(p) (((uintptr_t) (p)) & 1)
+#define AS_LEAF(p) ((bodhi_hamt_leaf_t *) ((uintptr_t) (p) & ~(uintptr_t) 1))
+#define TAG_LEAF(l) ((void *) ((uintptr_t) (l) | 1))
+
+#define POPCOUNT32(x) POPCOUNT64((uint64_t) (x))
+
+typedef struct _bodhi_hamt_leaf_t {
+    uint32_t refs;
+    size_t hash;
+    void *key;
+    void *val;
+} bodhi_hamt_leaf_t;
+
+/*
+ * A bitmap of 0 marks a collision node, reached once all hash bits are
+ * used up, whose leaves share one hash. Nodes only one handle can reach
+ * have refs 1 and may keep spare slots for in place inserts; copies are
+ * made exact.
+ */
+typedef struct _bodhi_hamt_node_t {
+    uint32_t refs;
+    uint32_t bitmap;
+    uint32_t count;
+    uint32_t cap;
+    void *slots[1];
+} bodhi_hamt_node_t;
+
+struct _bodhi_hamt_t {
+    bodhi_hash_fn hash_fn;
+    bodhi_hmap_cmp_fn cmp_fn;
+    bodhi_hmap_free_fn key_free_fn;
+    bodhi_hmap_free_fn val_free_fn;
+
+    bodhi_hamt_node_t *root;
+    size_t size;
+};
+
+static bodhi_hamt_node_t *_bodhi_hamt_node_alloc(uint32_t cap) {
+    bodhi_hamt_node_t *ret;
+
+    MALLOC(ret, offsetof(bodhi_hamt_node_t, slots) + cap * sizeof(void *), return NULL);
+    ret->refs = 1;
+    ret->bitmap = 0;
+    ret->count = 0;
+    ret->cap = cap;
+
+    return ret;
+}
+
+static void _bodhi_hamt_retain(void *p) {
+    if (IS_LEAF(p)) {
+        (void) ATOMIC_FETCH_ADD(&AS_LEAF(p)->refs, 1);
+    } else {
+        (void) ATOMIC_FETCH_ADD(&((bodhi_hamt_node_t *) p)->refs, 1);
+    }
+}
+
+static void _bodhi_hamt_release(bodhi_hamt_t *hamt, void *p) {
+    if (IS_LEAF(p)) {
+        bodhi_hamt_leaf_t *leaf = AS_LEAF(p);
+
+        if (ATOMIC_SUB_FETCH(&leaf->refs, 1) == 0) {
+            if (leaf->key != NULL && hamt->key_free_fn != NULL) {
+                hamt->key_free_fn(leaf->key);
+            }
+            if (leaf->val != NULL && hamt->val_free_fn != NULL) {
+                hamt->val_free_fn(leaf->val);
+            }
+            free(leaf);
+        }
+    } else {
+        bodhi_hamt_node_t *node = p;
+        uint32_t i;
+
+        if (ATOMIC_SUB_FETCH(&node->refs, 1) == 0) {
+            for (i = 0; i < node->count; i++) {
+                _bodhi_hamt_release(hamt, node->slots[i]);
+            }
+            free(node);
+        }
+    }
+}
+
+/*
+ * Takes the caller's reference to node and returns a node only the
+ * caller can reach, with room for extra more slots: node itself if
+ * nothing else shares it, otherwise a copy. On failure node is left as
+ * it was and NULL returned.
+ */
+static bodhi_hamt_node_t *_bodhi_hamt_mutable(bodhi_hamt_t *hamt, bodhi_hamt_node_t *node, uint32_t extra) {
+    bodhi_hamt_node_t *ret;
+    uint32_t i;
+
+    if (ATOMIC_LOAD(&node->refs) == 1) {
+        uint32_t cap = node->cap * 2;
+
+        if (node->count + extra <= node->cap) {
+            return node;
+        }
+
+        if (cap < node->count + extra) {
+            cap = node->count + extra;
+        }
+        if (node->bitmap != 0 && cap > HAMT_MASK + 1) {
+            cap = HAMT_MASK + 1;
+        }
+
+        ret = realloc(node, offsetof(bodhi_hamt_node_t, slots) + cap * sizeof(void *));
+        if (ret != NULL) {
+            ret->cap = cap;
+        }
+        return ret;
+    }
+
+    ret = _bodhi_hamt_node_alloc(node->count + extra);
+    if (ret == NULL) {
+        return NULL;
+    }
+
+    ret->bitmap = node->bitmap;
+    ret->count = node->count;
+    memcpy(ret->slots, node->slots, node->count * sizeof(void *));
+    for (i = 0; i < node->count; i++) {
+        _bodhi_hamt_retain(node->slots[i]);
+    }
+
+    _bodhi_hamt_release(hamt, node);
+    return ret;
+}
+
+/* frees the nodes _bodhi_hamt_pair built, leaving the leaves alone */
+static void _bodhi_hamt_free_chain(bodhi_hamt_node_t *node) {
+    uint32_t i;
+
+    for (i = 0; i < node->count; i++) {
+        if (!IS_LEAF(node->slots[i])) {
+            _bodhi_hamt_free_chain(node->slots[i]);
+        }
+    }
+    free(node);
+}
+
+/* the subtree holding two leaves whose hashes agree below shift */
+static bodhi_hamt_node_t *_bodhi_hamt_pair(bodhi_hamt_leaf_t *a, bodhi_hamt_leaf_t *b, unsigned int shift) {
+    bodhi_hamt_node_t *ret;
+    uint32_t ba, bb;
+
+    if (shift >= HASH_BITS) {
+        ret = _bodhi_hamt_node_alloc(2);
+        if (ret != NULL) {
+            ret->slots[0] = TAG_LEAF(a);
+            ret->slots[1] = TAG_LEAF(b);
+            ret->count = 2;
+        }
+        return ret;
+    }
+
+    ba = (uint32_t) (a->hash >> shift) & HAMT_MASK;
+    bb = (uint32_t) (b->hash >> shift) & HAMT_MASK;
+
+    if (ba == bb) {
+        bodhi_hamt_node_t *child = _bodhi_hamt_pair(a, b, shift + HAMT_BITS);
+
+        if (child == NULL) {
+            return NULL;
+        }
+
+        ret = _bodhi_hamt_node_alloc(1);
+        if (ret == NULL) {
+            _bodhi_hamt_free_chain(child);
+            return NULL;
+        }
+
+        ret->slots[0] = child;
+        ret->bitmap = 1u << ba;
+        ret->count = 1;
+        return ret;
+    }
+
+    ret = _bodhi_hamt_node_alloc(2);
+    if (ret == NULL) {
+        return NULL;
+    }
+
+    ret->slots[ba < bb ? 0 : 1] = TAG_LEAF(a);
+    ret->slots[ba < bb ? 1 : 0] = TAG_LEAF(b);
+    ret->bitmap = (1u << ba) | (1u << bb);
+    ret->count = 2;
+    return ret;
+}
+
+bodhi_hamt_t *bodhi_hamt_new(bodhi_hash_fn hash_fn, bodhi_hmap_cmp_fn cmp_fn,
+                             bodhi_hmap_free_fn key_free_fn, bodhi_hmap_free_fn val_free_fn) {
+    bodhi_hamt_t *ret;
+
+    ASSERT(hash_fn != NULL && cmp_fn != NULL, return NULL);
+
+    CALLOC(ret, 1, sizeof(bodhi_hamt_t), return NULL);
+    ret->hash_fn = hash_fn;
+    ret->cmp_fn = cmp_fn;
+    ret->key_free_fn = key_free_fn;
+    ret->val_free_fn = val_free_fn;
+
+    return ret;
+}
+
+bodhi_hamt_t *bodhi_hamt_snapshot(bodhi_hamt_t *hamt) {
+    bodhi_hamt_t *ret;
+
+    ASSERT(hamt != NULL, return NULL);
+
+    MALLOC(ret, sizeof(bodhi_hamt_t), return NULL);
+    *ret = *hamt;
+    if (ret->root != NULL) {
+        _bodhi_hamt_retain(ret->root);
+    }
+
+    return ret;
+}
+
+void bodhi_hamt_free(bodhi_hamt_t *hamt) {
+    ASSERT(hamt != NULL, return);
+
+    if (hamt->root != NULL) {
+        _bodhi_hamt_release(hamt, hamt->root);
+    }
+    free(hamt);
+}
+
+/*
+ * Takes the caller's reference to node and returns the one to store in
+ * its place, which is node or a copy of it even when nothing was added.
+ */
+static bodhi_hamt_node_t *_bodhi_hamt_insert(bodhi_hamt_t *hamt, bodhi_hamt_node_t *node,
+                                             bodhi_hamt_leaf_t *leaf, unsigned int shift, int *res) {
+    bodhi_hamt_node_t *ret;
+    uint32_t bit, idx, i;
+    void *slot;
+
+    if (node->bitmap == 0) {
+        for (i = 0; i < node->count; i++) {
+            if (hamt->cmp_fn(AS_LEAF(node->slots[i])->key, leaf->key) == 0) {
+                *res = 1;
+                return node;
+            }
+        }
+
+        ret = _bodhi_hamt_mutable(hamt, node, 1);
+        if (ret == NULL) {
+            *res = -1;
+            return node;
+        }
+
+        ret->slots[ret->count++] = TAG_LEAF(leaf);
+        *res = 0;
+        return ret;
+    }
+
+    bit = 1u << ((leaf->hash >> shift) & HAMT_MASK);
+    idx = POPCOUNT32(node->bitmap & (bit - 1));
+
+    if ((node->bitmap & bit) == 0) {
+        ret = _bodhi_hamt_mutable(hamt, node, 1);
+        if (ret == NULL) {
+            *res = -1;
+            return node;
+        }
+
+        memmove(&ret->slots[idx + 1], &ret->slots[idx], (ret->count - idx) * sizeof(void *));
+        ret->slots[idx] = TAG_LEAF(leaf);
+        ret->bitmap |= bit;
+        ret->count++;
+        *res = 0;
+        return ret;
+    }
+
+    slot = node->slots[idx];
+    if (IS_LEAF(slot)) {
+        bodhi_hamt_leaf_t *old = AS_LEAF(slot);
+        bodhi_hamt_node_t *sub;
+
+        if (old->hash == leaf->hash && hamt->cmp_fn(old->key, leaf->key) == 0) {
+            *res = 1;
+            return node;
+        }
+
+        sub = _bodhi_hamt_pair(old, leaf, shift + HAMT_BITS);
+        if (sub == NULL) {
+            *res = -1;
+            return node;
+        }
+
+        ret = _bodhi_hamt_mutable(hamt, node, 0);
+        if (ret == NULL) {
+            _bodhi_hamt_free_chain(sub);
+            *res = -1;
+            return node;
+        }
+
+        /* the slot's reference to old moves into sub */
+        ret->slots[idx] = sub;
+        *res = 0;
+        return ret;
+    }
+
+    ret = _bodhi_hamt_mutable(hamt, node, 0);
+    if (ret == NULL) {
+        *res = -1;
+        return node;
+    }
+
+    ret->slots[idx] = _bodhi_hamt_insert(hamt, ret->slots[idx], leaf, shift + HAMT_BITS, res);
+    return ret;
+}
+
+int bodhi_hamt_insert(bodhi_hamt_t *hamt, void *key, void *val) {
+    bodhi_hamt_leaf_t *leaf;
+    int res;
+
+    ASSERT(hamt != NULL, return -1);
+    ASSERT(key != NULL, return -1);
+
+    MALLOC(leaf, sizeof(bodhi_hamt_leaf_t), return -1);
+    leaf->refs = 1;
+    leaf->hash = hamt->hash_fn(key);
+    leaf->key = key;
+    leaf->val = val;
+
+    if (hamt->root == NULL) {
+        hamt->root = _bodhi_hamt_node_alloc(1);
+        if (hamt->root == NULL) {
+            free(leaf);
+            return -1;
+        }
+
+        hamt->root->slots[0] = TAG_LEAF(leaf);
+        hamt->root->bitmap = 1u << (leaf->hash & HAMT_MASK);
+        hamt->root->count = 1;
+        hamt->size++;
+        return 0;
+    }
+
+    hamt->root = _bodhi_hamt_insert(hamt, hamt->root, leaf, 0, &res);
+    if (res != 0) {
+        free(leaf);
+        return res;
+    }
+
+    hamt->size++;
+    return 0;
+}
+
+static bodhi_hamt_leaf_t *_bodhi_hamt_find(bodhi_hamt_t *hamt, void *key, size_t hash) {
+    bodhi_hamt_node_t *node = hamt->root;
+    unsigned int shift = 0;
+    uint32_t bit, i;
+    void *slot;
+
+    while (node != NULL) {
+        if (node->bitmap == 0) {
+            for (i = 0; i < node->count; i++) {
+                if (hamt->cmp_fn(key, AS_LEAF(node->slots[i])->key) == 0) {
+                    return AS_LEAF(node->slots[i]);
+                }
+            }
+            return NULL;
+        }
+
+        bit = 1u << ((hash >> shift) & HAMT_MASK);
+        if ((node->bitmap & bit) == 0) {
+            return NULL;
+        }
+
+        slot = node->slots[POPCOUNT32(node->bitmap & (bit - 1))];
+        if (IS_LEAF(slot)) {
+            bodhi_hamt_leaf_t *leaf = AS_LEAF(slot);
+            return leaf->hash == hash && hamt->cmp_fn(key, leaf->key) == 0 ? leaf : NULL;
+        }
+
+        node = slot;
+        shift += HAMT_BITS;
+    }
+
+    return NULL;
+}
+
+/* a node below the root left with a single leaf is replaced by the leaf */
+static void *_bodhi_hamt_collapse(bodhi_hamt_node_t *node, unsigned int shift) {
+    void *only;
+
+    if (shift == 0 || node->count != 1 || !IS_LEAF(node->slots[0])) {
+        return node;
+    }
+
+    only = node->slots[0];
+    free(node);
+    return only;
+}
+
+/*
+ * Removes key, known to be present, taking the caller's reference to
+ * node. Returns what to store in its place: a node, a tagged leaf, or
+ * NULL once nothing is left.
+ */
+static void *_bodhi_hamt_delete(bodhi_hamt_t *hamt, bodhi_hamt_node_t *node, void *key, size_t hash,
+                                unsigned int shift, int *res) {
+    bodhi_hamt_node_t *ret;
+    uint32_t bit, idx;
+    void *slot;
+
+    if (node->bitmap == 0) {
+        for (idx = 0; idx < node->count; idx++) {
+            if (hamt->cmp_fn(key, AS_LEAF(node->slots[idx])->key) == 0) {
+                break;
+            }
+        }
+        bit = 0;
+    } else {
+        bit = 1u << ((hash >> shift) & HAMT_MASK);
+        idx = POPCOUNT32(node->bitmap & (bit - 1));
+    }
+
+    ret = _bodhi_hamt_mutable(hamt, node, 0);
+    if (ret == NULL) {
+        *res = -1;
+        return node;
+    }
+
+    slot = ret->slots[idx];
+    if (IS_LEAF(slot)) {
+        _bodhi_hamt_release(hamt, slot);
+        slot = NULL;
+        *res = 0;
+    } else {
+        slot = _bodhi_hamt_delete(hamt, slot, key, hash, shift + HAMT_BITS, res);
+    }
+
+    if (slot != NULL) {
+        ret->slots[idx] = slot;
+    } else {
+        memmove(&ret->slots[idx], &ret->slots[idx + 1], (ret->count - idx - 1) * sizeof(void *));
+        ret->bitmap &= ~bit;
+        ret->count--;
+        if (ret->count == 0) {
+            free(ret);
+            return NULL;
+        }
+    }
+
+    return _bodhi_hamt_collapse(ret, shift);
+}
+
+int bodhi_hamt_delete(bodhi_hamt_t *hamt, void *key) {
+    size_t hash;
+    int res;
+
+    ASSERT(hamt != NULL, return -1);
+    ASSERT(key != NULL, return -1);
+
+    /* look first, so a miss never copies shared nodes */
+    hash = hamt->hash_fn(key);
+    if (_bodhi_hamt_find(hamt, key, hash) == NULL) {
+        return 1;
+    }
+
+    hamt->root = _bodhi_hamt_delete(hamt, hamt->root, key, hash, 0, &res);
+    if (res == 0) {
+        hamt->size--;
+    }
+
+    return res;
+}
+
+void *bodhi_hamt_value(bodhi_hamt_t *hamt, void *key) {
+    bodhi_hamt_leaf_t *leaf;
+
+    ASSERT(hamt != NULL, return NULL);
+    ASSERT(key != NULL, return NULL);
+
+    leaf = _bodhi_hamt_find(hamt, key, hamt->hash_fn(key));
+    return leaf == NULL ? NULL : leaf->val;
+}
+
+size_t bodhi_hamt_size(bodhi_hamt_t *hamt) {
+    ASSERT(hamt != NULL, return 0);
+    return hamt->size;
+}
+
+static int _bodhi_hamt_loop(bodhi_hamt_node_t *node, bodhi_hamt_cb cb, void *udata) {
+    uint32_t i;
+
+    for (i = 0; i < node->count; i++) {
+        void *slot = node->slots[i];
+        int ret;
+
+        if (IS_LEAF(slot)) {
+            ret = cb(AS_LEAF(slot)->key, AS_LEAF(slot)->val, udata);
+        } else {
+            ret = _bodhi_hamt_loop(slot, cb, udata);
+        }
+
+        if (ret != 0) {
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+int bodhi_hamt_loop(bodhi_hamt_t *hamt, bodhi_hamt_cb cb, void *udata) {
+    ASSERT(hamt != NULL, return -1);
+    ASSERT(cb != NULL, return -1);
+
+    return hamt->root == NULL ? 0 : _bodhi_hamt_loop(hamt->root, cb, udata);
+}
@@ -0,0 +1,61 @@
+/*
+ * hamt.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BODHI_HAMT_H
+#define BODHI_HAMT_H
+
+#include <stdlib.h>
+
+#include <libbodhi/hmap.h>
+
+/*
+ * A persistent hash array mapped trie. Every level consumes five bits of
+ * the key's hash and stores only the children present, indexed by the
+ * popcount of a 32 bit mask as poptrie does.
+ *
+ * bodhi_hamt_snapshot returns a second handle sharing every node with the
+ * first in O(1); either handle can then be read or updated without the
+ * other seeing it. An update copies the path of shared nodes it touches
+ * and changes nodes only its handle can reach in place, so a batch of
+ * updates between snapshots copies each shared node at most once and
+ * otherwise runs at the cost of an unshared trie.
+ *
+ * Handles may be used from different threads, but a handle itself is not
+ * locked: take the snapshot on the thread that owns the handle, then pass
+ * it on. Keys and values are freed with the free functions once the last
+ * handle holding them lets go.
+ */
+typedef struct _bodhi_hamt_t bodhi_hamt_t;
+
+/* return non-zero to stop the walk */
+typedef int (*bodhi_hamt_cb)(void *key, void *val, void *udata);
+
+bodhi_hamt_t *bodhi_hamt_new(bodhi_hash_fn hash_fn, bodhi_hmap_cmp_fn cmp_fn,
+    bodhi_hmap_free_fn key_free_fn, bodhi_hmap_free_fn val_free_fn);
+bodhi_hamt_t *bodhi_hamt_snapshot(bodhi_hamt_t *hamt);
+void bodhi_hamt_free(bodhi_hamt_t *hamt);
+/* as bodhi_hmap_insert_no_cpy: 0 when added, 1 if the key exists, -1 on error */
+int bodhi_hamt_insert(bodhi_hamt_t *hamt, void *key, void *val);
+/* 0 when removed, 1 if not found, -1 on error */
+int bodhi_hamt_delete(bodhi_hamt_t *hamt, void *key);
+void *bodhi_hamt_value(bodhi_hamt_t *hamt, void *key);
+size_t bodhi_hamt_size(bodhi_hamt_t *hamt);
+/* visits every pair in hash order */
+int bodhi_hamt_loop(bodhi_hamt_t *hamt, bodhi_hamt_cb cb, void *udata);
+
+#endif
@@ -0,0 +1,320 @@
+/*
+ * heap.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "heap.h"
+#include "util.h"
+
+#define HEAP_CHUNK 256
+
+/*
+ * The array holds the data next to its handle so comparing never chases
+ * the handle, which only records where its element sits. Handles come
+ * from chunks kept until the heap is freed and are recycled through
+ * free_nodes.
+ */
+typedef struct _bodhi_heap_entry_t {
+    void *data;
+    bodhi_heap_node_t *node;
+} bodhi_heap_entry_t;
+
+struct _bodhi_heap_node_t {
+    size_t index;
+    bodhi_heap_node_t *next_free;
+};
+
+typedef struct _bodhi_heap_chunk_t {
+    struct _bodhi_heap_chunk_t *next;
+    bodhi_heap_node_t nodes[HEAP_CHUNK];
+} bodhi_heap_chunk_t;
+
+struct _bodhi_heap_t {
+    bodhi_list_cmp_fn cmp_fn;
+    size_t arity;
+
+    bodhi_heap_entry_t *entries;
+    size_t size;
+    size_t alloc_size;
+
+    bodhi_heap_chunk_t *chunks;
+    bodhi_heap_node_t *free_nodes;
+};
+
+bodhi_heap_t *bodhi_heap_new(bodhi_list_cmp_fn cmp_fn, int arity) {
+    bodhi_heap_t *ret;
+
+    ASSERT(cmp_fn != NULL, return NULL);
+    ASSERT(arity == 0 || arity >= 2, return NULL);
+
+    CALLOC(ret, 1, sizeof(bodhi_heap_t), return NULL);
+    ret->cmp_fn = cmp_fn;
+    ret->arity = arity == 0 ? 4 : (size_t) arity;
+
+    return ret;
+}
+
+void bodhi_heap_free(bodhi_heap_t *heap, bodhi_list_free_fn fn) {
+    bodhi_heap_chunk_t *chunk, *next;
+    size_t i;
+
+    ASSERT(heap != NULL, return);
+
+    if (fn != NULL) {
+        for (i = 0; i < heap->size; i++) {
+            fn(heap->entries[i].data);
+        }
+    }
+
+    for (chunk = heap->chunks; chunk != NULL; chunk = next) {
+        next = chunk->next;
+        free(chunk);
+    }
+
+    free(heap->entries);
+    free(heap);
+}
+
+static bodhi_heap_node_t *_bodhi_heap_node_alloc(bodhi_heap_t *heap) {
+    bodhi_heap_node_t *node;
+
+    if (heap->free_nodes == NULL) {
+        bodhi_heap_chunk_t *chunk;
+        int i;
+
+        MALLOC(chunk, sizeof(bodhi_heap_chunk_t), return NULL);
+        chunk->next = heap->chunks;
+        heap->chunks = chunk;
+
+        for (i = HEAP_CHUNK - 1; i >= 0; i--) {
+            chunk->nodes[i].next_free = heap->free_nodes;
+            heap->free_nodes = &chunk->nodes[i];
+        }
+    }
+
+    node = heap->free_nodes;
+    heap->free_nodes = node->next_free;
+    return node;
+}
+
+static void _bodhi_heap_node_free(bodhi_heap_t *heap, bodhi_heap_node_t *node) {
+    node->next_free = heap->free_nodes;
+    heap->free_nodes = node;
+}
+
+static int _bodhi_heap_reserve(bodhi_heap_t *heap, size_t n) {
+    bodhi_heap_entry_t *entries;
+    size_t new_size = heap->alloc_size == 0 ? 16 : heap->alloc_size;
+
+    if (n <= heap->alloc_size) {
+        return 0;
+    }
+
+    while (new_size < n) {
+        new_size *= 2;
+    }
+
+    entries = realloc(heap->entries, new_size * sizeof(bodhi_heap_entry_t));
+    if (entries == NULL) {
+        return -1;
+    }
+
+    heap->entries = entries;
+    heap->alloc_size = new_size;
+    return 0;
+}
+
+/* both sifts move a hole instead of swapping, each entry is written once */
+static void _bodhi_heap_sift_up(bodhi_heap_t *heap, size_t i) {
+    bodhi_heap_entry_t *e = heap->entries;
+    bodhi_heap_entry_t moving = e[i];
+
+    while (i > 0) {
+        size_t parent = (i - 1) / heap->arity;
+
+        if (heap->cmp_fn(moving.data, e[parent].data) >= 0) {
+            break;
+        }
+
+        e[i] = e[parent];
+        e[i].node->index = i;
+        i = parent;
+    }
+
+    e[i] = moving;
+    moving.node->index = i;
+}
+
+static void _bodhi_heap_sift_down(bodhi_heap_t *heap, size_t i) {
+    bodhi_heap_entry_t *e = heap->entries;
+    bodhi_heap_entry_t moving = e[i];
+    size_t size = heap->size;
+
+    for (;;) {
+        size_t first = i * heap->arity + 1;
+        size_t last = first + heap->arity;
+        size_t best, c;
+
+        if (first >= size) {
+            break;
+        }
+        if (last > size) {
+            last = size;
+        }
+
+        best = first;
+        for (c = first + 1; c < last; c++) {
+            if (heap->cmp_fn(e[c].data, e[best].data) < 0) {
+                best = c;
+            }
+        }
+
+        if (heap->cmp_fn(e[best].data, moving.data) >= 0) {
+            break;
+        }
+
+        e[i] = e[best];
+        e[i].node->index = i;
+        i = best;
+    }
+
+    e[i] = moving;
+    moving.node->index = i;
+}
+
+int bodhi_heap_heapify(bodhi_heap_t *heap, void **data, size_t n, bodhi_heap_node_t **handles) {
+    size_t i;
+    int ret = 0;
+
+    ASSERT(heap != NULL, return -1);
+    ASSERT(data != NULL || n == 0, return -1);
+
+    if (_bodhi_heap_reserve(heap, heap->size + n) != 0) {
+        return -1;
+    }
+
+    for (i = 0; i < n; i++) {
+        bodhi_heap_node_t *node = _bodhi_heap_node_alloc(heap);
+
+        /* whatever made it in is still ordered below */
+        if (node == NULL) {
+            ret = -1;
+            break;
+        }
+
+        node->index = heap->size;
+        heap->entries[heap->size].data = data[i];
+        heap->entries[heap->size].node = node;
+        heap->size++;
+        if (handles != NULL) {
+            handles[i] = node;
+        }
+    }
+
+    /* Floyd's construction, sifting down from the last parent */
+    if (heap->size > 1) {
+        i = (heap->size - 2) / heap->arity + 1;
+        while (i-- > 0) {
+            _bodhi_heap_sift_down(heap, i);
+        }
+    }
+
+    return ret;
+}
+
+bodhi_heap_node_t *bodhi_heap_push(bodhi_heap_t *heap, void *data) {
+    bodhi_heap_node_t *node;
+
+    ASSERT(heap != NULL, return NULL);
+
+    if (_bodhi_heap_reserve(heap, heap->size + 1) != 0) {
+        return NULL;
+    }
+
+    node = _bodhi_heap_node_alloc(heap);
+    if (node == NULL) {
+        return NULL;
+    }
+
+    heap->entries[heap->size].data = data;
+    heap->entries[heap->size].node = node;
+    heap->size++;
+    _bodhi_heap_sift_up(heap, heap->size - 1);
+
+    return node;
+}
+
+void *bodhi_heap_peek(bodhi_heap_t *heap) {
+    ASSERT(heap != NULL, return NULL);
+    return heap->size == 0 ? NULL : heap->entries[0].data;
+}
+
+void *bodhi_heap_pop(bodhi_heap_t *heap) {
+    ASSERT(heap != NULL, return NULL);
+
+    if (heap->size == 0) {
+        return NULL;
+    }
+
+    return bodhi_heap_remove(heap, heap->entries[0].node);
+}
+
+void bodhi_heap_update(bodhi_heap_t *heap, bodhi_heap_node_t *node) {
+    size_t i;
+
+    ASSERT(heap != NULL && node != NULL, return);
+
+    i = node->index;
+    if (i > 0 && heap->cmp_fn(heap->entries[i].data, heap->entries[(i - 1) / heap->arity].data) < 0) {
+        _bodhi_heap_sift_up(heap, i);
+    } else {
+        _bodhi_heap_sift_down(heap, i);
+    }
+}
+
+void *bodhi_heap_remove(bodhi_heap_t *heap, bodhi_heap_node_t *node) {
+    size_t i;
+    void *ret;
+
+    ASSERT(heap != NULL && node != NULL, return NULL);
+
+    i = node->index;
+    ret = heap->entries[i].data;
+    _bodhi_heap_node_free(heap, node);
+
+    /* the last entry fills the hole and may have to go either way */
+    heap->size--;
+    if (i != heap->size) {
+        heap->entries[i] = heap->entries[heap->size];
+        heap->entries[i].node->index = i;
+        bodhi_heap_update(heap, heap->entries[i].node);
+    }
+
+    return ret;
+}
+
+size_t bodhi_heap_size(bodhi_heap_t *heap) {
+    ASSERT(heap != NULL, return 0);
+    return heap->size;
+}
+
+void *bodhi_heap_get_data(bodhi_heap_t *heap, bodhi_heap_node_t *node) {
+    ASSERT(heap != NULL && node != NULL, return NULL);
+    return heap->entries[node->index].data;
+}
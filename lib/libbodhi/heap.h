@@ -0,0 +1,54 @@
+/*
+ * heap.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BODHI_HEAP_H
+#define BODHI_HEAP_H
+
+#include <stdlib.h>
+
+#include <libbodhi/list.h>
+
+/*
+ * An array backed d-ary min-heap: the element for which cmp_fn says it
+ * sorts first is on top, as bodhi_list_add_sorted would have put it at the
+ * head. arity 0 picks 4, which keeps a node's children in one cache line.
+ *
+ * push hands back a handle that stays valid until the element leaves the
+ * heap; it lets bodhi_heap_update restore the order after the element's key
+ * changed in either direction and bodhi_heap_remove take it out early.
+ */
+typedef struct _bodhi_heap_t bodhi_heap_t;
+typedef struct _bodhi_heap_node_t bodhi_heap_node_t;
+
+bodhi_heap_t *bodhi_heap_new(bodhi_list_cmp_fn cmp_fn, int arity);
+void bodhi_heap_free(bodhi_heap_t *heap, bodhi_list_free_fn fn);
+/*
+ * adds n elements at once and restores the order in O(size) rather than
+ * O(n log size); handles may be NULL, otherwise it receives one per element
+ */
+int bodhi_heap_heapify(bodhi_heap_t *heap, void **data, size_t n, bodhi_heap_node_t **handles);
+bodhi_heap_node_t *bodhi_heap_push(bodhi_heap_t *heap, void *data);
+void *bodhi_heap_peek(bodhi_heap_t *heap);
+void *bodhi_heap_pop(bodhi_heap_t *heap);
+void bodhi_heap_update(bodhi_heap_t *heap, bodhi_heap_node_t *node);
+void *bodhi_heap_remove(bodhi_heap_t *heap, bodhi_heap_node_t *node);
+size_t bodhi_heap_size(bodhi_heap_t *heap);
+
+void *bodhi_heap_get_data(bodhi_heap_t *heap, bodhi_heap_node_t *node);
+
+#endif
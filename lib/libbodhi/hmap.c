@@ -18,11 +18,22 @@
 
 #include <stdlib.h>
 #include <string.h>
+#ifdef BODHI_STATS
+#include <time.h>
+#endif
 
+#include "cuckoo.h"
 #include "hmap.h"
+#include "pool.h"
+#include "reaper.h"
 #include "util.h"
 #include "list.h"
 
+/* maps up to this size live in the map itself, see bodhi_hmap_t */
+#define SMALL_SIZE 8
+/* filter sizes tried before a build gives up, see _bodhi_hmap_filter_build */
+#define FILTER_TRIES 3
+
 typedef struct _bodhi_hmap_bucket_t {
     size_t h;
     void *key;
@@ -38,28 +49,73 @@ struct _bodhi_hmap_t {
     size_t alloc_size;
     size_t consumed_size;
 
+    /*
+     * NULL while the map is small: the first SMALL_SIZE entries are kept in
+     * small and scanned in order, the bucket array (alloc_size long) only
+     * being allocated when one more is inserted.
+     */
     bodhi_list_t **buckets;
+    bodhi_hmap_bucket_t small[SMALL_SIZE];
+
+    /* optional, holds the hash of every key so misses skip the chain */
+    bodhi_cuckoo_t *filter;
+    size_t filter_expected;
+    double filter_fpr;
+
+    /* the next bucket bodhi_hmap_free_step frees */
+    size_t reap_cursor;
+
+#ifdef BODHI_STATS
+    /* only the event counters are used, the rest is filled on demand */
+    bodhi_hmap_stats_t stats;
+#endif
 };
 
+#ifdef BODHI_STATS
+static double _bodhi_hmap_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* lookups may run side by side under a read lock, so these counters are atomic */
+static void _bodhi_hmap_probed(bodhi_hmap_t *hmap, size_t probes) {
+    (void) ATOMIC_FETCH_ADD(&hmap->stats.lookups, 1);
+    (void) ATOMIC_FETCH_ADD(&hmap->stats.probes, probes);
+    (void) ATOMIC_FETCH_ADD(&hmap->stats.probe_hist[probes < BODHI_HMAP_HIST ? probes : BODHI_HMAP_HIST - 1], 1);
+}
+#endif
+
+static void _bodhi_hmap_entry_free(bodhi_hmap_t *hmap, bodhi_hmap_bucket_t *bucket) {
+    if (bucket->key != NULL && hmap->key_free_fn != NULL) {
+        hmap->key_free_fn(bucket->key);
+    }
+
+    if (bucket->val != NULL && hmap->val_free_fn != NULL) {
+        hmap->val_free_fn(bucket->val);
+    }
+}
+
 static void _bodhi_hmap_bucket_free_inner(bodhi_hmap_t *hmap, bodhi_list_t *buckets) {
     bodhi_list_t *tmp;
 
     for (tmp = buckets; tmp; tmp = tmp->next) {
-        bodhi_hmap_bucket_t *bucket = tmp->data;
-        if (bucket->key != NULL) {
-            hmap->key_free_fn(bucket->key);
-        }
-
-        if (bucket->val != NULL) {
-            hmap->val_free_fn(bucket->val);
-        }
+        _bodhi_hmap_entry_free(hmap, tmp->data);
     }
 
     FREELIST(buckets);
 }
 
 static void _bodhi_hmap_bucket_free(bodhi_hmap_t *hmap) {
-    int i;
+    size_t i;
+
+    if (hmap->buckets == NULL) {
+        for (i = 0; i < hmap->consumed_size; i++) {
+            _bodhi_hmap_entry_free(hmap, &hmap->small[i]);
+        }
+        return;
+    }
 
     for (i = 0; i < hmap->alloc_size; i++) {
         if (hmap->buckets[i] != NULL) {
@@ -73,8 +129,8 @@ bodhi_hmap_t *bodhi_hmap_new_size(bodhi_hash_fn hash_fn, bodhi_hmap_cmp_fn cmp_f
                                   bodhi_hmap_free_fn val_free_fn, size_t size) {
     bodhi_hmap_t *ret;
 
+    /* the bucket array waits until the map outgrows small */
     CALLOC(ret, 1, sizeof(bodhi_hmap_t), return NULL);
-    CALLOC(ret->buckets, size, sizeof(bodhi_list_t*), return NULL);
     ret->alloc_size = size;
     ret->consumed_size = 0;
     ret->hash_fn = hash_fn;
@@ -93,14 +149,155 @@ bodhi_hmap_t *bodhi_hmap_new(bodhi_hash_fn hash_fn, bodhi_hmap_cmp_fn cmp_fn,
 void bodhi_hmap_free(bodhi_hmap_t *hmap) {
     ASSERT(hmap != NULL, return);
     _bodhi_hmap_bucket_free(hmap);
+    if (hmap->filter != NULL) {
+        bodhi_cuckoo_free(hmap->filter);
+    }
     free(hmap->buckets);
     free(hmap);
 }
 
+int bodhi_hmap_free_step(bodhi_hmap_t *hmap, size_t max) {
+    size_t work = 0;
+
+    ASSERT(hmap != NULL, return 0);
+
+    if (hmap->buckets == NULL) {
+        while (work < max && hmap->consumed_size > 0) {
+            work++;
+            _bodhi_hmap_entry_free(hmap, &hmap->small[--hmap->consumed_size]);
+        }
+
+        if (hmap->consumed_size > 0) {
+            return 1;
+        }
+
+        if (hmap->filter != NULL) {
+            bodhi_cuckoo_free(hmap->filter);
+        }
+        free(hmap);
+        return 0;
+    }
+
+    while (work < max && hmap->reap_cursor < hmap->alloc_size) {
+        bodhi_list_t *item = hmap->buckets[hmap->reap_cursor];
+        bodhi_hmap_bucket_t *bkt;
+
+        work++;
+        if (item == NULL) {
+            hmap->reap_cursor++;
+            continue;
+        }
+
+        /* the chain is going away whole, so only its head pointer is kept right */
+        hmap->buckets[hmap->reap_cursor] = item->next;
+        item->next = NULL;
+        bkt = item->data;
+        _bodhi_hmap_entry_free(hmap, bkt);
+        free(bkt);
+        bodhi_list_free(item);
+    }
+
+    if (hmap->reap_cursor < hmap->alloc_size) {
+        return 1;
+    }
+
+    /* every bucket is empty now, skip bodhi_hmap_free's pass over them */
+    if (hmap->filter != NULL) {
+        bodhi_cuckoo_free(hmap->filter);
+    }
+    free(hmap->buckets);
+    free(hmap);
+    return 0;
+}
+
+static void _bodhi_hmap_reap(void *arg) {
+    bodhi_hmap_free(arg);
+}
+
+void bodhi_hmap_free_detached(bodhi_hmap_t *hmap) {
+    ASSERT(hmap != NULL, return);
+    bodhi_reaper_submit(_bodhi_hmap_reap, hmap);
+}
+
+/* adds every hash already in the map to filter */
+static int _bodhi_hmap_filter_fill(bodhi_hmap_t *hmap, bodhi_cuckoo_t *filter) {
+    bodhi_list_t *tmp;
+    size_t cur;
+
+    for (cur = 0; hmap->buckets == NULL && cur < hmap->consumed_size; cur++) {
+        if (bodhi_cuckoo_add(filter, hmap->small[cur].h) != 0) {
+            return -1;
+        }
+    }
+
+    for (cur = 0; hmap->buckets != NULL && cur < hmap->alloc_size; cur++) {
+        for (tmp = hmap->buckets[cur]; tmp; tmp = tmp->next) {
+            bodhi_hmap_bucket_t *bkt = tmp->data;
+            if (bodhi_cuckoo_add(filter, bkt->h) != 0) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * (re)builds the front filter from the hashes already in the buckets,
+ * doubling at most FILTER_TRIES - 1 times. Past that the hashes themselves
+ * are the problem (more than a bucket pair's worth of equal ones never
+ * fit, whatever the size), so give up instead of growing without bound.
+ */
+static int _bodhi_hmap_filter_build(bodhi_hmap_t *hmap, size_t expected) {
+    bodhi_cuckoo_t *filter;
+    int tries;
+
+    for (tries = 0; tries < FILTER_TRIES; tries++, expected *= 2) {
+        filter = bodhi_cuckoo_new(expected, hmap->filter_fpr);
+        if (filter == NULL) {
+            return -1;
+        }
+
+        if (_bodhi_hmap_filter_fill(hmap, filter) == 0) {
+            if (hmap->filter != NULL) {
+                bodhi_cuckoo_free(hmap->filter);
+            }
+            hmap->filter = filter;
+            hmap->filter_expected = expected;
+            return 0;
+        }
+
+        bodhi_cuckoo_free(filter);
+    }
+
+    return -1;
+}
+
+int bodhi_hmap_filter(bodhi_hmap_t *hmap, double fpr) {
+    ASSERT(hmap != NULL, return -1);
+
+    if (fpr <= 0) {
+        if (hmap->filter != NULL) {
+            bodhi_cuckoo_free(hmap->filter);
+            hmap->filter = NULL;
+        }
+        return 0;
+    }
+
+    ASSERT(fpr < 1, return -1);
+    hmap->filter_fpr = fpr;
+    return _bodhi_hmap_filter_build(hmap, hmap->alloc_size > hmap->consumed_size ?
+                                          hmap->alloc_size : hmap->consumed_size);
+}
+
 static int _bodhi_hmap_resize(bodhi_hmap_t *hmap) {
     bodhi_list_t **bkts;
     size_t new_size = hmap->alloc_size * 2;
     size_t iter;
+#ifdef BODHI_STATS
+    double start = _bodhi_hmap_now();
+    double secs;
+#endif
 
     bkts = realloc(hmap->buckets, sizeof(bodhi_list_t*) * new_size);
     if (bkts == NULL) {
@@ -131,6 +328,53 @@ static int _bodhi_hmap_resize(bodhi_hmap_t *hmap) {
     hmap->alloc_size = new_size;
     hmap->buckets = bkts;
 
+#ifdef BODHI_STATS
+    secs = _bodhi_hmap_now() - start;
+    hmap->stats.resizes++;
+    hmap->stats.allocs++;
+    hmap->stats.resize_secs += secs;
+    if (secs > hmap->stats.resize_max_secs) {
+        hmap->stats.resize_max_secs = secs;
+    }
+#endif
+
+    return 0;
+}
+
+/*
+ * moves the small entries into a bucket array, leaving the map as it was on
+ * failure; the array gets room to spare even if the map was created smaller
+ * than small, or the resize check would never catch up with the entries
+ */
+static int _bodhi_hmap_grow(bodhi_hmap_t *hmap) {
+    bodhi_list_t **bkts;
+    size_t size = hmap->alloc_size > 2 * SMALL_SIZE ? hmap->alloc_size : 2 * SMALL_SIZE;
+    size_t i, index;
+
+    CALLOC(bkts, size, sizeof(bodhi_list_t*), return -1);
+
+    for (i = 0; i < hmap->consumed_size; i++) {
+        bodhi_hmap_bucket_t *bkt = malloc(sizeof(bodhi_hmap_bucket_t));
+        bodhi_list_t *item = bkt != NULL ? bodhi_list_new(bkt) : NULL;
+
+        if (item == NULL) {
+            free(bkt);
+            for (index = 0; index < size; index++) {
+                FREELIST(bkts[index]);
+            }
+            free(bkts);
+            return -1;
+        }
+
+        *bkt = hmap->small[i];
+        index = bkt->h & (size - 1);
+        bkts[index] = bodhi_list_join(bkts[index], item);
+    }
+
+    hmap->buckets = bkts;
+    hmap->alloc_size = size;
+    STATS(hmap->stats.allocs += 1 + 2 * hmap->consumed_size);
+
     return 0;
 }
 
@@ -139,18 +383,45 @@ static int _bodhi_hmap_key_cmp(bodhi_hmap_cmp_fn fn, void *a, void *b) {
 }
 
 int bodhi_hmap_insert_no_cpy(bodhi_hmap_t *hmap, void *key, void *val) {
+    ASSERT(hmap != NULL, return -1);
+    ASSERT(key != NULL, return -1);
+    return bodhi_hmap_insert_no_cpy_hashed(hmap, key, val, hmap->hash_fn(key));
+}
+
+int bodhi_hmap_insert_no_cpy_hashed(bodhi_hmap_t *hmap, void *key, void *val, size_t hash) {
     ASSERT(hmap != NULL, return -1);
     ASSERT(key != NULL, return -1);
     bodhi_hmap_bucket_t *bkt = NULL;
     bodhi_list_t *list;
+    size_t index;
+
+    if (hmap->buckets == NULL) {
+        for (index = 0; index < hmap->consumed_size; index++) {
+            bkt = &hmap->small[index];
+            if (bkt->h == hash && hmap->cmp_fn(bkt->key, key) == 0) {
+                return 1;
+            }
+        }
+
+        if (hmap->consumed_size < SMALL_SIZE) {
+            bkt = &hmap->small[hmap->consumed_size];
+            bkt->h = hash;
+            bkt->key = key;
+            bkt->val = val;
+            goto inserted;
+        }
 
-    if (hmap->consumed_size == hmap->alloc_size) {
+        if (_bodhi_hmap_grow(hmap) != 0) {
+            return -1;
+        }
+    }
+
+    if (hmap->consumed_size >= hmap->alloc_size) {
         /* TODO: If this fails, continue, but log that a resize failed */
         _bodhi_hmap_resize(hmap);
     }
 
-    size_t hash = hmap->hash_fn(key);
-    size_t index = hash & (hmap->alloc_size - 1);
+    index = hash & (hmap->alloc_size - 1);
     if (index >= hmap->alloc_size) {
         return -1;
     }
@@ -173,8 +444,18 @@ int bodhi_hmap_insert_no_cpy(bodhi_hmap_t *hmap, void *key, void *val) {
     } else {
         bodhi_list_add(hmap->buckets[index], bkt);
     }
+    STATS(hmap->stats.allocs += 2);
 
+inserted:
     hmap->consumed_size++;
+    STATS(hmap->stats.inserts++);
+
+    /* a full filter is rebuilt at twice the size, the new key already in a bucket */
+    if (hmap->filter != NULL && bodhi_cuckoo_add(hmap->filter, hash) != 0 &&
+        _bodhi_hmap_filter_build(hmap, hmap->filter_expected * 2) != 0) {
+        bodhi_cuckoo_free(hmap->filter);
+        hmap->filter = NULL;
+    }
 
     return 0;
 }
@@ -203,55 +484,88 @@ int bodhi_hmap_insert(bodhi_hmap_t *hmap, void *key, size_t key_size, void *val,
     }
 }
 
-static size_t _bodhi_hmap_find_index(bodhi_hmap_t *hmap, void *kv) {
-    ASSERT(kv != NULL, return hmap->alloc_size);
-    size_t index = hmap->hash_fn(kv) % hmap->alloc_size;
-    return index;
-}
-
-static bodhi_list_t *_bodhi_hmap_get_list_item(bodhi_hmap_t *hmap, void *key) {
+/* the entry for key; in table mode *item is set to the chain node holding it */
+static bodhi_hmap_bucket_t *_bodhi_hmap_find(bodhi_hmap_t *hmap, void *key, size_t hash, bodhi_list_t **item) {
     ASSERT(key != NULL, return NULL);
     bodhi_list_t *tmp;
-    size_t index = _bodhi_hmap_find_index(hmap, key);
-    if (index == hmap->alloc_size) {
+    size_t probes = 0;
+    size_t i;
+
+    if (hmap->filter != NULL && !bodhi_cuckoo_maybe(hmap->filter, hash)) {
+        STATS(_bodhi_hmap_probed(hmap, 0));
         return NULL;
     }
 
-    for (tmp = hmap->buckets[index]; tmp; tmp = tmp->next) {
+    if (hmap->buckets == NULL) {
+        for (i = 0; i < hmap->consumed_size; i++) {
+            bodhi_hmap_bucket_t *bkt = &hmap->small[i];
+            if (bkt->h != hash) {
+                continue;
+            }
+            probes++;
+            if (hmap->cmp_fn(key, bkt->key) == 0) {
+                STATS(_bodhi_hmap_probed(hmap, probes));
+                return bkt;
+            }
+        }
+
+        STATS(_bodhi_hmap_probed(hmap, probes));
+        return NULL;
+    }
+
+    for (tmp = hmap->buckets[hash % hmap->alloc_size]; tmp; tmp = tmp->next) {
         bodhi_hmap_bucket_t *bkt = tmp->data;
+        probes++;
         if (hmap->cmp_fn(key, bkt->key) == 0) {
-            return tmp;
+            STATS(_bodhi_hmap_probed(hmap, probes));
+            if (item != NULL) {
+                *item = tmp;
+            }
+            return bkt;
         }
     }
 
+    STATS(_bodhi_hmap_probed(hmap, probes));
+    (void) probes;
     return NULL;
 }
 
 int bodhi_hmap_delete(bodhi_hmap_t *hmap, void *key) {
     ASSERT(hmap != NULL, return -1);
+    ASSERT(key != NULL, return -1);
 
-    bodhi_list_t *to_rm;
-    size_t index = _bodhi_hmap_find_index(hmap, key);
+    bodhi_list_t *to_rm = NULL;
+    bodhi_hmap_bucket_t *bkt = _bodhi_hmap_find(hmap, key, hmap->hash_fn(key), &to_rm);
 
-    if (index == hmap->alloc_size) {
-        return -1;
+    if (bkt == NULL) {
+        return 1;
     }
 
-    to_rm = _bodhi_hmap_get_list_item(hmap, key);
-    if (to_rm != NULL) {
-        bodhi_list_remove_item(hmap->buckets[index], to_rm);
-        hmap->consumed_size--;
-        return 0;
+    hmap->consumed_size--;
+    if (hmap->filter != NULL) {
+        bodhi_cuckoo_remove(hmap->filter, bkt->h);
     }
+    _bodhi_hmap_entry_free(hmap, bkt);
 
-    return 1;
+    if (hmap->buckets == NULL) {
+        /* the last entry fills the hole, small maps keep no order */
+        *bkt = hmap->small[hmap->consumed_size];
+        return 0;
+    }
 
+    /* the head of the chain changes when its first entry goes */
+    hmap->buckets[bkt->h % hmap->alloc_size] =
+            bodhi_list_remove_item(hmap->buckets[bkt->h % hmap->alloc_size], to_rm);
+    free(bkt);
+    bodhi_list_free(to_rm);
+    return 0;
 }
 
 int bodhi_hmap_key_exists(bodhi_hmap_t *hmap, void *key) {
     ASSERT(hmap != NULL, return -1);
+    ASSERT(key != NULL, return 1);
 
-    if (_bodhi_hmap_get_list_item(hmap, key) != NULL) {
+    if (_bodhi_hmap_find(hmap, key, hmap->hash_fn(key), NULL) != NULL) {
         return 0;
     }
 
@@ -260,13 +574,18 @@ int bodhi_hmap_key_exists(bodhi_hmap_t *hmap, void *key) {
 
 void *bodhi_hmap_value(bodhi_hmap_t *hmap, void *key) {
     ASSERT(hmap != NULL, return NULL);
-    bodhi_list_t *item = _bodhi_hmap_get_list_item(hmap, key);
+    ASSERT(key != NULL, return NULL);
+    return bodhi_hmap_value_hashed(hmap, key, hmap->hash_fn(key));
+}
+
+void *bodhi_hmap_value_hashed(bodhi_hmap_t *hmap, void *key, size_t hash) {
+    ASSERT(hmap != NULL, return NULL);
+    bodhi_hmap_bucket_t *bkt = _bodhi_hmap_find(hmap, key, hash, NULL);
 
-    if (item == NULL) {
+    if (bkt == NULL) {
         return NULL;
     }
 
-    bodhi_hmap_bucket_t *bkt = item->data;
     return bkt->val;
 }
 
@@ -281,7 +600,11 @@ bodhi_list_t *bodhi_hmap_get_keys(bodhi_hmap_t *hmap) {
     bodhi_list_t *ret = NULL;
     size_t cur;
 
-    for (cur = 0; cur < hmap->alloc_size; cur++) {
+    for (cur = 0; hmap->buckets == NULL && cur < hmap->consumed_size; cur++) {
+        ret = bodhi_list_add(ret, hmap->small[cur].key);
+    }
+
+    for (cur = 0; hmap->buckets != NULL && cur < hmap->alloc_size; cur++) {
         if (hmap->buckets[cur] != NULL) {
             bodhi_list_t *tmp;
             for (tmp = hmap->buckets[cur]; tmp; tmp = tmp->next) {
@@ -304,7 +627,11 @@ bodhi_list_t *bodhi_hmap_get_keyvals(bodhi_hmap_t *hmap) {
     bodhi_list_t *ret = NULL;
     size_t cur;
 
-    for (cur = 0; cur < hmap->alloc_size; cur++) {
+    for (cur = 0; hmap->buckets == NULL && cur < hmap->consumed_size; cur++) {
+        ret = bodhi_list_add(ret, (char *) &hmap->small[cur] + sizeof(size_t));
+    }
+
+    for (cur = 0; hmap->buckets != NULL && cur < hmap->alloc_size; cur++) {
         if (hmap->buckets[cur] != NULL) {
             bodhi_list_t *tmp;
             for (tmp = hmap->buckets[cur]; tmp; tmp = tmp->next) {
@@ -319,4 +646,137 @@ bodhi_list_t *bodhi_hmap_get_keyvals(bodhi_hmap_t *hmap) {
     }
 
     return ret;
-}
\ No newline at end of file
+}
+
+/* each thread's accumulator starts on its own cache line */
+#define ACC_STRIDE(size) (((size) + 63) & ~(size_t) 63)
+
+typedef struct _bodhi_hmap_scan_t {
+    bodhi_hmap_t *hmap;
+    bodhi_hmap_each_fn fn;
+    void *udata;
+    char *accs;
+    size_t stride;
+    size_t chunk;
+    size_t next;
+} bodhi_hmap_scan_t;
+
+static void _bodhi_hmap_scan(void *arg, int thread) {
+    bodhi_hmap_scan_t *scan = arg;
+    bodhi_hmap_t *hmap = scan->hmap;
+    void *acc = scan->accs != NULL ? scan->accs + (size_t) thread * scan->stride : NULL;
+    size_t lo, hi, cur;
+    bodhi_list_t *tmp;
+
+    while ((lo = ATOMIC_FETCH_ADD(&scan->next, scan->chunk)) < hmap->alloc_size) {
+        hi = lo + scan->chunk < hmap->alloc_size ? lo + scan->chunk : hmap->alloc_size;
+        for (cur = lo; cur < hi; cur++) {
+            for (tmp = hmap->buckets[cur]; tmp; tmp = tmp->next) {
+                bodhi_hmap_bucket_t *bkt = tmp->data;
+                scan->fn(bkt->key, bkt->val, acc, scan->udata);
+            }
+        }
+    }
+}
+
+int bodhi_hmap_parallel_foreach(bodhi_hmap_t *hmap, int nthreads, bodhi_hmap_each_fn fn, size_t acc_size,
+                                bodhi_hmap_reduce_fn reduce, void *result, void *udata) {
+    bodhi_hmap_scan_t scan;
+    size_t i;
+    int t;
+
+    ASSERT(hmap != NULL, return -1);
+    ASSERT(fn != NULL, return -1);
+
+    /* a small map is not worth a second thread */
+    if (nthreads < 1 || hmap->buckets == NULL) {
+        nthreads = 1;
+    }
+
+    scan.hmap = hmap;
+    scan.fn = fn;
+    scan.udata = udata;
+    scan.accs = NULL;
+    scan.stride = ACC_STRIDE(acc_size);
+    scan.next = 0;
+    /* several ranges per thread, so uneven chains even out */
+    scan.chunk = hmap->alloc_size / ((size_t) nthreads * 16);
+    if (scan.chunk < 64) {
+        scan.chunk = 64;
+    }
+
+    if (acc_size > 0) {
+        CALLOC(scan.accs, (size_t) nthreads, scan.stride, return -1);
+    }
+
+    if (hmap->buckets == NULL) {
+        for (i = 0; i < hmap->consumed_size; i++) {
+            fn(hmap->small[i].key, hmap->small[i].val, scan.accs, udata);
+        }
+    } else {
+        bodhi_pool_run(nthreads, _bodhi_hmap_scan, &scan);
+    }
+
+    for (t = 0; reduce != NULL && scan.accs != NULL && t < nthreads; t++) {
+        reduce(result, scan.accs + (size_t) t * scan.stride, udata);
+    }
+
+    free(scan.accs);
+    return 0;
+}
+
+int bodhi_hmap_stats(bodhi_hmap_t *hmap, bodhi_hmap_stats_t *stats) {
+    ASSERT(hmap != NULL, return -1);
+    ASSERT(stats != NULL, return -1);
+
+    size_t cur;
+
+#ifdef BODHI_STATS
+    *stats = hmap->stats;
+    stats->counters = 1;
+    stats->lookups = ATOMIC_LOAD_RELAXED(&hmap->stats.lookups);
+    stats->probes = ATOMIC_LOAD_RELAXED(&hmap->stats.probes);
+    for (cur = 0; cur < BODHI_HMAP_HIST; cur++) {
+        stats->probe_hist[cur] = ATOMIC_LOAD_RELAXED(&hmap->stats.probe_hist[cur]);
+    }
+#else
+    memset(stats, 0, sizeof(bodhi_hmap_stats_t));
+#endif
+
+    stats->size = hmap->consumed_size;
+    stats->buckets = hmap->buckets != NULL ? hmap->alloc_size : 0;
+    stats->max_chain = 0;
+    stats->used_buckets = 0;
+    memset(stats->chain_hist, 0, sizeof(stats->chain_hist));
+    stats->memory = sizeof(bodhi_hmap_t);
+    if (hmap->filter != NULL) {
+        stats->memory += bodhi_cuckoo_memory(hmap->filter);
+    }
+
+    if (hmap->buckets == NULL) {
+        return 0;
+    }
+
+    for (cur = 0; cur < hmap->alloc_size; cur++) {
+        size_t len = bodhi_list_count(hmap->buckets[cur]);
+
+        stats->chain_hist[len < BODHI_HMAP_HIST ? len : BODHI_HMAP_HIST - 1]++;
+        stats->used_buckets += len != 0;
+        if (len > stats->max_chain) {
+            stats->max_chain = len;
+        }
+    }
+
+    /* keys and values are the caller's, only what the table allocates counts */
+    stats->memory += hmap->alloc_size * sizeof(bodhi_list_t*) +
+                     hmap->consumed_size * (sizeof(bodhi_list_t) + sizeof(bodhi_hmap_bucket_t));
+
+    return 0;
+}
+
+void bodhi_hmap_stats_reset(bodhi_hmap_t *hmap) {
+    ASSERT(hmap != NULL, return);
+#ifdef BODHI_STATS
+    memset(&hmap->stats, 0, sizeof(bodhi_hmap_stats_t));
+#endif
+}
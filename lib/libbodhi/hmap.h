@@ -19,6 +19,7 @@
 #ifndef BODHI_HMAP_H
 #define BODHI_HMAP_H
 
+#include <inttypes.h>
 #include <stdlib.h>
 
 #include <libbodhi/list.h>
@@ -29,23 +30,103 @@ typedef size_t (*bodhi_hash_fn)(void *);
 typedef int (*bodhi_hmap_cmp_fn)(const void *, const void *);
 typedef void (*bodhi_hmap_free_fn)(void *);
 
+/*
+ * Parallel scans hand every thread its own zeroed accumulator of the
+ * requested size, then fold the accumulators into the caller's result
+ * one at a time with the reduce callback.
+ */
+typedef void (*bodhi_hmap_each_fn)(void *key, void *val, void *acc, void *udata);
+typedef void (*bodhi_hmap_reduce_fn)(void *result, void *acc, void *udata);
+
 typedef struct _bodhi_hmap_keyval_t {
     void *key;
     void *val;
 } bodhi_hmap_keyval_t;
 
+#define BODHI_HMAP_HIST 16
+
+/*
+ * Filled in by bodhi_hmap_stats. The shape of the table is measured on
+ * every call; the event counters after memory are only kept when the
+ * library is built with BODHI_STATS, which counters tells. chain_hist
+ * counts buckets by chain length and probe_hist lookups by entries
+ * compared, the last slot taking everything longer. The lookup counters
+ * are relaxed atomics, so concurrent readers stay safe; the rest only move
+ * on writes, which need the map to themselves anyway.
+ */
+typedef struct _bodhi_hmap_stats_t {
+    int counters;
+    size_t size;
+    size_t buckets;
+    size_t used_buckets;
+    size_t max_chain;
+    size_t chain_hist[BODHI_HMAP_HIST];
+    size_t memory;
+
+    uint64_t inserts;
+    uint64_t lookups;
+    uint64_t probes;
+    uint64_t probe_hist[BODHI_HMAP_HIST];
+    uint64_t resizes;
+    double resize_secs;
+    double resize_max_secs;
+    uint64_t allocs;
+} bodhi_hmap_stats_t;
+
+/*
+ * size is the number of buckets, a power of two. Until a map holds more
+ * than 8 entries it keeps them inline and allocates no buckets, so tiny
+ * maps cost one allocation. The keyvals from bodhi_hmap_get_keyvals point
+ * into the map and are only good until it next changes.
+ */
 bodhi_hmap_t *bodhi_hmap_new_size(bodhi_hash_fn hash_fn, bodhi_hmap_cmp_fn cmp_fn,
     bodhi_hmap_free_fn key_free_fn, bodhi_hmap_free_fn val_free_fn, size_t size);
 bodhi_hmap_t *bodhi_hmap_new(bodhi_hash_fn hash_fn, bodhi_hmap_cmp_fn cmp_fn,
     bodhi_hmap_free_fn key_free_fn, bodhi_hmap_free_fn val_free_fn);
 void bodhi_hmap_free(bodhi_hmap_t *hmap);
+/*
+ * Teardown without one long pause. free_detached hands the map to the
+ * reaper thread (see reaper.h) and returns at once. free_step frees at
+ * most max entries or empty buckets per call and returns 1 while the map
+ * still exists, 0 once it is gone; once started, nothing but further
+ * free_step calls may touch the map.
+ */
+void bodhi_hmap_free_detached(bodhi_hmap_t *hmap);
+int bodhi_hmap_free_step(bodhi_hmap_t *hmap, size_t max);
 int bodhi_hmap_insert_no_cpy(bodhi_hmap_t *hmap, void *key, void *val);
 int bodhi_hmap_insert(bodhi_hmap_t *hmap, void *key, size_t key_size, void *val, size_t val_size);
 int bodhi_hmap_delete(bodhi_hmap_t *hmap, void *key);
 int bodhi_hmap_key_exists(bodhi_hmap_t *hmap, void *key);
 void *bodhi_hmap_value(bodhi_hmap_t *hmap, void *key);
 size_t bodhi_hmap_size(bodhi_hmap_t *hmap);
+/*
+ * insert_no_cpy and value for callers that already hold hash_fn(key),
+ * so the key is not hashed again; hash must be exactly that value
+ */
+int bodhi_hmap_insert_no_cpy_hashed(bodhi_hmap_t *hmap, void *key, void *val, size_t hash);
+void *bodhi_hmap_value_hashed(bodhi_hmap_t *hmap, void *key, size_t hash);
 bodhi_list_t *bodhi_hmap_get_keys(bodhi_hmap_t *hmap);
 bodhi_list_t *bodhi_hmap_get_keyvals(bodhi_hmap_t *hmap);
+/*
+ * puts a cuckoo filter of key hashes in front of the table so lookups of
+ * absent keys usually return before walking a chain and calling cmp_fn;
+ * fpr is the target false positive rate, 0 removes the filter again. Pays
+ * off for miss-heavy workloads with expensive compares. Returns -1 if the
+ * filter can't be allocated or the hashes won't fit even at four times
+ * the size, as happens when many keys share one hash. An insert that
+ * fills the filter rebuilds it the same way and drops it on failure; the
+ * map stays correct, only the misses get slower.
+ */
+int bodhi_hmap_filter(bodhi_hmap_t *hmap, double fpr);
+/*
+ * calls fn on every entry from nthreads threads, each taking ranges of
+ * buckets in turn; acc_size may be 0 for no accumulators, reduce may be
+ * NULL. The map must not change meanwhile. Returns -1 if the
+ * accumulators can't be allocated, 0 otherwise.
+ */
+int bodhi_hmap_parallel_foreach(bodhi_hmap_t *hmap, int nthreads, bodhi_hmap_each_fn fn, size_t acc_size,
+                                bodhi_hmap_reduce_fn reduce, void *result, void *udata);
+int bodhi_hmap_stats(bodhi_hmap_t *hmap, bodhi_hmap_stats_t *stats);
+void bodhi_hmap_stats_reset(bodhi_hmap_t *hmap);
 
 #endif
@@ -0,0 +1,322 @@
+/*
+ * intern.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hmap.h"
+#include "intern.h"
+#include "util.h"
+
+#define CHUNK_SIZE 65536
+#define SEG_BASE 1024
+#define SEGS 23
+
+/* every canonical string is preceded by its header in the arena */
+typedef struct _bodhi_intern_hdr_t {
+    size_t hash;
+    uint32_t id;
+    uint32_t len;
+} bodhi_intern_hdr_t;
+
+typedef struct _bodhi_intern_chunk_t {
+    struct _bodhi_intern_chunk_t *next;
+    size_t used;
+    size_t cap;
+} bodhi_intern_chunk_t;
+
+/*
+ * ids index segments of doubling size, SEG_BASE << s entries in segment s,
+ * which are never moved once published, so lookups by id need no lock
+ */
+struct _bodhi_intern_t {
+    bodhi_hmap_t *map;
+    bodhi_intern_chunk_t *chunks;
+    const char **segs[SEGS];
+    uint32_t count;
+    size_t memory;
+
+    int threadsafe;
+    pthread_rwlock_t lock;
+};
+
+#define HDR(s) ((const bodhi_intern_hdr_t *) ((const char *) (s) - sizeof(bodhi_intern_hdr_t)))
+#define ALIGN(n) (((n) + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1))
+
+/* fnv-1a, also giving the length */
+static size_t _bodhi_intern_hash_str(const char *str, size_t *len) {
+    const unsigned char *p = (const unsigned char *) str;
+    size_t h = (size_t) 14695981039346656037ull;
+
+    while (*p != '\0') {
+        h = (h ^ *p++) * (size_t) 1099511628211ull;
+    }
+
+    if (len != NULL) {
+        *len = (size_t) ((const char *) p - str);
+    }
+    return h;
+}
+
+static size_t _bodhi_intern_map_hash(void *key) {
+    return _bodhi_intern_hash_str(key, NULL);
+}
+
+static int _bodhi_intern_map_cmp(const void *a, const void *b) {
+    return strcmp(a, b);
+}
+
+static bodhi_intern_t *_bodhi_intern_new(int threadsafe) {
+    bodhi_intern_t *ret;
+
+    CALLOC(ret, 1, sizeof(bodhi_intern_t), return NULL);
+    ret->map = bodhi_hmap_new_size(_bodhi_intern_map_hash, _bodhi_intern_map_cmp, NULL, NULL, 1024);
+    if (ret->map == NULL) {
+        free(ret);
+        return NULL;
+    }
+
+    ret->threadsafe = threadsafe;
+    if (threadsafe && pthread_rwlock_init(&ret->lock, NULL) != 0) {
+        bodhi_hmap_free(ret->map);
+        free(ret);
+        return NULL;
+    }
+
+    return ret;
+}
+
+bodhi_intern_t *bodhi_intern_new(void) {
+    return _bodhi_intern_new(0);
+}
+
+bodhi_intern_t *bodhi_intern_new_threadsafe(void) {
+    return _bodhi_intern_new(1);
+}
+
+void bodhi_intern_free(bodhi_intern_t *intern) {
+    bodhi_intern_chunk_t *chunk, *next;
+    int s;
+
+    ASSERT(intern != NULL, return);
+
+    for (chunk = intern->chunks; chunk != NULL; chunk = next) {
+        next = chunk->next;
+        free(chunk);
+    }
+
+    for (s = 0; s < SEGS; s++) {
+        free((void *) intern->segs[s]);
+    }
+
+    if (intern->threadsafe) {
+        pthread_rwlock_destroy(&intern->lock);
+    }
+
+    bodhi_hmap_free(intern->map);
+    free(intern);
+}
+
+static int _bodhi_intern_seg(uint32_t id, uint32_t *offset) {
+    uint32_t x = id / SEG_BASE + 1;
+    int s = 31 - (int) CLZ32(x);
+
+    *offset = id - SEG_BASE * ((1u << s) - 1);
+    return s;
+}
+
+/*
+ * copies str into the arena and gives it the next id, under the write
+ * lock; len and hash are the ones bodhi_intern measured
+ */
+static const char *_bodhi_intern_add(bodhi_intern_t *intern, const char *str, size_t len, size_t hash) {
+    bodhi_intern_chunk_t *chunk = intern->chunks;
+    bodhi_intern_hdr_t *hdr;
+    const char **seg;
+    uint32_t offset;
+    size_t need;
+    char *ret;
+    int s;
+
+    if (intern->count == BODHI_INTERN_NONE || len > 0xFFFFFFFFu) {
+        return NULL;
+    }
+
+    s = _bodhi_intern_seg(intern->count, &offset);
+    seg = intern->segs[s];
+    if (seg == NULL) {
+        MALLOC(seg, ((size_t) SEG_BASE << s) * sizeof(char *), return NULL);
+        intern->memory += ((size_t) SEG_BASE << s) * sizeof(char *);
+    }
+
+    need = ALIGN(sizeof(bodhi_intern_hdr_t) + len + 1);
+
+    /* big strings get a chunk of their own */
+    if (chunk == NULL || chunk->cap - chunk->used < need) {
+        size_t cap = need > CHUNK_SIZE ? need : CHUNK_SIZE;
+
+        MALLOC(chunk, ALIGN(sizeof(bodhi_intern_chunk_t)) + cap, goto fail);
+        chunk->used = 0;
+        chunk->cap = cap;
+        chunk->next = intern->chunks;
+        intern->chunks = chunk;
+        intern->memory += ALIGN(sizeof(bodhi_intern_chunk_t)) + cap;
+    }
+
+    hdr = (bodhi_intern_hdr_t *) ((char *) chunk + ALIGN(sizeof(bodhi_intern_chunk_t)) + chunk->used);
+    hdr->hash = hash;
+    hdr->id = intern->count;
+    hdr->len = (uint32_t) len;
+    ret = (char *) (hdr + 1);
+    memcpy(ret, str, len + 1);
+
+    if (bodhi_hmap_insert_no_cpy_hashed(intern->map, ret, ret, hash) != 0) {
+        goto fail;
+    }
+
+    chunk->used += need;
+    seg[offset] = ret;
+    if (intern->segs[s] == NULL) {
+        ATOMIC_STORE(&intern->segs[s], seg);
+    }
+    ATOMIC_STORE(&intern->count, intern->count + 1);
+
+    return ret;
+
+fail:
+    if (intern->segs[s] == NULL) {
+        free((void *) seg);
+        intern->memory -= ((size_t) SEG_BASE << s) * sizeof(char *);
+    }
+    return NULL;
+}
+
+const char *bodhi_intern(bodhi_intern_t *intern, const char *str) {
+    const char *ret;
+    size_t hash, len;
+
+    ASSERT(intern != NULL, return NULL);
+    ASSERT(str != NULL, return NULL);
+
+    /* one pass over str serves every lookup and the add */
+    hash = _bodhi_intern_hash_str(str, &len);
+
+    if (!intern->threadsafe) {
+        ret = bodhi_hmap_value_hashed(intern->map, (void *) str, hash);
+        return ret != NULL ? ret : _bodhi_intern_add(intern, str, len, hash);
+    }
+
+    pthread_rwlock_rdlock(&intern->lock);
+    ret = bodhi_hmap_value_hashed(intern->map, (void *) str, hash);
+    pthread_rwlock_unlock(&intern->lock);
+
+    if (ret == NULL) {
+        /* someone may have added it between the locks */
+        pthread_rwlock_wrlock(&intern->lock);
+        ret = bodhi_hmap_value_hashed(intern->map, (void *) str, hash);
+        if (ret == NULL) {
+            ret = _bodhi_intern_add(intern, str, len, hash);
+        }
+        pthread_rwlock_unlock(&intern->lock);
+    }
+
+    return ret;
+}
+
+uint32_t bodhi_intern_id(bodhi_intern_t *intern, const char *str) {
+    const char *canonical = bodhi_intern(intern, str);
+    return canonical == NULL ? BODHI_INTERN_NONE : HDR(canonical)->id;
+}
+
+const char *bodhi_intern_find(bodhi_intern_t *intern, const char *str) {
+    const char *ret;
+
+    ASSERT(intern != NULL, return NULL);
+    ASSERT(str != NULL, return NULL);
+
+    if (intern->threadsafe) {
+        pthread_rwlock_rdlock(&intern->lock);
+    }
+    ret = bodhi_hmap_value(intern->map, (void *) str);
+    if (intern->threadsafe) {
+        pthread_rwlock_unlock(&intern->lock);
+    }
+
+    return ret;
+}
+
+const char *bodhi_intern_str(bodhi_intern_t *intern, uint32_t id) {
+    const char **seg;
+    uint32_t offset;
+    int s;
+
+    ASSERT(intern != NULL, return NULL);
+
+    if (id >= ATOMIC_LOAD(&intern->count)) {
+        return NULL;
+    }
+
+    s = _bodhi_intern_seg(id, &offset);
+    seg = ATOMIC_LOAD(&intern->segs[s]);
+    return seg[offset];
+}
+
+size_t bodhi_intern_size(bodhi_intern_t *intern) {
+    ASSERT(intern != NULL, return 0);
+    return ATOMIC_LOAD(&intern->count);
+}
+
+size_t bodhi_intern_memory(bodhi_intern_t *intern) {
+    bodhi_hmap_stats_t stats;
+    size_t ret;
+
+    ASSERT(intern != NULL, return 0);
+
+    if (intern->threadsafe) {
+        pthread_rwlock_rdlock(&intern->lock);
+    }
+    bodhi_hmap_stats(intern->map, &stats);
+    ret = sizeof(bodhi_intern_t) + intern->memory + stats.memory;
+    if (intern->threadsafe) {
+        pthread_rwlock_unlock(&intern->lock);
+    }
+
+    return ret;
+}
+
+uint32_t bodhi_intern_id_of(const char *canonical) {
+    ASSERT(canonical != NULL, return BODHI_INTERN_NONE);
+    return HDR(canonical)->id;
+}
+
+size_t bodhi_intern_len(const char *canonical) {
+    ASSERT(canonical != NULL, return 0);
+    return HDR(canonical)->len;
+}
+
+size_t bodhi_intern_hash(void *canonical) {
+    ASSERT(canonical != NULL, return 0);
+    return HDR(canonical)->hash;
+}
+
+int bodhi_intern_cmp(const void *a, const void *b) {
+    return a != b;
+}
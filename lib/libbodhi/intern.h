@@ -0,0 +1,63 @@
+/*
+ * intern.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BODHI_INTERN_H
+#define BODHI_INTERN_H
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+/*
+ * Deduplicates nul terminated strings into an append only arena. Each
+ * distinct string gets one canonical copy, which stays put until the
+ * table is freed, and a 32 bit id counting up from 0 in the order strings
+ * were first seen.
+ *
+ * Maps keyed by canonical pointers can use bodhi_intern_hash and
+ * bodhi_intern_cmp as their bodhi_hash_fn and bodhi_hmap_cmp_fn: the first
+ * returns the hash stored with the string, the second compares pointers,
+ * so neither looks at the characters again.
+ *
+ * The threadsafe variant takes a reader-writer lock around the table;
+ * looking a string up by id takes no lock in either variant.
+ */
+typedef struct _bodhi_intern_t bodhi_intern_t;
+
+#define BODHI_INTERN_NONE ((uint32_t) 0xFFFFFFFFu)
+
+bodhi_intern_t *bodhi_intern_new(void);
+bodhi_intern_t *bodhi_intern_new_threadsafe(void);
+void bodhi_intern_free(bodhi_intern_t *intern);
+
+/* the canonical copy of str, added if needed; NULL on error */
+const char *bodhi_intern(bodhi_intern_t *intern, const char *str);
+/* as bodhi_intern, returning the id or BODHI_INTERN_NONE */
+uint32_t bodhi_intern_id(bodhi_intern_t *intern, const char *str);
+/* the canonical copy if str was interned before, NULL otherwise */
+const char *bodhi_intern_find(bodhi_intern_t *intern, const char *str);
+const char *bodhi_intern_str(bodhi_intern_t *intern, uint32_t id);
+size_t bodhi_intern_size(bodhi_intern_t *intern);
+size_t bodhi_intern_memory(bodhi_intern_t *intern);
+
+/* only valid on canonical pointers */
+uint32_t bodhi_intern_id_of(const char *canonical);
+size_t bodhi_intern_len(const char *canonical);
+size_t bodhi_intern_hash(void *canonical);
+int bodhi_intern_cmp(const void *a, const void *b);
+
+#endif
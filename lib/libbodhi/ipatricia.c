@@ -0,0 +1,380 @@
+/*
+ * ipatricia.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include "ipatricia.h"
+#include "util.h"
+
+/*
+ * A reference to a node is an index into one of the arrays, with the top bit
+ * telling which. Branches only hold the bit they test; the full key is only
+ * compared once a leaf is reached.
+ */
+#define NIL 0xFFFFFFFFu
+#define LEAF_FLAG 0x80000000u
+#define IS_LEAF(r) (((r) & LEAF_FLAG) != 0)
+#define INDEX(r) ((r) & ~LEAF_FLAG)
+
+#define KEY_BIT(k, i) (((k) >> (31 - (i))) & 1)
+
+typedef struct _bodhi_ipatricia_branch_t {
+    uint32_t child[2];
+    uint32_t pos;
+} bodhi_ipatricia_branch_t;
+
+typedef struct _bodhi_ipatricia_leaf_t {
+    uint32_t key;
+    void *data;
+} bodhi_ipatricia_leaf_t;
+
+struct _bodhi_ipatricia_t {
+    uint32_t root;
+    size_t size;
+
+    bodhi_ipatricia_branch_t *branches;
+    uint32_t branch_count;
+    uint32_t branch_alloc;
+    uint32_t branch_free;
+
+    bodhi_ipatricia_leaf_t *leaves;
+    uint32_t leaf_count;
+    uint32_t leaf_alloc;
+    uint32_t leaf_free;
+};
+
+/* marks a leaf that is on the free list, its key holds the next free one */
+static char _free_leaf;
+
+bodhi_ipatricia_t *bodhi_ipatricia_new(void) {
+    bodhi_ipatricia_t *ret;
+
+    CALLOC(ret, 1, sizeof(bodhi_ipatricia_t), return NULL);
+    ret->root = NIL;
+    ret->branch_free = NIL;
+    ret->leaf_free = NIL;
+
+    return ret;
+}
+
+void bodhi_ipatricia_free(bodhi_ipatricia_t *trie, trie_free_fn fn) {
+    uint32_t i;
+
+    ASSERT(trie != NULL, return);
+
+    /* no need to walk the tree, the leaves are all in one array */
+    if (fn != NULL) {
+        for (i = 0; i < trie->leaf_count; i++) {
+            void *data = trie->leaves[i].data;
+            if (data != NULL && data != &_free_leaf) {
+                fn(data);
+            }
+        }
+    }
+
+    free(trie->branches);
+    free(trie->leaves);
+    free(trie);
+}
+
+static int _grow(void **arr, uint32_t *alloc, size_t elem, size_t want) {
+    size_t new_alloc = *alloc == 0 ? 16 : *alloc;
+    void *tmp;
+
+    if (want <= *alloc) {
+        return 0;
+    }
+
+    while (new_alloc < want) {
+        new_alloc *= 2;
+    }
+
+    if (new_alloc > INDEX(NIL)) {
+        return -1;
+    }
+
+    tmp = realloc(*arr, new_alloc * elem);
+    if (tmp == NULL) {
+        return -1;
+    }
+
+    *arr = tmp;
+    *alloc = (uint32_t) new_alloc;
+    return 0;
+}
+
+int bodhi_ipatricia_reserve(bodhi_ipatricia_t *trie, size_t n) {
+    ASSERT(trie != NULL, return -1);
+
+    if (_grow((void **) &trie->leaves, &trie->leaf_alloc, sizeof(bodhi_ipatricia_leaf_t), n) != 0) {
+        return -1;
+    }
+
+    return _grow((void **) &trie->branches, &trie->branch_alloc, sizeof(bodhi_ipatricia_branch_t), n);
+}
+
+static uint32_t _alloc_leaf(bodhi_ipatricia_t *trie) {
+    uint32_t i = trie->leaf_free;
+
+    if (i != NIL) {
+        trie->leaf_free = trie->leaves[i].key;
+        return i;
+    }
+
+    if (_grow((void **) &trie->leaves, &trie->leaf_alloc, sizeof(bodhi_ipatricia_leaf_t),
+              (size_t) trie->leaf_count + 1) != 0) {
+        return NIL;
+    }
+
+    return trie->leaf_count++;
+}
+
+static uint32_t _alloc_branch(bodhi_ipatricia_t *trie) {
+    uint32_t i = trie->branch_free;
+
+    if (i != NIL) {
+        trie->branch_free = trie->branches[i].child[0];
+        return i;
+    }
+
+    if (_grow((void **) &trie->branches, &trie->branch_alloc, sizeof(bodhi_ipatricia_branch_t),
+              (size_t) trie->branch_count + 1) != 0) {
+        return NIL;
+    }
+
+    return trie->branch_count++;
+}
+
+static void _release_leaf(bodhi_ipatricia_t *trie, uint32_t i) {
+    trie->leaves[i].key = trie->leaf_free;
+    trie->leaves[i].data = &_free_leaf;
+    trie->leaf_free = i;
+}
+
+static void _release_branch(bodhi_ipatricia_t *trie, uint32_t i) {
+    trie->branches[i].child[0] = trie->branch_free;
+    trie->branch_free = i;
+}
+
+/* follows key's bits down to a leaf, ignoring the bits branches skip */
+static uint32_t _find_leaf(bodhi_ipatricia_t *trie, uint32_t key) {
+    uint32_t r = trie->root;
+
+    while (r != NIL && !IS_LEAF(r)) {
+        bodhi_ipatricia_branch_t *b = &trie->branches[r];
+        r = b->child[KEY_BIT(key, b->pos)];
+    }
+
+    return r;
+}
+
+int bodhi_ipatricia_add(bodhi_ipatricia_t *trie, uint32_t key, void *data) {
+    uint32_t *link;
+    uint32_t leaf;
+    uint32_t branch;
+    uint32_t r;
+    uint32_t crit;
+
+    ASSERT(trie != NULL, return 0);
+
+    r = _find_leaf(trie, key);
+    if (r != NIL && trie->leaves[INDEX(r)].key == key) {
+        return 0;
+    }
+
+    /* allocate first, growing the arrays moves them */
+    if ((leaf = _alloc_leaf(trie)) == NIL) {
+        return 0;
+    }
+    trie->leaves[leaf].key = key;
+    trie->leaves[leaf].data = data;
+    trie->size++;
+
+    if (r == NIL) {
+        trie->root = leaf | LEAF_FLAG;
+        return 1;
+    }
+
+    if ((branch = _alloc_branch(trie)) == NIL) {
+        _release_leaf(trie, leaf);
+        trie->size--;
+        return 0;
+    }
+
+    /* the new branch goes above the first node testing a later bit */
+    crit = CLZ32(key ^ trie->leaves[INDEX(r)].key);
+    link = &trie->root;
+    while (!IS_LEAF(*link) && trie->branches[*link].pos < crit) {
+        link = &trie->branches[*link].child[KEY_BIT(key, trie->branches[*link].pos)];
+    }
+
+    trie->branches[branch].pos = crit;
+    trie->branches[branch].child[KEY_BIT(key, crit)] = leaf | LEAF_FLAG;
+    trie->branches[branch].child[!KEY_BIT(key, crit)] = *link;
+    *link = branch;
+
+    return 1;
+}
+
+int bodhi_ipatricia_remove(bodhi_ipatricia_t *trie, uint32_t key, void **retval) {
+    uint32_t *plink = NULL;
+    uint32_t *link;
+    uint32_t leaf;
+    uint32_t branch;
+    int bit = 0;
+
+    ASSERT(trie != NULL, return 0);
+
+    link = &trie->root;
+    if (*link == NIL) {
+        return 0;
+    }
+
+    while (!IS_LEAF(*link)) {
+        plink = link;
+        bit = KEY_BIT(key, trie->branches[*link].pos);
+        link = &trie->branches[*link].child[bit];
+    }
+
+    leaf = INDEX(*link);
+    if (trie->leaves[leaf].key != key) {
+        return 0;
+    }
+
+    if (retval != NULL) {
+        *retval = trie->leaves[leaf].data;
+    }
+
+    if (plink == NULL) {
+        trie->root = NIL;
+    } else {
+        /* the sibling takes the place of the parent branch */
+        branch = *plink;
+        *plink = trie->branches[branch].child[!bit];
+        _release_branch(trie, branch);
+    }
+
+    _release_leaf(trie, leaf);
+    trie->size--;
+    return 1;
+}
+
+bodhi_ipatricia_t *bodhi_ipatricia_build_sorted(const uint32_t *keys, void **values, size_t n) {
+    bodhi_ipatricia_t *ret;
+    uint32_t spine[32];
+    int depth = 0;
+    uint32_t last = NIL;
+    uint32_t child;
+    uint32_t gap;
+    size_t i;
+
+    for (i = 1; i < n; i++) {
+        ASSERT(keys[i - 1] < keys[i], return NULL);
+    }
+
+    if ((ret = bodhi_ipatricia_new()) == NULL) {
+        return NULL;
+    }
+
+    if (n == 0) {
+        return ret;
+    }
+
+    /* exactly n leaves and n - 1 branches, each array a single allocation */
+    if (bodhi_ipatricia_reserve(ret, n) != 0) {
+        bodhi_ipatricia_free(ret, NULL);
+        return NULL;
+    }
+
+    /* see bodhi_patricia_build_sorted, the same spine walk with indices */
+    for (i = 0; i < n; i++) {
+        ret->leaves[i].key = keys[i];
+        ret->leaves[i].data = values != NULL ? values[i] : NULL;
+
+        if (i > 0) {
+            uint32_t branch = (uint32_t) i - 1;
+
+            gap = CLZ32(keys[i - 1] ^ keys[i]);
+            child = last;
+            while (depth > 0 && ret->branches[spine[depth - 1]].pos > gap) {
+                child = spine[--depth];
+            }
+
+            ret->branches[branch].pos = gap;
+            ret->branches[branch].child[0] = child;
+            ret->branches[branch].child[1] = (uint32_t) i | LEAF_FLAG;
+
+            if (depth > 0) {
+                ret->branches[spine[depth - 1]].child[1] = branch;
+            }
+            spine[depth++] = branch;
+        }
+
+        last = (uint32_t) i | LEAF_FLAG;
+    }
+
+    ret->root = depth > 0 ? spine[0] : last;
+    ret->leaf_count = (uint32_t) n;
+    ret->branch_count = (uint32_t) n - 1;
+    ret->size = n;
+
+    return ret;
+}
+
+void *bodhi_ipatricia_find_val(bodhi_ipatricia_t *trie, uint32_t key) {
+    uint32_t r;
+
+    ASSERT(trie != NULL, return NULL);
+
+    r = _find_leaf(trie, key);
+    if (r == NIL || trie->leaves[INDEX(r)].key != key) {
+        return NULL;
+    }
+
+    return trie->leaves[INDEX(r)].data;
+}
+
+size_t bodhi_ipatricia_size(bodhi_ipatricia_t *trie) {
+    ASSERT(trie != NULL, return 0);
+    return trie->size;
+}
+
+size_t bodhi_ipatricia_memory(bodhi_ipatricia_t *trie) {
+    ASSERT(trie != NULL, return 0);
+    return sizeof(bodhi_ipatricia_t)
+           + (size_t) trie->leaf_alloc * sizeof(bodhi_ipatricia_leaf_t)
+           + (size_t) trie->branch_alloc * sizeof(bodhi_ipatricia_branch_t);
+}
+
+static void _loop(bodhi_ipatricia_t *trie, uint32_t r, ipatricia_loop_cb cb, void *udata) {
+    while (!IS_LEAF(r)) {
+        _loop(trie, trie->branches[r].child[0], cb, udata);
+        r = trie->branches[r].child[1];
+    }
+
+    cb(trie->leaves[INDEX(r)].key, trie->leaves[INDEX(r)].data, udata);
+}
+
+void bodhi_ipatricia_loop(bodhi_ipatricia_t *trie, ipatricia_loop_cb cb, void *udata) {
+    ASSERT(trie != NULL, return);
+
+    if (trie->root != NIL) {
+        _loop(trie, trie->root, cb, udata);
+    }
+}
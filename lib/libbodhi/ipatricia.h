@@ -0,0 +1,50 @@
+/*
+ * ipatricia.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BODHI_IPATRICIA_H
+#define BODHI_IPATRICIA_H
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include <libbodhi/patricia.h>
+
+/*
+ * A compact patricia trie keyed by 32 bit integers. Nodes live in two
+ * arrays, one for leaves and one for branches, and refer to each other by
+ * 32 bit index, which takes a key to about 28 bytes instead of two
+ * separately allocated bodhi_patricia_t nodes.
+ */
+typedef struct _bodhi_ipatricia_t bodhi_ipatricia_t;
+
+typedef void (ipatricia_loop_cb)(uint32_t key, void *data, void *udata);
+
+bodhi_ipatricia_t *bodhi_ipatricia_new(void);
+void bodhi_ipatricia_free(bodhi_ipatricia_t *trie, trie_free_fn fn);
+/* builds a trie from strictly ascending keys in one pass, values may be NULL */
+bodhi_ipatricia_t *bodhi_ipatricia_build_sorted(const uint32_t *keys, void **values, size_t n);
+int bodhi_ipatricia_reserve(bodhi_ipatricia_t *trie, size_t n);
+int bodhi_ipatricia_add(bodhi_ipatricia_t *trie, uint32_t key, void *data);
+int bodhi_ipatricia_remove(bodhi_ipatricia_t *trie, uint32_t key, void **retval);
+void *bodhi_ipatricia_find_val(bodhi_ipatricia_t *trie, uint32_t key);
+size_t bodhi_ipatricia_size(bodhi_ipatricia_t *trie);
+size_t bodhi_ipatricia_memory(bodhi_ipatricia_t *trie);
+/* visits every key in ascending order */
+void bodhi_ipatricia_loop(bodhi_ipatricia_t *trie, ipatricia_loop_cb cb, void *udata);
+
+#endif
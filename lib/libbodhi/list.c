@@ -21,14 +21,27 @@
 #include "list.h"
 #include "util.h"
 
+#ifdef BODHI_STATS
+/* sharded, every thread allocating nodes would otherwise hit the same line */
+static bodhi_stat_counter_t _stat_allocs;
+static bodhi_stat_counter_t _stat_frees;
+static bodhi_stat_counter_t _stat_merges;
+static bodhi_stat_counter_t _stat_compares;
+#endif
+
 void bodhi_list_free(bodhi_list_t *list) {
     bodhi_list_t *iter;
     bodhi_list_t *tmp;
+    uint64_t frees = 0;
 
     for (iter = list; iter; iter = tmp) {
         tmp = iter->next;
         free(iter);
+        frees++;
     }
+
+    STATS(STAT_ADD(_stat_frees, frees));
+    (void) frees;
 }
 
 void bodhi_list_free_inner(bodhi_list_t *list, bodhi_list_free_fn fn) {
@@ -47,6 +60,7 @@ bodhi_list_t *bodhi_list_new(void *data) {
     bodhi_list_t *ret = NULL;
 
     CALLOC(ret, 1, sizeof(bodhi_list_t), return NULL);
+    STATS(STAT_ADD(_stat_allocs, 1));
 
     ret->data = data;
     ret->next = NULL;
@@ -60,6 +74,7 @@ bodhi_list_t *bodhi_list_add(bodhi_list_t *list, void *data) {
     bodhi_list_t *last;
 
     CALLOC(new, 1, sizeof(bodhi_list_t), return list);
+    STATS(STAT_ADD(_stat_allocs, 1));
 
     new->next = NULL;
     new->data = data;
@@ -71,6 +86,8 @@ bodhi_list_t *bodhi_list_add(bodhi_list_t *list, void *data) {
         list->prev = new;
         return list;
     } else {
+        /* the head's prev points at the tail, here itself */
+        new->prev = new;
         return new;
     }
 }
@@ -84,6 +101,7 @@ bodhi_list_t *bodhi_list_add_sorted(bodhi_list_t *list, void *data, bodhi_list_c
         bodhi_list_t *prev = NULL;
 
         MALLOC(new, sizeof(bodhi_list_t), return list);
+        STATS(STAT_ADD(_stat_allocs, 1));
         new->data = data;
 
         while (next != NULL) {
@@ -141,6 +159,7 @@ bodhi_list_t *bodhi_list_mmerge(bodhi_list_t *left, bodhi_list_t *right, bodhi_l
     bodhi_list_t *last;
     bodhi_list_t *left_last;
     bodhi_list_t *right_last;
+    uint64_t compares = 1;
 
     if (left == NULL) {
         return right;
@@ -165,6 +184,7 @@ bodhi_list_t *bodhi_list_mmerge(bodhi_list_t *left, bodhi_list_t *right, bodhi_l
     lp = new;
 
     while ((left != NULL) && (right != NULL)) {
+        STATS(compares++);
         if (fn(left->data, right->data) <= 0) {
             lp->next = left;
             left->prev = lp;
@@ -193,6 +213,10 @@ bodhi_list_t *bodhi_list_mmerge(bodhi_list_t *left, bodhi_list_t *right, bodhi_l
 
     new->prev = last;
 
+    STATS(STAT_ADD(_stat_merges, 1);
+          STAT_ADD(_stat_compares, compares));
+    (void) compares;
+
     return new;
 }
 
@@ -224,6 +248,149 @@ bodhi_list_t *bodhi_list_msort(bodhi_list_t *list, bodhi_list_cmp_fn fn) {
     return list;
 }
 
+/*
+ * A loser tree over k runs. Internal node i (1 <= i < k) holds the run
+ * that lost the match there and tree[0] the overall winner, so taking the
+ * next element replays only the matches on one leaf's path to the root.
+ * Leaf j sits at position k + j; equal elements go to the lower run,
+ * which keeps the merge stable.
+ */
+struct _bodhi_list_merge_t {
+    bodhi_list_cmp_fn fn;
+    size_t k;
+    bodhi_list_t **cur;
+    size_t *tree;
+    uint64_t compares;
+};
+
+/* does run a come before run b, exhausted runs losing to everything */
+static int _bodhi_list_merge_beats(bodhi_list_merge_t *merge, size_t a, size_t b) {
+    int c;
+
+    if (merge->cur[b] == NULL) {
+        return 1;
+    }
+    if (merge->cur[a] == NULL) {
+        return 0;
+    }
+
+    STATS(merge->compares++);
+    c = merge->fn(merge->cur[a]->data, merge->cur[b]->data);
+    return c < 0 || (c == 0 && a < b);
+}
+
+static size_t _bodhi_list_merge_build(bodhi_list_merge_t *merge, size_t node) {
+    size_t left, right;
+
+    if (node >= merge->k) {
+        return node - merge->k;
+    }
+
+    left = _bodhi_list_merge_build(merge, 2 * node);
+    right = _bodhi_list_merge_build(merge, 2 * node + 1);
+    if (_bodhi_list_merge_beats(merge, left, right)) {
+        merge->tree[node] = right;
+        return left;
+    }
+
+    merge->tree[node] = left;
+    return right;
+}
+
+bodhi_list_merge_t *bodhi_list_merge_new(bodhi_list_t **lists, size_t k, bodhi_list_cmp_fn fn) {
+    bodhi_list_merge_t *merge;
+
+    ASSERT(lists != NULL || k == 0, return NULL);
+    ASSERT(fn != NULL, return NULL);
+
+    MALLOC(merge, sizeof(bodhi_list_merge_t) + k * (sizeof(bodhi_list_t *) + sizeof(size_t)), return NULL);
+    merge->fn = fn;
+    merge->k = k;
+    merge->cur = (bodhi_list_t **) (merge + 1);
+    merge->tree = (size_t *) (merge->cur + k);
+    merge->compares = 0;
+
+    if (k > 0) {
+        memcpy(merge->cur, lists, k * sizeof(bodhi_list_t *));
+        merge->tree[0] = _bodhi_list_merge_build(merge, 1);
+    }
+
+    return merge;
+}
+
+bodhi_list_t *bodhi_list_merge_next(bodhi_list_merge_t *merge) {
+    bodhi_list_t *ret;
+    size_t winner, node, tmp;
+
+    ASSERT(merge != NULL, return NULL);
+
+    if (merge->k == 0 || merge->cur[merge->tree[0]] == NULL) {
+        return NULL;
+    }
+
+    winner = merge->tree[0];
+    ret = merge->cur[winner];
+    merge->cur[winner] = ret->next;
+
+    for (node = (winner + merge->k) / 2; node > 0; node /= 2) {
+        if (_bodhi_list_merge_beats(merge, merge->tree[node], winner)) {
+            tmp = merge->tree[node];
+            merge->tree[node] = winner;
+            winner = tmp;
+        }
+    }
+    merge->tree[0] = winner;
+
+    return ret;
+}
+
+void bodhi_list_merge_free(bodhi_list_merge_t *merge) {
+    if (merge == NULL) {
+        return;
+    }
+
+    STATS(STAT_ADD(_stat_merges, 1);
+          STAT_ADD(_stat_compares, merge->compares));
+    free(merge);
+}
+
+bodhi_list_t *bodhi_list_merge_k(bodhi_list_t **lists, size_t k, bodhi_list_cmp_fn fn) {
+    bodhi_list_merge_t *merge;
+    bodhi_list_t *head = NULL, *tail = NULL, *item;
+    size_t i;
+
+    ASSERT(lists != NULL || k == 0, return NULL);
+    ASSERT(fn != NULL, return NULL);
+
+    merge = bodhi_list_merge_new(lists, k, fn);
+    if (merge == NULL) {
+        /* no room for the tree, merging pairwise needs none */
+        for (i = 1; i < k; i++) {
+            lists[0] = bodhi_list_mmerge(lists[0], lists[i], fn);
+        }
+        return k > 0 ? lists[0] : NULL;
+    }
+
+    /* the iterator has already read item->next, so relinking behind it is safe */
+    while ((item = bodhi_list_merge_next(merge)) != NULL) {
+        if (tail == NULL) {
+            head = item;
+        } else {
+            tail->next = item;
+        }
+        item->prev = tail;
+        tail = item;
+    }
+
+    if (head != NULL) {
+        tail->next = NULL;
+        head->prev = tail;
+    }
+
+    bodhi_list_merge_free(merge);
+    return head;
+}
+
 bodhi_list_t *bodhi_list_remove_item(bodhi_list_t *list, bodhi_list_t *item) {
     if (list == NULL || item == NULL) {
         return list;
@@ -279,6 +446,7 @@ bodhi_list_t *bodhi_list_remove(bodhi_list_t *list, const void *needle, bodhi_li
             }
 
             free(tmp);
+            STATS(STAT_ADD(_stat_frees, 1));
             break;
         }
     }
@@ -446,3 +614,25 @@ void **bodhi_list_to_array(bodhi_list_t *list, size_t size) {
 
     return ret;
 }
+
+void bodhi_list_stats(bodhi_list_stats_t *stats) {
+    ASSERT(stats != NULL, return);
+
+    memset(stats, 0, sizeof(bodhi_list_stats_t));
+#ifdef BODHI_STATS
+    stats->counters = 1;
+    stats->allocs = bodhi_stat_sum(_stat_allocs);
+    stats->frees = bodhi_stat_sum(_stat_frees);
+    stats->merges = bodhi_stat_sum(_stat_merges);
+    stats->compares = bodhi_stat_sum(_stat_compares);
+#endif
+}
+
+void bodhi_list_stats_reset(void) {
+#ifdef BODHI_STATS
+    bodhi_stat_clear(_stat_allocs);
+    bodhi_stat_clear(_stat_frees);
+    bodhi_stat_clear(_stat_merges);
+    bodhi_stat_clear(_stat_compares);
+#endif
+}
@@ -23,6 +23,7 @@
 extern "C" {
 #endif
 
+#include <inttypes.h>
 #include <stdlib.h>
 
 typedef struct _bodhi_list_t {
@@ -33,8 +34,25 @@ typedef struct _bodhi_list_t {
 
 #define FREELIST(p) do { bodhi_list_free_inner(p, free); bodhi_list_free(p); p = NULL; } while (0)
 
+/*
+ * Process wide counters over every list, hmap chains included. They are
+ * only kept when the library is built with BODHI_STATS, which counters
+ * tells. Threads count into separate shards, summed here.
+ */
+typedef struct _bodhi_list_stats_t {
+    int counters;
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t merges;
+    uint64_t compares;
+} bodhi_list_stats_t;
+
+/* streams the merge of several sorted lists, see bodhi_list_merge_new */
+typedef struct _bodhi_list_merge_t bodhi_list_merge_t;
+
 typedef void (*bodhi_list_free_fn)(void *);
 typedef int (*bodhi_list_cmp_fn)(const void *, const void *);
+typedef uint64_t (*bodhi_list_key_fn)(const void *);
 
 void bodhi_list_free(bodhi_list_t *list);
 void bodhi_list_free_inner(bodhi_list_t *list, bodhi_list_free_fn fn);
@@ -44,6 +62,26 @@ bodhi_list_t *bodhi_list_add_sorted(bodhi_list_t *list, void *data, bodhi_list_c
 bodhi_list_t *bodhi_list_join(bodhi_list_t *left, bodhi_list_t *right);
 bodhi_list_t *bodhi_list_mmerge(bodhi_list_t *left, bodhi_list_t *right, bodhi_list_cmp_fn fn);
 bodhi_list_t *bodhi_list_msort(bodhi_list_t *list, bodhi_list_cmp_fn fn);
+/*
+ * merge_k relinks the nodes of k sorted lists into one sorted list, using
+ * O(n log k) compares; the lists are consumed. merge_new streams the same
+ * order without changing the lists: merge_next returns their nodes one at
+ * a time and NULL once all are done. Both are stable, equal elements
+ * coming out in the order of the lists they are in.
+ */
+bodhi_list_t *bodhi_list_merge_k(bodhi_list_t **lists, size_t k, bodhi_list_cmp_fn fn);
+bodhi_list_merge_t *bodhi_list_merge_new(bodhi_list_t **lists, size_t k, bodhi_list_cmp_fn fn);
+bodhi_list_t *bodhi_list_merge_next(bodhi_list_merge_t *merge);
+void bodhi_list_merge_free(bodhi_list_merge_t *merge);
+/*
+ * Stable radix sorts by an unsigned key taken from each element once, the
+ * list by relinking its nodes and the array (e.g. from
+ * bodhi_list_to_array) in place. nthreads above 1 splits the work for
+ * large inputs. The array sort returns -1 if memory runs out; the list
+ * sort then falls back to passes that need none.
+ */
+bodhi_list_t *bodhi_list_rsort(bodhi_list_t *list, bodhi_list_key_fn fn, int nthreads);
+int bodhi_array_rsort(void **items, size_t n, bodhi_list_key_fn fn, int nthreads);
 bodhi_list_t *bodhi_list_remove_item(bodhi_list_t *list, bodhi_list_t *item);
 bodhi_list_t *bodhi_list_remove(bodhi_list_t *list, const void *needle, bodhi_list_cmp_fn fn, void **data);
 bodhi_list_t *bodhi_list_remove_dupes(const bodhi_list_t *list);
@@ -58,6 +96,9 @@ size_t bodhi_list_count(bodhi_list_t *list);
 void *bodhi_list_find(const bodhi_list_t *list, const void *needle, bodhi_list_cmp_fn fn);
 void **bodhi_list_to_array(bodhi_list_t *list, size_t size);
 
+void bodhi_list_stats(bodhi_list_stats_t *stats);
+void bodhi_list_stats_reset(void);
+
 #ifdef __cplusplus
 }
 #endif
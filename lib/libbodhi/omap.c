@@ -0,0 +1,341 @@
+/*
+ * omap.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "list.h"
+#include "omap.h"
+#include "util.h"
+
+/* index slots that point at no entry */
+#define EMPTY (-1)
+#define DUMMY (-2)
+
+#define MIN_INDEX 8
+/* entries the index may point at before it grows, two thirds of its slots */
+#define USABLE(n) ((n) * 2 / 3)
+
+/* kv is what bodhi_omap_get_keyvals hands out */
+typedef struct _bodhi_omap_entry_t {
+    size_t h;
+    bodhi_hmap_keyval_t kv;
+} bodhi_omap_entry_t;
+
+struct _bodhi_omap_t {
+    bodhi_hash_fn hash_fn;
+    bodhi_hmap_cmp_fn cmp_fn;
+    bodhi_hmap_free_fn key_free_fn;
+    bodhi_hmap_free_fn val_free_fn;
+
+    /*
+     * entries[0..used) in insertion order, a deleted one keeping its
+     * place with a NULL key until the next rebuild squeezes it out
+     */
+    bodhi_omap_entry_t *entries;
+    size_t used;
+    size_t size;
+    size_t cap;
+
+    /* index_size slots of width bytes each, as narrow as the entry count allows */
+    void *index;
+    size_t index_size;
+    int width;
+};
+
+static int64_t _bodhi_omap_slot(bodhi_omap_t *omap, size_t i) {
+    switch (omap->width) {
+    case 1:
+        return ((int8_t *) omap->index)[i];
+    case 2:
+        return ((int16_t *) omap->index)[i];
+    case 4:
+        return ((int32_t *) omap->index)[i];
+    default:
+        return ((int64_t *) omap->index)[i];
+    }
+}
+
+static void _bodhi_omap_set_slot(bodhi_omap_t *omap, size_t i, int64_t ix) {
+    switch (omap->width) {
+    case 1:
+        ((int8_t *) omap->index)[i] = (int8_t) ix;
+        break;
+    case 2:
+        ((int16_t *) omap->index)[i] = (int16_t) ix;
+        break;
+    case 4:
+        ((int32_t *) omap->index)[i] = (int32_t) ix;
+        break;
+    default:
+        ((int64_t *) omap->index)[i] = ix;
+        break;
+    }
+}
+
+/*
+ * Probes the way CPython does, folding in more of the hash at every step
+ * so keys that share their low bits split up quickly. Returns the slot
+ * holding key, or with key NULL the first empty one for hash.
+ */
+static size_t _bodhi_omap_probe(bodhi_omap_t *omap, void *key, size_t hash) {
+    size_t mask = omap->index_size - 1;
+    size_t perturb = hash;
+    size_t i = hash & mask;
+    int64_t ix;
+
+    for (;;) {
+        ix = _bodhi_omap_slot(omap, i);
+        if (ix == EMPTY) {
+            return i;
+        }
+
+        if (ix >= 0 && key != NULL) {
+            bodhi_omap_entry_t *e = &omap->entries[ix];
+            if (e->h == hash && omap->cmp_fn(e->kv.key, key) == 0) {
+                return i;
+            }
+        }
+
+        perturb >>= 5;
+        i = (i * 5 + perturb + 1) & mask;
+    }
+}
+
+/* rebuilds the index with room for at least need entries, dropping deleted ones */
+static int _bodhi_omap_rebuild(bodhi_omap_t *omap, size_t need) {
+    bodhi_omap_entry_t *entries;
+    size_t index_size = MIN_INDEX;
+    size_t i, j;
+    void *index;
+    int width;
+
+    while (USABLE(index_size) < need) {
+        index_size *= 2;
+    }
+    width = index_size <= 128 ? 1 : index_size <= 0x8000 ? 2 : index_size <= 0x80000000u ? 4 : 8;
+
+    /* nothing changes until both allocations are in */
+    MALLOC(index, index_size * (size_t) width, return -1);
+    if (USABLE(index_size) > omap->cap) {
+        entries = realloc(omap->entries, USABLE(index_size) * sizeof(bodhi_omap_entry_t));
+        if (entries == NULL) {
+            free(index);
+            return -1;
+        }
+        omap->entries = entries;
+        omap->cap = USABLE(index_size);
+    }
+
+    for (i = 0, j = 0; i < omap->used; i++) {
+        if (omap->entries[i].kv.key != NULL) {
+            omap->entries[j++] = omap->entries[i];
+        }
+    }
+    omap->used = j;
+
+    /* all bits set is EMPTY at every width */
+    memset(index, 0xFF, index_size * (size_t) width);
+    free(omap->index);
+    omap->index = index;
+    omap->index_size = index_size;
+    omap->width = width;
+
+    for (i = 0; i < omap->used; i++) {
+        _bodhi_omap_set_slot(omap, _bodhi_omap_probe(omap, NULL, omap->entries[i].h), (int64_t) i);
+    }
+
+    return 0;
+}
+
+bodhi_omap_t *bodhi_omap_new(bodhi_hash_fn hash_fn, bodhi_hmap_cmp_fn cmp_fn,
+                             bodhi_hmap_free_fn key_free_fn, bodhi_hmap_free_fn val_free_fn) {
+    bodhi_omap_t *ret;
+
+    ASSERT(hash_fn != NULL && cmp_fn != NULL, return NULL);
+
+    CALLOC(ret, 1, sizeof(bodhi_omap_t), return NULL);
+    ret->hash_fn = hash_fn;
+    ret->cmp_fn = cmp_fn;
+    ret->key_free_fn = key_free_fn;
+    ret->val_free_fn = val_free_fn;
+
+    if (_bodhi_omap_rebuild(ret, 0) != 0) {
+        free(ret);
+        return NULL;
+    }
+
+    return ret;
+}
+
+static void _bodhi_omap_entry_free(bodhi_omap_t *omap, bodhi_omap_entry_t *e) {
+    if (e->kv.key != NULL && omap->key_free_fn != NULL) {
+        omap->key_free_fn(e->kv.key);
+    }
+
+    if (e->kv.val != NULL && omap->val_free_fn != NULL) {
+        omap->val_free_fn(e->kv.val);
+    }
+}
+
+void bodhi_omap_free(bodhi_omap_t *omap) {
+    size_t i;
+
+    ASSERT(omap != NULL, return);
+
+    for (i = 0; i < omap->used; i++) {
+        _bodhi_omap_entry_free(omap, &omap->entries[i]);
+    }
+
+    free(omap->entries);
+    free(omap->index);
+    free(omap);
+}
+
+int bodhi_omap_insert(bodhi_omap_t *omap, void *key, void *val) {
+    bodhi_omap_entry_t *e;
+    size_t hash, slot;
+
+    ASSERT(omap != NULL, return -1);
+    ASSERT(key != NULL, return -1);
+
+    hash = omap->hash_fn(key);
+    slot = _bodhi_omap_probe(omap, key, hash);
+    if (_bodhi_omap_slot(omap, slot) != EMPTY) {
+        return 1;
+    }
+
+    if (omap->used == USABLE(omap->index_size)) {
+        /*
+         * double if live entries fill half the array, otherwise squeezing
+         * out the deleted ones is enough; size * 2 never asks for more than
+         * USABLE of twice the index, so it grows by exactly one step
+         */
+        if (_bodhi_omap_rebuild(omap, omap->size * 2) != 0) {
+            return -1;
+        }
+        slot = _bodhi_omap_probe(omap, NULL, hash);
+    }
+
+    e = &omap->entries[omap->used];
+    e->h = hash;
+    e->kv.key = key;
+    e->kv.val = val;
+    _bodhi_omap_set_slot(omap, slot, (int64_t) omap->used);
+    omap->used++;
+    omap->size++;
+
+    return 0;
+}
+
+int bodhi_omap_delete(bodhi_omap_t *omap, void *key) {
+    bodhi_omap_entry_t *e;
+    size_t slot;
+    int64_t ix;
+
+    ASSERT(omap != NULL, return -1);
+    ASSERT(key != NULL, return -1);
+
+    slot = _bodhi_omap_probe(omap, key, omap->hash_fn(key));
+    ix = _bodhi_omap_slot(omap, slot);
+    if (ix == EMPTY) {
+        return 1;
+    }
+
+    /* the slot stays taken so later keys in the same probe chain are still found */
+    _bodhi_omap_set_slot(omap, slot, DUMMY);
+    e = &omap->entries[ix];
+    _bodhi_omap_entry_free(omap, e);
+    e->kv.key = NULL;
+    e->kv.val = NULL;
+    omap->size--;
+
+    return 0;
+}
+
+void *bodhi_omap_value(bodhi_omap_t *omap, void *key) {
+    int64_t ix;
+
+    ASSERT(omap != NULL, return NULL);
+    ASSERT(key != NULL, return NULL);
+
+    ix = _bodhi_omap_slot(omap, _bodhi_omap_probe(omap, key, omap->hash_fn(key)));
+    return ix >= 0 ? omap->entries[ix].kv.val : NULL;
+}
+
+size_t bodhi_omap_size(bodhi_omap_t *omap) {
+    ASSERT(omap != NULL, return 0);
+    return omap->size;
+}
+
+size_t bodhi_omap_memory(bodhi_omap_t *omap) {
+    ASSERT(omap != NULL, return 0);
+    return sizeof(bodhi_omap_t) + omap->index_size * (size_t) omap->width +
+           omap->cap * sizeof(bodhi_omap_entry_t);
+}
+
+size_t bodhi_omap_loop(bodhi_omap_t *omap, bodhi_omap_cb cb, void *udata) {
+    size_t i, n = 0;
+
+    ASSERT(omap != NULL, return 0);
+    ASSERT(cb != NULL, return 0);
+
+    for (i = 0; i < omap->used; i++) {
+        bodhi_omap_entry_t *e = &omap->entries[i];
+
+        if (e->kv.key == NULL) {
+            continue;
+        }
+        n++;
+        if (cb(e->kv.key, e->kv.val, udata) != 0) {
+            break;
+        }
+    }
+
+    return n;
+}
+
+bodhi_list_t *bodhi_omap_get_keys(bodhi_omap_t *omap) {
+    bodhi_list_t *ret = NULL;
+    size_t i;
+
+    ASSERT(omap != NULL, return NULL);
+
+    for (i = 0; i < omap->used; i++) {
+        if (omap->entries[i].kv.key != NULL) {
+            ret = bodhi_list_add(ret, omap->entries[i].kv.key);
+        }
+    }
+
+    return ret;
+}
+
+bodhi_list_t *bodhi_omap_get_keyvals(bodhi_omap_t *omap) {
+    bodhi_list_t *ret = NULL;
+    size_t i;
+
+    ASSERT(omap != NULL, return NULL);
+
+    for (i = 0; i < omap->used; i++) {
+        if (omap->entries[i].kv.key != NULL) {
+            ret = bodhi_list_add(ret, &omap->entries[i].kv);
+        }
+    }
+
+    return ret;
+}
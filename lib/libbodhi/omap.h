@@ -0,0 +1,64 @@
+/*
+ * omap.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BODHI_OMAP_H
+#define BODHI_OMAP_H
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include <libbodhi/hmap.h>
+#include <libbodhi/list.h>
+
+/*
+ * A hash map that remembers insertion order, laid out like CPython's
+ * dict: the entries sit in one dense array in the order they were added
+ * and the hash table is a sparse array of small integers indexing it.
+ * Scans read the entry array front to back, and growing only rebuilds
+ * the index. It takes the same callbacks as bodhi_hmap_t.
+ */
+typedef struct _bodhi_omap_t bodhi_omap_t;
+
+/* called with each entry in insertion order, non-zero stops the walk */
+typedef int (*bodhi_omap_cb)(void *key, void *val, void *udata);
+
+bodhi_omap_t *bodhi_omap_new(bodhi_hash_fn hash_fn, bodhi_hmap_cmp_fn cmp_fn,
+    bodhi_hmap_free_fn key_free_fn, bodhi_hmap_free_fn val_free_fn);
+void bodhi_omap_free(bodhi_omap_t *omap);
+
+/*
+ * insert returns 0, 1 if the key is already there or -1 if memory ran
+ * out; delete returns 0 if the key was removed and 1 if it was not
+ * there. Re-inserting a deleted key puts it at the end.
+ */
+int bodhi_omap_insert(bodhi_omap_t *omap, void *key, void *val);
+int bodhi_omap_delete(bodhi_omap_t *omap, void *key);
+void *bodhi_omap_value(bodhi_omap_t *omap, void *key);
+size_t bodhi_omap_size(bodhi_omap_t *omap);
+/* bytes allocated for the map, keys and values not included */
+size_t bodhi_omap_memory(bodhi_omap_t *omap);
+
+/*
+ * All in insertion order. The keyvals point into the map and are only
+ * good until it next changes.
+ */
+size_t bodhi_omap_loop(bodhi_omap_t *omap, bodhi_omap_cb cb, void *udata);
+bodhi_list_t *bodhi_omap_get_keys(bodhi_omap_t *omap);
+bodhi_list_t *bodhi_omap_get_keyvals(bodhi_omap_t *omap);
+
+#endif
@@ -20,21 +20,111 @@
 #define BODHI_PATRICIA_H
 
 #include <inttypes.h>
+#include <stdlib.h>
 
 typedef struct _bodhi_patricia_t bodhi_patricia_t;
 
 typedef void (trie_free_fn)(void*);
 typedef void (trie_loop_cb)(bodhi_patricia_t*, void*);
+/* parallel scans: a node, its thread's accumulator and udata, then folding an accumulator into the result */
+typedef void (trie_each_cb)(bodhi_patricia_t*, void*, void*);
+typedef void (trie_reduce_fn)(void*, void*, void*);
+typedef int (trie_range_cb)(bodhi_patricia_t*, void*);
+/* given the values a key has in both tries, returns the one to keep */
+typedef void *(trie_merge_fn)(void*, void*, void*);
+
+/*
+ * Filled in by bodhi_patricia_stats and the wider versions. The shape is
+ * measured on every call; allocs and frees count nodes of every trie with
+ * the same key width and are only kept when the library is built with
+ * BODHI_STATS, which counters tells.
+ */
+typedef struct _bodhi_patricia_stats_t {
+    int counters;
+    size_t size;
+    size_t nodes;
+    size_t branches;
+    size_t max_depth;
+    double avg_depth;
+    size_t memory;
+    uint64_t allocs;
+    uint64_t frees;
+} bodhi_patricia_stats_t;
+
+/* walks the keys in [lo, hi] in order, see bodhi_patricia_cursor_init */
+typedef struct _bodhi_patricia_cursor_t {
+    bodhi_patricia_t *stack[33];
+    int depth;
+    uint32_t hi;
+} bodhi_patricia_cursor_t;
 
 void bodhi_patricia_free(bodhi_patricia_t *trie, trie_free_fn fn);
+/*
+ * Teardown without one long pause. free_detached hands the trie to the
+ * reaper thread (see reaper.h). free_step does at most max units of work
+ * per call, each freeing or rotating one node, and returns 1 while nodes
+ * are left, updating *trie to what remains; nothing else may use the trie
+ * once it has started.
+ */
+void bodhi_patricia_free_detached(bodhi_patricia_t *trie, trie_free_fn fn);
+int bodhi_patricia_free_step(bodhi_patricia_t **trie, trie_free_fn fn, size_t max);
 bodhi_patricia_t *bodhi_patricia_new_blank();
 bodhi_patricia_t *bodhi_patricia_new(uint32_t init_key, void *data);
+/*
+ * builds a trie from strictly ascending keys in one pass, values may be NULL;
+ * the parallel version splits the keys by their top bits across nthreads
+ */
+bodhi_patricia_t *bodhi_patricia_build_sorted(const uint32_t *keys, void **values, size_t n);
+bodhi_patricia_t *bodhi_patricia_build_sorted_parallel(const uint32_t *keys, void **values, size_t n, int nthreads);
+
 int bodhi_patricia_add(bodhi_patricia_t **trie, uint32_t key, void *data);
 int bodhi_patricia_remove(bodhi_patricia_t **trie, uint32_t key, void **retval);
 void *bodhi_patricia_find_val(bodhi_patricia_t *trie, uint32_t key);
+/* looks up n keys at once, writing each value (or NULL) to out; returns the hits */
+size_t bodhi_patricia_find_val_batch(bodhi_patricia_t *trie, const uint32_t *keys, size_t n, void **out);
 size_t bodhi_patricia_size(bodhi_patricia_t *trie);
+/* visits every set node in ascending key order */
 void bodhi_patricia_loop(bodhi_patricia_t *trie, trie_loop_cb cb, void *udata);
+/*
+ * calls cb on every set node from nthreads threads, which take turns at
+ * the subtrees under the top few key bits, in no particular order. Every
+ * thread has its own zeroed accumulator of acc_size bytes (none if 0);
+ * afterwards reduce, if not NULL, folds them into result one by one. The
+ * trie must not change meanwhile. Returns -1 if memory ran out before any
+ * node was visited, 0 otherwise.
+ */
+int bodhi_patricia_parallel_foreach(bodhi_patricia_t *trie, int nthreads, trie_each_cb cb, size_t acc_size,
+                                    trie_reduce_fn reduce, void *result, void *udata);
+
+/*
+ * successor and predecessor return the node with the smallest key >= key and
+ * the largest key <= key. min, max and both of those return NULL if there is
+ * no such node. range and cursors visit the nodes in [lo, hi] in ascending
+ * order, a range callback returning non-zero stops the walk.
+ */
+bodhi_patricia_t *bodhi_patricia_min(bodhi_patricia_t *trie);
+bodhi_patricia_t *bodhi_patricia_max(bodhi_patricia_t *trie);
+bodhi_patricia_t *bodhi_patricia_successor(bodhi_patricia_t *trie, uint32_t key);
+bodhi_patricia_t *bodhi_patricia_predecessor(bodhi_patricia_t *trie, uint32_t key);
+size_t bodhi_patricia_range(bodhi_patricia_t *trie, uint32_t lo, uint32_t hi, trie_range_cb cb, void *udata);
+void bodhi_patricia_cursor_init(bodhi_patricia_cursor_t *cursor, bodhi_patricia_t *trie, uint32_t lo, uint32_t hi);
+bodhi_patricia_t *bodhi_patricia_cursor_next(bodhi_patricia_cursor_t *cursor);
+
+/*
+ * set operations consume both tries and return the result, reusing their
+ * nodes. Values of keys that are dropped are freed with fn. Keys in both
+ * tries get merge(a value, b value, udata), or keep a's value (b's is
+ * freed) when merge is NULL. union returns NULL if memory runs out.
+ */
+bodhi_patricia_t *bodhi_patricia_union(bodhi_patricia_t *a, bodhi_patricia_t *b, trie_merge_fn merge, trie_free_fn fn, void *udata);
+bodhi_patricia_t *bodhi_patricia_intersect(bodhi_patricia_t *a, bodhi_patricia_t *b, trie_merge_fn merge, trie_free_fn fn, void *udata);
+bodhi_patricia_t *bodhi_patricia_difference(bodhi_patricia_t *a, bodhi_patricia_t *b, trie_free_fn fn);
+int bodhi_patricia_stats(bodhi_patricia_t *trie, bodhi_patricia_stats_t *stats);
+
 uint32_t bodhi_patricia_get_key(bodhi_patricia_t *node);
 int bodhi_patricia_get_pos(bodhi_patricia_t *node);
+void *bodhi_patricia_get_data(bodhi_patricia_t *node);
+bodhi_patricia_t *bodhi_patricia_get_left(bodhi_patricia_t *node);
+bodhi_patricia_t *bodhi_patricia_get_right(bodhi_patricia_t *node);
 
 #endif
@@ -0,0 +1,88 @@
+/*
+ * patricia128.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "patricia128.h"
+#include "pool.h"
+#include "reaper.h"
+#include "util.h"
+
+static int _key_eq(bodhi_uint128_t a, bodhi_uint128_t b) {
+    return a.hi == b.hi && a.lo == b.lo;
+}
+
+static int _key_cmp(bodhi_uint128_t a, bodhi_uint128_t b) {
+    if (a.hi != b.hi) {
+        return a.hi < b.hi ? -1 : 1;
+    }
+
+    return a.lo < b.lo ? -1 : a.lo > b.lo;
+}
+
+static int _key_bit(bodhi_uint128_t k, int i) {
+    if (i < 64) {
+        return (int) ((k.hi >> (63 - i)) & 1);
+    } else {
+        return (int) ((k.lo >> (127 - i)) & 1);
+    }
+}
+
+static bodhi_uint128_t _key_prefix(bodhi_uint128_t k, int n) {
+    if (n == 0) {
+        k.hi = 0;
+        k.lo = 0;
+    } else if (n < 64) {
+        k.hi &= ~(uint64_t) 0 << (64 - n);
+        k.lo = 0;
+    } else if (n == 64) {
+        k.lo = 0;
+    } else if (n < 128) {
+        k.lo &= ~(uint64_t) 0 << (128 - n);
+    }
+
+    return k;
+}
+
+static unsigned int _key_shared(bodhi_uint128_t a, bodhi_uint128_t b) {
+    if (a.hi != b.hi) {
+        return CLZ64(a.hi ^ b.hi);
+    }
+
+    return 64 + CLZ64(a.lo ^ b.lo);
+}
+
+#define PT_PREFIX bodhi_patricia128
+#define PT_T bodhi_patricia128_t
+#define PT_STRUCT _bodhi_patricia128_t
+#define PT_LOOP_CB trie128_loop_cb
+#define PT_EACH_CB trie128_each_cb
+#define PT_RANGE_CB trie128_range_cb
+#define PT_CURSOR_T bodhi_patricia128_cursor_t
+#define PT_KEY_T bodhi_uint128_t
+#define PT_BITS 128
+
+#define PT_KEY_EQ(a, b) _key_eq(a, b)
+#define PT_KEY_CMP(a, b) _key_cmp(a, b)
+#define PT_KEY_BIT(k, i) _key_bit(k, i)
+#define PT_KEY_PREFIX(k, n) _key_prefix(k, n)
+#define PT_KEY_SHARED(a, b) _key_shared(a, b)
+
+#include "patricia_impl.h"
@@ -0,0 +1,97 @@
+/*
+ * patricia128.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BODHI_PATRICIA128_H
+#define BODHI_PATRICIA128_H
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include <libbodhi/patricia.h>
+
+/* a 128 bit key (e.g. an IPv6 address), hi holds the most significant bits */
+typedef struct _bodhi_uint128_t {
+    uint64_t hi;
+    uint64_t lo;
+} bodhi_uint128_t;
+
+/* the same trie as bodhi_patricia_t, keyed by 128 bit integers */
+typedef struct _bodhi_patricia128_t bodhi_patricia128_t;
+
+typedef void (trie128_loop_cb)(bodhi_patricia128_t*, void*);
+typedef void (trie128_each_cb)(bodhi_patricia128_t*, void*, void*);
+typedef int (trie128_range_cb)(bodhi_patricia128_t*, void*);
+
+/* walks the keys in [lo, hi] in order, see bodhi_patricia128_cursor_init */
+typedef struct _bodhi_patricia128_cursor_t {
+    bodhi_patricia128_t *stack[129];
+    int depth;
+    bodhi_uint128_t hi;
+} bodhi_patricia128_cursor_t;
+
+void bodhi_patricia128_free(bodhi_patricia128_t *trie, trie_free_fn fn);
+/* see bodhi_patricia_free_detached */
+void bodhi_patricia128_free_detached(bodhi_patricia128_t *trie, trie_free_fn fn);
+int bodhi_patricia128_free_step(bodhi_patricia128_t **trie, trie_free_fn fn, size_t max);
+bodhi_patricia128_t *bodhi_patricia128_new_blank(void);
+bodhi_patricia128_t *bodhi_patricia128_new(bodhi_uint128_t init_key, void *data);
+/*
+ * builds a trie from strictly ascending keys in one pass, values may be NULL;
+ * the parallel version splits the keys by their top bits across nthreads
+ */
+bodhi_patricia128_t *bodhi_patricia128_build_sorted(const bodhi_uint128_t *keys, void **values, size_t n);
+bodhi_patricia128_t *bodhi_patricia128_build_sorted_parallel(const bodhi_uint128_t *keys, void **values, size_t n, int nthreads);
+
+int bodhi_patricia128_add(bodhi_patricia128_t **trie, bodhi_uint128_t key, void *data);
+int bodhi_patricia128_remove(bodhi_patricia128_t **trie, bodhi_uint128_t key, void **retval);
+void *bodhi_patricia128_find_val(bodhi_patricia128_t *trie, bodhi_uint128_t key);
+size_t bodhi_patricia128_find_val_batch(bodhi_patricia128_t *trie, const bodhi_uint128_t *keys, size_t n, void **out);
+size_t bodhi_patricia128_size(bodhi_patricia128_t *trie);
+/* visits every set node in ascending key order */
+void bodhi_patricia128_loop(bodhi_patricia128_t *trie, trie128_loop_cb cb, void *udata);
+/* see bodhi_patricia_parallel_foreach */
+int bodhi_patricia128_parallel_foreach(bodhi_patricia128_t *trie, int nthreads, trie128_each_cb cb, size_t acc_size,
+                                       trie_reduce_fn reduce, void *result, void *udata);
+
+/*
+ * successor and predecessor return the node with the smallest key >= key and
+ * the largest key <= key. min, max and both of those return NULL if there is
+ * no such node. range and cursors visit the nodes in [lo, hi] in ascending
+ * order, a range callback returning non-zero stops the walk.
+ */
+bodhi_patricia128_t *bodhi_patricia128_min(bodhi_patricia128_t *trie);
+bodhi_patricia128_t *bodhi_patricia128_max(bodhi_patricia128_t *trie);
+bodhi_patricia128_t *bodhi_patricia128_successor(bodhi_patricia128_t *trie, bodhi_uint128_t key);
+bodhi_patricia128_t *bodhi_patricia128_predecessor(bodhi_patricia128_t *trie, bodhi_uint128_t key);
+size_t bodhi_patricia128_range(bodhi_patricia128_t *trie, bodhi_uint128_t lo, bodhi_uint128_t hi, trie128_range_cb cb, void *udata);
+void bodhi_patricia128_cursor_init(bodhi_patricia128_cursor_t *cursor, bodhi_patricia128_t *trie, bodhi_uint128_t lo, bodhi_uint128_t hi);
+bodhi_patricia128_t *bodhi_patricia128_cursor_next(bodhi_patricia128_cursor_t *cursor);
+
+/* set operations, see bodhi_patricia_union */
+bodhi_patricia128_t *bodhi_patricia128_union(bodhi_patricia128_t *a, bodhi_patricia128_t *b, trie_merge_fn merge, trie_free_fn fn, void *udata);
+bodhi_patricia128_t *bodhi_patricia128_intersect(bodhi_patricia128_t *a, bodhi_patricia128_t *b, trie_merge_fn merge, trie_free_fn fn, void *udata);
+bodhi_patricia128_t *bodhi_patricia128_difference(bodhi_patricia128_t *a, bodhi_patricia128_t *b, trie_free_fn fn);
+int bodhi_patricia128_stats(bodhi_patricia128_t *trie, bodhi_patricia_stats_t *stats);
+
+bodhi_uint128_t bodhi_patricia128_get_key(bodhi_patricia128_t *node);
+int bodhi_patricia128_get_pos(bodhi_patricia128_t *node);
+void *bodhi_patricia128_get_data(bodhi_patricia128_t *node);
+bodhi_patricia128_t *bodhi_patricia128_get_left(bodhi_patricia128_t *node);
+bodhi_patricia128_t *bodhi_patricia128_get_right(bodhi_patricia128_t *node);
+
+#endif
@@ -0,0 +1,44 @@
+/*
+ * patricia64.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "patricia64.h"
+#include "pool.h"
+#include "reaper.h"
+#include "util.h"
+
+#define PT_PREFIX bodhi_patricia64
+#define PT_T bodhi_patricia64_t
+#define PT_STRUCT _bodhi_patricia64_t
+#define PT_LOOP_CB trie64_loop_cb
+#define PT_EACH_CB trie64_each_cb
+#define PT_RANGE_CB trie64_range_cb
+#define PT_CURSOR_T bodhi_patricia64_cursor_t
+#define PT_KEY_T uint64_t
+#define PT_BITS 64
+
+#define PT_KEY_EQ(a, b) ((a) == (b))
+#define PT_KEY_CMP(a, b) ((a) < (b) ? -1 : (a) > (b))
+#define PT_KEY_BIT(k, i) ((int) (((k) >> (63 - (i))) & 1))
+#define PT_KEY_PREFIX(k, n) ((n) == 0 ? 0 : (k) & (~(uint64_t) 0 << (64 - (n))))
+#define PT_KEY_SHARED(a, b) CLZ64((a) ^ (b))
+
+#include "patricia_impl.h"
@@ -0,0 +1,1181 @@
+/*
+ * patricia_impl.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * The patricia trie itself, written once for every key width. This file is
+ * not a header in the usual sense: it is included by patricia.c,
+ * patricia64.c and patricia128.c after they define the following.
+ *
+ *   PT_PREFIX           function prefix, e.g. bodhi_patricia64
+ *   PT_T, PT_STRUCT     the public typedef and its struct tag
+ *   PT_LOOP_CB          the loop callback type
+ *   PT_EACH_CB          the parallel foreach callback type
+ *   PT_RANGE_CB         the range callback type
+ *   PT_CURSOR_T         the cursor type, holding a stack of PT_BITS + 1 nodes
+ *   PT_KEY_T, PT_BITS   the key type and its width
+ *   PT_KEY_EQ(a, b)     non-zero when two keys are equal
+ *   PT_KEY_CMP(a, b)    -1, 0 or 1 as a is less than, equal to or above b
+ *   PT_KEY_BIT(k, i)    bit i of k counting from the most significant bit
+ *   PT_KEY_PREFIX(k, n) k with everything but the top n bits cleared
+ *   PT_KEY_SHARED(a, b) number of leading bits a and b have in common
+ */
+
+#define PT_CAT_(a, b) a##b
+#define PT_CAT(a, b) PT_CAT_(a, b)
+#define PT_FN(name) PT_CAT(PT_PREFIX, name)
+
+struct PT_STRUCT {
+    struct PT_STRUCT *left;
+    struct PT_STRUCT *right;
+    struct PT_STRUCT *parent;
+
+    PT_KEY_T key;
+    int isset;
+    int pos;
+    void *data;
+};
+
+/* allocations and frees of every trie of this key width, see _stats */
+#ifdef BODHI_STATS
+static bodhi_stat_counter_t PT_FN(_stat_allocs);
+static bodhi_stat_counter_t PT_FN(_stat_frees);
+#endif
+
+static PT_T *PT_FN(_alloc)(void) {
+    PT_T *ret = calloc(1, sizeof(PT_T));
+    STATS(if (ret != NULL) { STAT_ADD(PT_FN(_stat_allocs), 1); });
+    return ret;
+}
+
+static void PT_FN(_dealloc)(PT_T *node) {
+    STATS(if (node != NULL) { STAT_ADD(PT_FN(_stat_frees), 1); });
+    free(node);
+}
+
+PT_T *PT_FN(_new_blank)(void) {
+    return PT_FN(_alloc)();
+}
+
+PT_T *PT_FN(_new)(PT_KEY_T init_key, void *data) {
+    PT_T *ret = PT_FN(_alloc)();
+    if (ret == NULL) {
+        return NULL;
+    }
+
+    ret->key = init_key;
+    ret->data = data;
+    ret->pos = PT_BITS;
+    ret->isset = 1;
+
+    return ret;
+}
+
+int PT_FN(_add)(PT_T **trie_ptr, PT_KEY_T key, void *data) {
+    PT_T *trie = *trie_ptr;
+    int shared_bits;
+
+    if (trie == NULL) {
+        return 0;
+    }
+
+    /* is a duplicate record trying to be set? */
+    if (trie->isset && PT_KEY_EQ(trie->key, key)) {
+        /* perhaps log why this failed? */
+        return 0;
+    }
+
+    shared_bits = (int) PT_KEY_SHARED(key, trie->key);
+
+    if (trie->pos > shared_bits) {
+        PT_T *new = PT_FN(_new)(key, data);
+        PT_T *new_parent = PT_FN(_alloc)();
+
+        if (new == NULL || new_parent == NULL) {
+            PT_FN(_dealloc)(new);
+            PT_FN(_dealloc)(new_parent);
+            return 0;
+        }
+
+        new_parent->pos = shared_bits;
+        new_parent->key = PT_KEY_PREFIX(key, shared_bits);
+        new->parent = new_parent;
+
+        /* the first bit that differs decides which side the old node goes */
+        if (PT_KEY_BIT(trie->key, shared_bits)) {
+            new_parent->right = trie;
+            new_parent->left = new;
+        } else {
+            new_parent->right = new;
+            new_parent->left = trie;
+        }
+
+        new_parent->parent = trie->parent;
+        trie->parent = new_parent;
+
+        if (new_parent->parent == NULL) {
+            *trie_ptr = new_parent;
+        } else {
+            if (new_parent->parent->left == trie) {
+                new_parent->parent->left = new_parent;
+            } else {
+                new_parent->parent->right = new_parent;
+            }
+        }
+    } else {
+        /* check for children */
+        if (trie->left != NULL) {
+            if (PT_KEY_BIT(key, trie->pos) == 0) {
+                return PT_FN(_add)(&trie->left, key, data);
+            } else {
+                return PT_FN(_add)(&trie->right, key, data);
+            }
+        } else {
+            /* this happens when blank */
+            trie->key = key;
+            trie->pos = PT_BITS;
+            trie->data = data;
+            trie->isset = 1;
+        }
+    }
+
+    return 1;
+}
+
+int PT_FN(_remove)(PT_T **trie_ptr, PT_KEY_T key, void **retval) {
+    PT_T *trie = *trie_ptr;
+    PT_T *sister;
+    PT_T *grand;
+
+    while (trie != NULL && !trie->isset) {
+        trie = PT_KEY_BIT(key, trie->pos) ? trie->right : trie->left;
+    }
+
+    if (trie == NULL || !PT_KEY_EQ(trie->key, key)) {
+        return 0;
+    }
+
+    if (retval != NULL) {
+        *retval = trie->data;
+    }
+
+    if (trie->parent == NULL) {
+        /* special case: we are removing a root node */
+        *trie_ptr = NULL;
+        PT_FN(_dealloc)(trie);
+        return 1;
+    }
+
+    /* the sister takes the place of the parent */
+    if (trie->parent->left == trie) {
+        sister = trie->parent->right;
+    } else {
+        sister = trie->parent->left;
+    }
+
+    grand = trie->parent->parent;
+    sister->parent = grand;
+
+    if (grand == NULL) {
+        *trie_ptr = sister;
+    } else if (grand->left == trie->parent) {
+        grand->left = sister;
+    } else {
+        grand->right = sister;
+    }
+
+    PT_FN(_dealloc)(trie->parent);
+    PT_FN(_dealloc)(trie);
+    return 1;
+}
+
+void PT_FN(_free)(PT_T *trie, trie_free_fn fn) {
+    while (1) {
+        if (trie == NULL) {
+            break;
+        } else if (trie->left != NULL) {
+            PT_FN(_free)(trie->left, fn);
+            trie->left = NULL;
+        } else if (trie->right != NULL) {
+            PT_FN(_free)(trie->right, fn);
+            trie->right = NULL;
+        } else {
+            if (trie->data != NULL && fn != NULL) {
+                fn(trie->data);
+            }
+            PT_FN(_dealloc)(trie);
+            return;
+        }
+    }
+}
+
+/*
+ * Tears the trie down without recursion by rotating left children up
+ * until the top node has none, then freeing it and moving to its right
+ * child; the node reached is all the state there is between calls.
+ */
+int PT_FN(_free_step)(PT_T **trie, trie_free_fn fn, size_t max) {
+    PT_T *node;
+    size_t work = 0;
+
+    if (trie == NULL || *trie == NULL) {
+        return 0;
+    }
+
+    node = *trie;
+    while (node != NULL && work < max) {
+        if (node->left != NULL) {
+            PT_T *left = node->left;
+
+            node->left = left->right;
+            left->right = node;
+            node = left;
+        } else {
+            PT_T *right = node->right;
+
+            if (node->data != NULL && fn != NULL) {
+                fn(node->data);
+            }
+            PT_FN(_dealloc)(node);
+            node = right;
+        }
+        work++;
+    }
+
+    *trie = node;
+    return node != NULL;
+}
+
+typedef struct {
+    PT_T *trie;
+    trie_free_fn *fn;
+} PT_FN(_reap_t);
+
+static void PT_FN(_reap)(void *arg) {
+    PT_FN(_reap_t) *job = arg;
+
+    PT_FN(_free)(job->trie, job->fn);
+    free(job);
+}
+
+void PT_FN(_free_detached)(PT_T *trie, trie_free_fn fn) {
+    PT_FN(_reap_t) *job;
+
+    if (trie == NULL) {
+        return;
+    }
+
+    MALLOC(job, sizeof(PT_FN(_reap_t)), PT_FN(_free)(trie, fn); return);
+    job->trie = trie;
+    job->fn = fn;
+    bodhi_reaper_submit(PT_FN(_reap), job);
+}
+
+void *PT_FN(_find_val)(PT_T *trie, PT_KEY_T key) {
+    while (trie != NULL) {
+        if (trie->isset) {
+            return PT_KEY_EQ(trie->key, key) ? trie->data : NULL;
+        }
+
+        trie = PT_KEY_BIT(key, trie->pos) ? trie->right : trie->left;
+    }
+
+    return NULL;
+}
+
+/*
+ * Lookups are a chain of dependent loads, so one at a time they wait on a
+ * cache miss per level. Here up to PT_BATCH lookups are advanced one level
+ * per round, prefetching the next node of each, so their misses overlap.
+ */
+#define PT_BATCH 16
+
+size_t PT_FN(_find_val_batch)(PT_T *trie, const PT_KEY_T *keys, size_t n, void **out) {
+    PT_T *cur[PT_BATCH];
+    size_t idx[PT_BATCH];
+    size_t next = 0;
+    size_t found = 0;
+    int active = 0;
+    int i;
+
+    ASSERT(keys != NULL && out != NULL, return 0);
+
+    PREFETCH(trie);
+    while (active < PT_BATCH && next < n) {
+        cur[active] = trie;
+        idx[active] = next++;
+        active++;
+    }
+
+    while (active > 0) {
+        for (i = 0; i < active; i++) {
+            PT_T *node = cur[i];
+
+            if (node != NULL && !node->isset) {
+                node = PT_KEY_BIT(keys[idx[i]], node->pos) ? node->right : node->left;
+                PREFETCH(node);
+                cur[i] = node;
+                continue;
+            }
+
+            if (node != NULL && PT_KEY_EQ(node->key, keys[idx[i]])) {
+                out[idx[i]] = node->data;
+                found++;
+            } else {
+                out[idx[i]] = NULL;
+            }
+
+            /* this lookup is done, start the next key or close the slot */
+            if (next < n) {
+                cur[i] = trie;
+                idx[i] = next++;
+            } else {
+                active--;
+                cur[i] = cur[active];
+                idx[i] = idx[active];
+                i--;
+            }
+        }
+    }
+
+    return found;
+}
+
+size_t PT_FN(_size)(PT_T *trie) {
+    if (trie == NULL) {
+        return 0;
+    } else if (trie->isset) {
+        return 1;
+    } else {
+        return PT_FN(_size)(trie->left) + PT_FN(_size)(trie->right);
+    }
+}
+
+void PT_FN(_loop)(PT_T *trie, PT_LOOP_CB cb, void *udata) {
+    ASSERT(trie != NULL, return);
+
+    if (trie->isset) {
+        cb(trie, udata);
+    } else {
+        PT_FN(_loop)(trie->left, cb, udata);
+        PT_FN(_loop)(trie->right, cb, udata);
+    }
+}
+
+/*
+ * The parallel scan cuts the trie into the subtrees below every branch on
+ * one of the top few bits, enough of them that threads taking the next
+ * one in turn keep busy even when the parts differ in size.
+ */
+typedef struct PT_CAT(PT_STRUCT, _scan) {
+    PT_T **parts;
+    size_t nparts;
+    size_t cap;
+    PT_EACH_CB *cb;
+    void *udata;
+    char *accs;
+    size_t stride;
+    size_t next;
+} PT_FN(_scan_t);
+
+static int PT_FN(_scan_split)(PT_FN(_scan_t) *scan, PT_T *trie, int bits) {
+    if (trie == NULL) {
+        return 0;
+    }
+
+    if (trie->isset || trie->pos >= bits) {
+        if (scan->nparts == scan->cap) {
+            PT_T **parts = realloc(scan->parts, (scan->cap * 2 + 16) * sizeof(PT_T *));
+
+            if (parts == NULL) {
+                return -1;
+            }
+            scan->parts = parts;
+            scan->cap = scan->cap * 2 + 16;
+        }
+        scan->parts[scan->nparts++] = trie;
+        return 0;
+    }
+
+    if (PT_FN(_scan_split)(scan, trie->left, bits) != 0) {
+        return -1;
+    }
+    return PT_FN(_scan_split)(scan, trie->right, bits);
+}
+
+static void PT_FN(_scan_walk)(PT_FN(_scan_t) *scan, PT_T *trie, void *acc) {
+    if (trie == NULL) {
+        return;
+    }
+
+    if (trie->isset) {
+        scan->cb(trie, acc, scan->udata);
+    } else {
+        PT_FN(_scan_walk)(scan, trie->left, acc);
+        PT_FN(_scan_walk)(scan, trie->right, acc);
+    }
+}
+
+static void PT_FN(_scan_part)(void *arg, int thread) {
+    PT_FN(_scan_t) *scan = arg;
+    void *acc = scan->accs != NULL ? scan->accs + (size_t) thread * scan->stride : NULL;
+    size_t p;
+
+    while ((p = ATOMIC_FETCH_ADD(&scan->next, 1)) < scan->nparts) {
+        PT_FN(_scan_walk)(scan, scan->parts[p], acc);
+    }
+}
+
+int PT_FN(_parallel_foreach)(PT_T *trie, int nthreads, PT_EACH_CB cb, size_t acc_size,
+                             trie_reduce_fn reduce, void *result, void *udata) {
+    PT_FN(_scan_t) scan;
+    int bits = 0;
+    int t;
+
+    ASSERT(trie != NULL, return -1);
+    ASSERT(cb != NULL, return -1);
+
+    if (nthreads < 1) {
+        nthreads = 1;
+    }
+    while ((1 << bits) < nthreads * 8 && bits < 16 && bits < PT_BITS) {
+        bits++;
+    }
+
+    memset(&scan, 0, sizeof(scan));
+    scan.cb = cb;
+    scan.udata = udata;
+    /* each thread's accumulator starts on its own cache line */
+    scan.stride = (acc_size + 63) & ~(size_t) 63;
+
+    if (acc_size > 0) {
+        CALLOC(scan.accs, (size_t) nthreads, scan.stride, return -1);
+    }
+    if (PT_FN(_scan_split)(&scan, trie, bits) != 0) {
+        free(scan.parts);
+        free(scan.accs);
+        return -1;
+    }
+
+    bodhi_pool_run(nthreads, PT_FN(_scan_part), &scan);
+
+    for (t = 0; reduce != NULL && scan.accs != NULL && t < nthreads; t++) {
+        reduce(result, scan.accs + (size_t) t * scan.stride, udata);
+    }
+
+    free(scan.parts);
+    free(scan.accs);
+    return 0;
+}
+
+/*
+ * Bulk loading. Between two neighbouring sorted keys sits a branch on the
+ * first bit they differ in, and the trie is the Cartesian tree of those
+ * bit positions. It is built left to right, keeping only the right spine
+ * on a stack, so every node is created once and nothing is searched.
+ */
+typedef struct PT_CAT(PT_STRUCT, _builder) {
+    PT_T *spine[PT_BITS];
+    int depth;
+    PT_T *last;
+    PT_KEY_T max;
+} PT_FN(_builder_t);
+
+static PT_T *PT_FN(_builder_root)(PT_FN(_builder_t) *b) {
+    return b->depth > 0 ? b->spine[0] : b->last;
+}
+
+/* adds a leaf or a finished subtree holding keys [min, max] on the right */
+static int PT_FN(_builder_push)(PT_FN(_builder_t) *b, PT_T *node, PT_KEY_T min, PT_KEY_T max) {
+    PT_T *child = b->last;
+    PT_T *branch;
+    int gap;
+
+    if (child == NULL) {
+        b->last = node;
+        b->max = max;
+        return 0;
+    }
+
+    if ((branch = PT_FN(_alloc)()) == NULL) {
+        return -1;
+    }
+
+    gap = (int) PT_KEY_SHARED(b->max, min);
+    while (b->depth > 0 && b->spine[b->depth - 1]->pos > gap) {
+        child = b->spine[--b->depth];
+    }
+
+    branch->pos = gap;
+    branch->key = PT_KEY_PREFIX(min, gap);
+    branch->left = child;
+    branch->right = node;
+    child->parent = branch;
+    node->parent = branch;
+
+    if (b->depth > 0) {
+        b->spine[b->depth - 1]->right = branch;
+        branch->parent = b->spine[b->depth - 1];
+    }
+
+    b->spine[b->depth++] = branch;
+    b->last = node;
+    b->max = max;
+
+    return 0;
+}
+
+static PT_T *PT_FN(_build_range)(const PT_KEY_T *keys, void **values, size_t n) {
+    PT_FN(_builder_t) b;
+    PT_T *leaf;
+    size_t i;
+
+    b.depth = 0;
+    b.last = NULL;
+
+    for (i = 0; i < n; i++) {
+        leaf = PT_FN(_new)(keys[i], values != NULL ? values[i] : NULL);
+        if (leaf == NULL || PT_FN(_builder_push)(&b, leaf, keys[i], keys[i]) != 0) {
+            PT_FN(_dealloc)(leaf);
+            PT_FN(_free)(PT_FN(_builder_root)(&b), NULL);
+            return NULL;
+        }
+    }
+
+    return PT_FN(_builder_root)(&b);
+}
+
+static int PT_FN(_sorted)(const PT_KEY_T *keys, size_t n) {
+    size_t i;
+
+    for (i = 1; i < n; i++) {
+        if (PT_KEY_CMP(keys[i - 1], keys[i]) >= 0) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+PT_T *PT_FN(_build_sorted)(const PT_KEY_T *keys, void **values, size_t n) {
+    if (n == 0) {
+        return PT_FN(_new_blank)();
+    }
+
+    ASSERT(keys != NULL && PT_FN(_sorted)(keys, n), return NULL);
+    return PT_FN(_build_range)(keys, values, n);
+}
+
+/*
+ * The parallel build cuts the keys wherever the top bits change, builds
+ * every part on its own and joins the parts with the same spine walk; every
+ * branch inside a part tests a later bit than any branch between parts.
+ */
+typedef struct PT_CAT(PT_STRUCT, _bulk) {
+    const PT_KEY_T *keys;
+    void **values;
+    size_t *bounds;
+    PT_T **roots;
+    size_t parts;
+    size_t next;
+} PT_FN(_bulk_t);
+
+static void PT_FN(_bulk_part)(void *arg, int thread) {
+    PT_FN(_bulk_t) *bulk = arg;
+    size_t p;
+
+    (void) thread;
+    while ((p = ATOMIC_FETCH_ADD(&bulk->next, 1)) < bulk->parts) {
+        size_t lo = bulk->bounds[p];
+        bulk->roots[p] = PT_FN(_build_range)(bulk->keys + lo,
+                bulk->values != NULL ? bulk->values + lo : NULL, bulk->bounds[p + 1] - lo);
+    }
+}
+
+PT_T *PT_FN(_build_sorted_parallel)(const PT_KEY_T *keys, void **values, size_t n, int nthreads) {
+    PT_FN(_bulk_t) bulk;
+    PT_FN(_builder_t) b;
+    PT_T *ret = NULL;
+    int top_bits = 2;
+    size_t i;
+
+    if (nthreads <= 1 || n < 2) {
+        return PT_FN(_build_sorted)(keys, values, n);
+    }
+
+    ASSERT(keys != NULL && PT_FN(_sorted)(keys, n), return NULL);
+
+    /* a few parts per thread so that uneven parts even out */
+    while ((1 << top_bits) < nthreads * 4 && top_bits < 16 && top_bits < PT_BITS) {
+        top_bits++;
+    }
+
+    bulk.keys = keys;
+    bulk.values = values;
+    bulk.parts = 1;
+    bulk.next = 0;
+    for (i = 1; i < n; i++) {
+        if ((int) PT_KEY_SHARED(keys[i - 1], keys[i]) < top_bits) {
+            bulk.parts++;
+        }
+    }
+
+    bulk.bounds = malloc((bulk.parts + 1) * sizeof(size_t));
+    bulk.roots = calloc(bulk.parts, sizeof(PT_T*));
+    if (bulk.bounds == NULL || bulk.roots == NULL) {
+        goto cleanup;
+    }
+
+    bulk.bounds[0] = 0;
+    bulk.bounds[bulk.parts] = n;
+    for (i = 1, bulk.parts = 1; i < n; i++) {
+        if ((int) PT_KEY_SHARED(keys[i - 1], keys[i]) < top_bits) {
+            bulk.bounds[bulk.parts++] = i;
+        }
+    }
+
+    bodhi_pool_run(nthreads, PT_FN(_bulk_part), &bulk);
+
+    b.depth = 0;
+    b.last = NULL;
+    for (i = 0; i < bulk.parts; i++) {
+        if (bulk.roots[i] == NULL
+            || PT_FN(_builder_push)(&b, bulk.roots[i], keys[bulk.bounds[i]], keys[bulk.bounds[i + 1] - 1]) != 0) {
+            break;
+        }
+    }
+
+    if (i == bulk.parts) {
+        ret = PT_FN(_builder_root)(&b);
+    } else {
+        PT_FN(_free)(PT_FN(_builder_root)(&b), NULL);
+        for (; i < bulk.parts; i++) {
+            PT_FN(_free)(bulk.roots[i], NULL);
+        }
+    }
+
+cleanup:
+    free(bulk.bounds);
+    free(bulk.roots);
+    return ret;
+}
+
+/*
+ * Ordered queries. Every key below a node shares its first pos bits, so
+ * comparing those bits against the query tells whether the whole subtree
+ * is below, above or straddling it; only straddling subtrees are entered.
+ */
+static int PT_FN(_blank)(PT_T *node) {
+    return !node->isset && node->left == NULL;
+}
+
+static int PT_FN(_prefix_cmp)(PT_T *node, PT_KEY_T key) {
+    return PT_KEY_CMP(PT_KEY_PREFIX(node->key, node->pos), PT_KEY_PREFIX(key, node->pos));
+}
+
+PT_T *PT_FN(_min)(PT_T *trie) {
+    if (trie == NULL || PT_FN(_blank)(trie)) {
+        return NULL;
+    }
+
+    while (!trie->isset) {
+        trie = trie->left;
+    }
+
+    return trie;
+}
+
+PT_T *PT_FN(_max)(PT_T *trie) {
+    if (trie == NULL || PT_FN(_blank)(trie)) {
+        return NULL;
+    }
+
+    while (!trie->isset) {
+        trie = trie->right;
+    }
+
+    return trie;
+}
+
+PT_T *PT_FN(_successor)(PT_T *trie, PT_KEY_T key) {
+    PT_T *above = NULL;
+    int c;
+
+    while (trie != NULL && !PT_FN(_blank)(trie)) {
+        c = PT_FN(_prefix_cmp)(trie, key);
+        if (c > 0) {
+            return PT_FN(_min)(trie);
+        } else if (c < 0) {
+            break;
+        } else if (trie->isset) {
+            return trie;
+        }
+
+        if (PT_KEY_BIT(key, trie->pos)) {
+            trie = trie->right;
+        } else {
+            above = trie->right;
+            trie = trie->left;
+        }
+    }
+
+    return PT_FN(_min)(above);
+}
+
+PT_T *PT_FN(_predecessor)(PT_T *trie, PT_KEY_T key) {
+    PT_T *below = NULL;
+    int c;
+
+    while (trie != NULL && !PT_FN(_blank)(trie)) {
+        c = PT_FN(_prefix_cmp)(trie, key);
+        if (c < 0) {
+            return PT_FN(_max)(trie);
+        } else if (c > 0) {
+            break;
+        } else if (trie->isset) {
+            return trie;
+        }
+
+        if (PT_KEY_BIT(key, trie->pos)) {
+            below = trie->left;
+            trie = trie->right;
+        } else {
+            trie = trie->left;
+        }
+    }
+
+    return PT_FN(_max)(below);
+}
+
+/*
+ * The cursor stack holds subtrees still to be visited, smallest on top.
+ * Seeking pushes the right sibling of every left turn taken on the way to
+ * lo, so it never holds more than one node per level.
+ */
+void PT_FN(_cursor_init)(PT_CURSOR_T *cursor, PT_T *trie, PT_KEY_T lo, PT_KEY_T hi) {
+    int c;
+
+    ASSERT(cursor != NULL, return);
+
+    cursor->depth = 0;
+    cursor->hi = hi;
+
+    while (trie != NULL && !PT_FN(_blank)(trie)) {
+        c = PT_FN(_prefix_cmp)(trie, lo);
+        if (c > 0 || (c == 0 && trie->isset)) {
+            cursor->stack[cursor->depth++] = trie;
+            break;
+        } else if (c < 0) {
+            break;
+        }
+
+        if (PT_KEY_BIT(lo, trie->pos)) {
+            trie = trie->right;
+        } else {
+            cursor->stack[cursor->depth++] = trie->right;
+            trie = trie->left;
+        }
+    }
+}
+
+PT_T *PT_FN(_cursor_next)(PT_CURSOR_T *cursor) {
+    PT_T *node;
+
+    ASSERT(cursor != NULL, return NULL);
+
+    if (cursor->depth == 0) {
+        return NULL;
+    }
+
+    node = cursor->stack[--cursor->depth];
+    while (!node->isset) {
+        cursor->stack[cursor->depth++] = node->right;
+        node = node->left;
+    }
+
+    if (PT_KEY_CMP(node->key, cursor->hi) > 0) {
+        cursor->depth = 0;
+        return NULL;
+    }
+
+    return node;
+}
+
+size_t PT_FN(_range)(PT_T *trie, PT_KEY_T lo, PT_KEY_T hi, PT_RANGE_CB cb, void *udata) {
+    PT_CURSOR_T cursor;
+    PT_T *node;
+    size_t count = 0;
+
+    PT_FN(_cursor_init)(&cursor, trie, lo, hi);
+    while ((node = PT_FN(_cursor_next)(&cursor)) != NULL) {
+        count++;
+        if (cb(node, udata) != 0) {
+            break;
+        }
+    }
+
+    return count;
+}
+
+/*
+ * Set operations. Both tries are consumed and their nodes reused. Two
+ * subtrees whose prefixes differ hold disjoint keys, so they are joined
+ * under one new branch (or dropped) without being entered; only subtrees
+ * whose prefixes nest are walked together.
+ */
+static PT_T *PT_FN(_set_root)(PT_T *node) {
+    if (node != NULL && PT_FN(_blank)(node)) {
+        PT_FN(_dealloc)(node);
+        return NULL;
+    }
+
+    return node;
+}
+
+static PT_T *PT_FN(_set_result)(PT_T *node) {
+    if (node == NULL) {
+        return PT_FN(_new_blank)();
+    }
+
+    node->parent = NULL;
+    return node;
+}
+
+static void PT_FN(_set_children)(PT_T *node, PT_T *left, PT_T *right) {
+    node->left = left;
+    node->right = right;
+
+    /* a union that ran out of memory may leave holes, see _union */
+    if (left != NULL) {
+        left->parent = node;
+    }
+    if (right != NULL) {
+        right->parent = node;
+    }
+}
+
+/* the number of leading bits the keys below both nodes must share */
+static int PT_FN(_set_common)(PT_T *a, PT_T *b) {
+    int common = (int) PT_KEY_SHARED(a->key, b->key);
+
+    if (common > a->pos) {
+        common = a->pos;
+    }
+    if (common > b->pos) {
+        common = b->pos;
+    }
+
+    return common;
+}
+
+/* hangs two disjoint subtrees under a branch on the first bit they differ in */
+static PT_T *PT_FN(_set_join)(PT_T *a, PT_T *b, int pos, trie_free_fn fn, int *err) {
+    PT_T *branch = PT_FN(_alloc)();
+
+    if (branch == NULL) {
+        PT_FN(_free)(a, fn);
+        PT_FN(_free)(b, fn);
+        *err = 1;
+        return NULL;
+    }
+
+    branch->pos = pos;
+    branch->key = PT_KEY_PREFIX(a->key, pos);
+    if (PT_KEY_BIT(a->key, pos)) {
+        PT_FN(_set_children)(branch, b, a);
+    } else {
+        PT_FN(_set_children)(branch, a, b);
+    }
+
+    return branch;
+}
+
+/* keeps what remains of a branch after one side may have emptied */
+static PT_T *PT_FN(_set_rejoin)(PT_T *node, PT_T *left, PT_T *right) {
+    if (left != NULL && right != NULL) {
+        PT_FN(_set_children)(node, left, right);
+        return node;
+    }
+
+    PT_FN(_dealloc)(node);
+    return left != NULL ? left : right;
+}
+
+static void *PT_FN(_set_merge)(PT_T *a, PT_T *b, trie_merge_fn merge, trie_free_fn fn,
+                               void *udata) {
+    if (merge != NULL) {
+        return merge(a->data, b->data, udata);
+    }
+
+    if (fn != NULL && b->data != NULL) {
+        fn(b->data);
+    }
+    return a->data;
+}
+
+static PT_T *PT_FN(_union_rec)(PT_T *a, PT_T *b, trie_merge_fn merge, trie_free_fn fn,
+                               void *udata, int *err) {
+    PT_T *sub;
+    int common;
+
+    if (a == NULL) {
+        return b;
+    } else if (b == NULL) {
+        return a;
+    }
+
+    common = PT_FN(_set_common)(a, b);
+
+    if (common < a->pos && common < b->pos) {
+        return PT_FN(_set_join)(a, b, common, fn, err);
+    } else if (a->pos == b->pos) {
+        if (a->isset) {
+            a->data = PT_FN(_set_merge)(a, b, merge, fn, udata);
+        } else {
+            PT_T *left = PT_FN(_union_rec)(a->left, b->left, merge, fn, udata, err);
+            PT_T *right = PT_FN(_union_rec)(a->right, b->right, merge, fn, udata, err);
+            PT_FN(_set_children)(a, left, right);
+        }
+        PT_FN(_dealloc)(b);
+        return a;
+    } else if (a->pos < b->pos) {
+        /* b fits under one side of a */
+        if (PT_KEY_BIT(b->key, a->pos)) {
+            sub = PT_FN(_union_rec)(a->right, b, merge, fn, udata, err);
+            PT_FN(_set_children)(a, a->left, sub);
+        } else {
+            sub = PT_FN(_union_rec)(a->left, b, merge, fn, udata, err);
+            PT_FN(_set_children)(a, sub, a->right);
+        }
+        return a;
+    } else {
+        if (PT_KEY_BIT(a->key, b->pos)) {
+            sub = PT_FN(_union_rec)(a, b->right, merge, fn, udata, err);
+            PT_FN(_set_children)(b, b->left, sub);
+        } else {
+            sub = PT_FN(_union_rec)(a, b->left, merge, fn, udata, err);
+            PT_FN(_set_children)(b, sub, b->right);
+        }
+        return b;
+    }
+}
+
+static PT_T *PT_FN(_intersect_rec)(PT_T *a, PT_T *b, trie_merge_fn merge, trie_free_fn fn,
+                                   void *udata) {
+    PT_T *inner;
+    int common;
+
+    if (a == NULL || b == NULL) {
+        PT_FN(_free)(a, fn);
+        PT_FN(_free)(b, fn);
+        return NULL;
+    }
+
+    common = PT_FN(_set_common)(a, b);
+
+    if (common < a->pos && common < b->pos) {
+        PT_FN(_free)(a, fn);
+        PT_FN(_free)(b, fn);
+        return NULL;
+    } else if (a->pos == b->pos) {
+        if (a->isset) {
+            a->data = PT_FN(_set_merge)(a, b, merge, fn, udata);
+            PT_FN(_dealloc)(b);
+            return a;
+        } else {
+            PT_T *left = PT_FN(_intersect_rec)(a->left, b->left, merge, fn, udata);
+            PT_T *right = PT_FN(_intersect_rec)(a->right, b->right, merge, fn, udata);
+            PT_FN(_dealloc)(b);
+            return PT_FN(_set_rejoin)(a, left, right);
+        }
+    } else if (a->pos < b->pos) {
+        /* only the side of a that b falls under can survive */
+        if (PT_KEY_BIT(b->key, a->pos)) {
+            PT_FN(_free)(a->left, fn);
+            inner = a->right;
+        } else {
+            PT_FN(_free)(a->right, fn);
+            inner = a->left;
+        }
+        PT_FN(_dealloc)(a);
+        return PT_FN(_intersect_rec)(inner, b, merge, fn, udata);
+    } else {
+        if (PT_KEY_BIT(a->key, b->pos)) {
+            PT_FN(_free)(b->left, fn);
+            inner = b->right;
+        } else {
+            PT_FN(_free)(b->right, fn);
+            inner = b->left;
+        }
+        PT_FN(_dealloc)(b);
+        return PT_FN(_intersect_rec)(a, inner, merge, fn, udata);
+    }
+}
+
+static PT_T *PT_FN(_difference_rec)(PT_T *a, PT_T *b, trie_free_fn fn) {
+    PT_T *inner;
+    int common;
+
+    if (a == NULL || b == NULL) {
+        PT_FN(_free)(b, fn);
+        return a;
+    }
+
+    common = PT_FN(_set_common)(a, b);
+
+    if (common < a->pos && common < b->pos) {
+        PT_FN(_free)(b, fn);
+        return a;
+    } else if (a->pos == b->pos) {
+        if (a->isset) {
+            PT_FN(_free)(a, fn);
+            PT_FN(_free)(b, fn);
+            return NULL;
+        } else {
+            PT_T *left = PT_FN(_difference_rec)(a->left, b->left, fn);
+            PT_T *right = PT_FN(_difference_rec)(a->right, b->right, fn);
+            PT_FN(_dealloc)(b);
+            return PT_FN(_set_rejoin)(a, left, right);
+        }
+    } else if (a->pos < b->pos) {
+        if (PT_KEY_BIT(b->key, a->pos)) {
+            return PT_FN(_set_rejoin)(a, a->left, PT_FN(_difference_rec)(a->right, b, fn));
+        } else {
+            return PT_FN(_set_rejoin)(a, PT_FN(_difference_rec)(a->left, b, fn), a->right);
+        }
+    } else {
+        /* keys of b on the other side of its branch cannot be in a */
+        if (PT_KEY_BIT(a->key, b->pos)) {
+            PT_FN(_free)(b->left, fn);
+            inner = b->right;
+        } else {
+            PT_FN(_free)(b->right, fn);
+            inner = b->left;
+        }
+        PT_FN(_dealloc)(b);
+        return PT_FN(_difference_rec)(a, inner, fn);
+    }
+}
+
+/*
+ * A union needs a new branch wherever two disjoint subtrees meet. If one
+ * cannot be allocated the subtrees concerned are freed, and once the walk
+ * is over so is everything else, leaving NULL.
+ */
+PT_T *PT_FN(_union)(PT_T *a, PT_T *b, trie_merge_fn merge, trie_free_fn fn, void *udata) {
+    PT_T *ret;
+    int err = 0;
+
+    a = PT_FN(_set_root)(a);
+    b = PT_FN(_set_root)(b);
+    ret = PT_FN(_union_rec)(a, b, merge, fn, udata, &err);
+
+    if (err) {
+        PT_FN(_free)(ret, fn);
+        return NULL;
+    }
+
+    return PT_FN(_set_result)(ret);
+}
+
+PT_T *PT_FN(_intersect)(PT_T *a, PT_T *b, trie_merge_fn merge, trie_free_fn fn, void *udata) {
+    a = PT_FN(_set_root)(a);
+    b = PT_FN(_set_root)(b);
+    return PT_FN(_set_result)(PT_FN(_intersect_rec)(a, b, merge, fn, udata));
+}
+
+PT_T *PT_FN(_difference)(PT_T *a, PT_T *b, trie_free_fn fn) {
+    a = PT_FN(_set_root)(a);
+    b = PT_FN(_set_root)(b);
+    return PT_FN(_set_result)(PT_FN(_difference_rec)(a, b, fn));
+}
+
+/*
+ * The shape is measured by walking the trie; depth counts the branches
+ * above a leaf, which is how many nodes a lookup for it visits.
+ */
+static void PT_FN(_stats_walk)(PT_T *node, size_t depth, bodhi_patricia_stats_t *stats,
+                               size_t *depth_sum) {
+    while (node != NULL) {
+        stats->nodes++;
+
+        if (node->isset) {
+            stats->size++;
+            *depth_sum += depth;
+            if (depth > stats->max_depth) {
+                stats->max_depth = depth;
+            }
+            return;
+        }
+
+        if (node->left == NULL) {
+            return;
+        }
+
+        stats->branches++;
+        PT_FN(_stats_walk)(node->left, depth + 1, stats, depth_sum);
+        node = node->right;
+        depth++;
+    }
+}
+
+int PT_FN(_stats)(PT_T *trie, bodhi_patricia_stats_t *stats) {
+    size_t depth_sum = 0;
+
+    ASSERT(stats != NULL, return -1);
+
+    memset(stats, 0, sizeof(bodhi_patricia_stats_t));
+#ifdef BODHI_STATS
+    stats->counters = 1;
+    stats->allocs = bodhi_stat_sum(PT_FN(_stat_allocs));
+    stats->frees = bodhi_stat_sum(PT_FN(_stat_frees));
+#endif
+
+    PT_FN(_stats_walk)(trie, 0, stats, &depth_sum);
+    stats->avg_depth = stats->size == 0 ? 0.0 : (double) depth_sum / (double) stats->size;
+    stats->memory = stats->nodes * sizeof(PT_T);
+
+    return 0;
+}
+
+PT_KEY_T PT_FN(_get_key)(PT_T *node) {
+    PT_KEY_T zero;
+
+    memset(&zero, 0, sizeof(zero));
+    ASSERT(node != NULL, return zero);
+    return node->key;
+}
+
+int PT_FN(_get_pos)(PT_T *node) {
+    ASSERT(node != NULL, return 0);
+    return node->pos;
+}
+
+void *PT_FN(_get_data)(PT_T *node) {
+    ASSERT(node != NULL, return NULL);
+    return node->data;
+}
+
+PT_T *PT_FN(_get_left)(PT_T *node) {
+    ASSERT(node != NULL, return NULL);
+    return node->left;
+}
+
+PT_T *PT_FN(_get_right)(PT_T *node) {
+    ASSERT(node != NULL, return NULL);
+    return node->right;
+}
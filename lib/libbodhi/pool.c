@@ -0,0 +1,179 @@
+/*
+ * pool.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "pool.h"
+#include "util.h"
+
+/* more workers than this are never kept around, bigger runs share them */
+#define MAX_WORKERS 256
+
+typedef struct _bodhi_pool_job_t {
+    bodhi_pool_fn fn;
+    void *arg;
+    int thread;
+} bodhi_pool_job_t;
+
+/*
+ * Workers are started the first time a run needs them and then sleep on
+ * _work between runs. One run owns them at a time; a run that finds them
+ * taken, from another thread or from inside a run, starts its own
+ * threads the old way instead.
+ */
+static pthread_mutex_t _owner = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t _lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t _done = PTHREAD_COND_INITIALIZER;
+
+/* the current run: calls next .. nthreads - 1 are unclaimed, pending unfinished */
+static bodhi_pool_fn _fn;
+static void *_arg;
+static int _nthreads;
+static int _next;
+static int _pending;
+static unsigned long _run;
+static int _workers;
+
+/* claims and makes calls of the current run until none are left, called with _lock held */
+static void _bodhi_pool_drain(void) {
+    while (_next < _nthreads) {
+        int thread = _next++;
+
+        pthread_mutex_unlock(&_lock);
+        _fn(_arg, thread);
+        pthread_mutex_lock(&_lock);
+
+        if (--_pending == 0) {
+            pthread_cond_broadcast(&_done);
+        }
+    }
+}
+
+static void *_bodhi_pool_worker(void *p) {
+    unsigned long seen = 0;
+
+    (void) p;
+    pthread_mutex_lock(&_lock);
+    for (;;) {
+        while (_run == seen) {
+            pthread_cond_wait(&_work, &_lock);
+        }
+        seen = _run;
+        _bodhi_pool_drain();
+    }
+
+    return NULL;
+}
+
+/* called with _lock held */
+static void _bodhi_pool_grow(int count) {
+    pthread_attr_t attr;
+    pthread_t tid;
+
+    if (count > MAX_WORKERS) {
+        count = MAX_WORKERS;
+    }
+    if (_workers >= count || pthread_attr_init(&attr) != 0) {
+        return;
+    }
+
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    while (_workers < count && pthread_create(&tid, &attr, _bodhi_pool_worker, NULL) == 0) {
+        _workers++;
+    }
+    pthread_attr_destroy(&attr);
+}
+
+static void *_bodhi_pool_main(void *p) {
+    bodhi_pool_job_t *job = p;
+    job->fn(job->arg, job->thread);
+    return NULL;
+}
+
+/* one thread per call, for runs that can't have the workers */
+static void _bodhi_pool_spawn(int nthreads, bodhi_pool_fn fn, void *arg) {
+    bodhi_pool_job_t *jobs;
+    pthread_t *tids;
+    int started = 0;
+    int i;
+
+    jobs = malloc((size_t) nthreads * sizeof(bodhi_pool_job_t));
+    tids = malloc((size_t) nthreads * sizeof(pthread_t));
+
+    if (jobs != NULL && tids != NULL) {
+        /* thread 0 is the caller */
+        for (i = 1; i < nthreads; i++) {
+            jobs[i].fn = fn;
+            jobs[i].arg = arg;
+            jobs[i].thread = i;
+            if (pthread_create(&tids[i], NULL, _bodhi_pool_main, &jobs[i]) != 0) {
+                break;
+            }
+            started = i;
+        }
+    }
+
+    fn(arg, 0);
+    for (i = started + 1; i < nthreads; i++) {
+        fn(arg, i);
+    }
+
+    for (i = 1; i <= started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    free(jobs);
+    free(tids);
+}
+
+void bodhi_pool_run(int nthreads, bodhi_pool_fn fn, void *arg) {
+    if (nthreads <= 1) {
+        fn(arg, 0);
+        return;
+    }
+
+    if (pthread_mutex_trylock(&_owner) != 0) {
+        _bodhi_pool_spawn(nthreads, fn, arg);
+        return;
+    }
+
+    pthread_mutex_lock(&_lock);
+    _bodhi_pool_grow(nthreads - 1);
+    _fn = fn;
+    _arg = arg;
+    _nthreads = nthreads;
+    _next = 1;
+    _pending = nthreads - 1;
+    _run++;
+    pthread_cond_broadcast(&_work);
+    pthread_mutex_unlock(&_lock);
+
+    fn(arg, 0);
+
+    /* calls no worker got to yet are made here, so the run finishes even without workers */
+    pthread_mutex_lock(&_lock);
+    _bodhi_pool_drain();
+    while (_pending > 0) {
+        pthread_cond_wait(&_done, &_lock);
+    }
+    pthread_mutex_unlock(&_lock);
+
+    pthread_mutex_unlock(&_owner);
+}
@@ -0,0 +1,33 @@
+/*
+ * pool.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BODHI_POOL_H
+#define BODHI_POOL_H
+
+/*
+ * Fork/join helper for the parallel paths of the library: runs
+ * fn(arg, 0) .. fn(arg, nthreads - 1) on nthreads threads and waits for all
+ * of them. Call 0 runs on the calling thread and the rest on a pool of
+ * workers kept between runs. If threads can't be started the remaining
+ * calls run on the calling thread, so the work always gets done.
+ */
+typedef void (*bodhi_pool_fn)(void *arg, int thread);
+
+void bodhi_pool_run(int nthreads, bodhi_pool_fn fn, void *arg);
+
+#endif
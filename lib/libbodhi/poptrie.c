@@ -0,0 +1,237 @@
+/*
+ * poptrie.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include "poptrie.h"
+#include "util.h"
+
+/* top 16 bits: one bit per possible prefix, 64 prefixes per word */
+typedef struct _bodhi_poptrie_l0_t {
+    uint64_t bits;
+    uint32_t rank;
+} bodhi_poptrie_l0_t;
+
+/* 8 bit stride: 256 bits plus the rank of each 64 bit word */
+typedef struct _bodhi_poptrie_node_t {
+    uint32_t base;
+    uint8_t rank[4];
+    uint64_t bits[4];
+} bodhi_poptrie_node_t;
+
+struct _bodhi_poptrie_t {
+    size_t count;
+
+    bodhi_poptrie_l0_t l0[1024];
+
+    bodhi_poptrie_node_t *l1;
+    size_t l1_count;
+    bodhi_poptrie_node_t *l2;
+    size_t l2_count;
+
+    void **vals;
+};
+
+typedef struct _bodhi_poptrie_collect_t {
+    uint32_t *keys;
+    void **vals;
+    size_t n;
+} bodhi_poptrie_collect_t;
+
+static void _collect(bodhi_patricia_t *node, void *udata) {
+    bodhi_poptrie_collect_t *c = udata;
+
+    c->keys[c->n] = bodhi_patricia_get_key(node);
+    c->vals[c->n] = bodhi_patricia_get_data(node);
+    c->n++;
+}
+
+static void _set_bit(uint64_t *bits, unsigned int i) {
+    bits[i >> 6] |= (uint64_t) 1 << (i & 63);
+}
+
+static void _node_rank(bodhi_poptrie_node_t *node) {
+    unsigned int i;
+    unsigned int sum = 0;
+
+    for (i = 0; i < 4; i++) {
+        node->rank[i] = (uint8_t) sum;
+        sum += POPCOUNT64(node->bits[i]);
+    }
+}
+
+/* returns the index of the child for byte b, or -1 if there isn't one */
+static long _node_child(const bodhi_poptrie_node_t *node, unsigned int b) {
+    uint64_t word = node->bits[b >> 6];
+    uint64_t bit = (uint64_t) 1 << (b & 63);
+
+    if ((word & bit) == 0) {
+        return -1;
+    }
+
+    return (long) (node->base + node->rank[b >> 6] + POPCOUNT64(word & (bit - 1)));
+}
+
+bodhi_poptrie_t *bodhi_poptrie_build(const uint32_t *keys, void **vals, size_t n) {
+    bodhi_poptrie_t *ret;
+    size_t i;
+    size_t i1 = 0;
+    size_t i2 = 0;
+    uint32_t sum;
+
+    CALLOC(ret, 1, sizeof(bodhi_poptrie_t), return NULL);
+
+    /* keys must be strictly ascending, count the nodes each level needs */
+    for (i = 0; i < n; i++) {
+        if (i > 0 && keys[i] <= keys[i - 1]) {
+            free(ret);
+            return NULL;
+        }
+
+        if (i == 0 || keys[i] >> 16 != keys[i - 1] >> 16) {
+            ret->l1_count++;
+        }
+
+        if (i == 0 || keys[i] >> 8 != keys[i - 1] >> 8) {
+            ret->l2_count++;
+        }
+    }
+
+    if (n > 0) {
+        CALLOC(ret->l1, ret->l1_count, sizeof(bodhi_poptrie_node_t), goto error);
+        CALLOC(ret->l2, ret->l2_count, sizeof(bodhi_poptrie_node_t), goto error);
+        MALLOC(ret->vals, n * sizeof(void*), goto error);
+    }
+
+    /*
+     * since the keys are sorted, the children of any node are allocated
+     * one after the other, so a node only needs the index of its first one
+     */
+    for (i = 0; i < n; i++) {
+        uint32_t key = keys[i];
+
+        if (i == 0 || key >> 16 != keys[i - 1] >> 16) {
+            i1++;
+            ret->l1[i1 - 1].base = (uint32_t) i2;
+            ret->l0[key >> 22].bits |= (uint64_t) 1 << ((key >> 16) & 63);
+        }
+
+        if (i == 0 || key >> 8 != keys[i - 1] >> 8) {
+            i2++;
+            ret->l2[i2 - 1].base = (uint32_t) i;
+            _set_bit(ret->l1[i1 - 1].bits, (key >> 8) & 0xFF);
+        }
+
+        _set_bit(ret->l2[i2 - 1].bits, key & 0xFF);
+        ret->vals[i] = vals[i];
+    }
+
+    for (i = 0, sum = 0; i < 1024; i++) {
+        ret->l0[i].rank = sum;
+        sum += POPCOUNT64(ret->l0[i].bits);
+    }
+
+    for (i = 0; i < ret->l1_count; i++) {
+        _node_rank(&ret->l1[i]);
+    }
+
+    for (i = 0; i < ret->l2_count; i++) {
+        _node_rank(&ret->l2[i]);
+    }
+
+    ret->count = n;
+    return ret;
+
+error:
+    bodhi_poptrie_free(ret);
+    return NULL;
+}
+
+bodhi_poptrie_t *bodhi_poptrie_compile(bodhi_patricia_t *trie) {
+    bodhi_poptrie_collect_t c;
+    bodhi_poptrie_t *ret;
+    size_t n = bodhi_patricia_size(trie);
+
+    c.n = 0;
+    c.keys = NULL;
+    c.vals = NULL;
+
+    if (n > 0) {
+        MALLOC(c.keys, n * sizeof(uint32_t), return NULL);
+        MALLOC(c.vals, n * sizeof(void*), free(c.keys); return NULL);
+
+        /* the loop visits the left (0) branch first, so keys come out sorted */
+        bodhi_patricia_loop(trie, _collect, &c);
+    }
+
+    ret = bodhi_poptrie_build(c.keys, c.vals, c.n);
+
+    free(c.keys);
+    free(c.vals);
+    return ret;
+}
+
+void bodhi_poptrie_free(bodhi_poptrie_t *pt) {
+    ASSERT(pt != NULL, return);
+
+    free(pt->l1);
+    free(pt->l2);
+    free(pt->vals);
+    free(pt);
+}
+
+void *bodhi_poptrie_find_val(const bodhi_poptrie_t *pt, uint32_t key) {
+    const bodhi_poptrie_l0_t *l0;
+    uint64_t bit;
+    long i;
+
+    ASSERT(pt != NULL, return NULL);
+
+    l0 = &pt->l0[key >> 22];
+    bit = (uint64_t) 1 << ((key >> 16) & 63);
+    if ((l0->bits & bit) == 0) {
+        return NULL;
+    }
+
+    i = (long) (l0->rank + POPCOUNT64(l0->bits & (bit - 1)));
+    if ((i = _node_child(&pt->l1[i], (key >> 8) & 0xFF)) < 0) {
+        return NULL;
+    }
+
+    if ((i = _node_child(&pt->l2[i], key & 0xFF)) < 0) {
+        return NULL;
+    }
+
+    return pt->vals[i];
+}
+
+size_t bodhi_poptrie_size(const bodhi_poptrie_t *pt) {
+    ASSERT(pt != NULL, return 0);
+    return pt->count;
+}
+
+bodhi_poptrie_t *bodhi_poptrie_load(bodhi_poptrie_t **slot) {
+    ASSERT(slot != NULL, return NULL);
+    return ATOMIC_LOAD(slot);
+}
+
+bodhi_poptrie_t *bodhi_poptrie_swap(bodhi_poptrie_t **slot, bodhi_poptrie_t *pt) {
+    ASSERT(slot != NULL, return NULL);
+    return ATOMIC_XCHG(slot, pt);
+}
@@ -0,0 +1,49 @@
+/*
+ * poptrie.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BODHI_POPTRIE_H
+#define BODHI_POPTRIE_H
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include <libbodhi/patricia.h>
+
+/*
+ * A read-only, popcount compressed multibit trie compiled from a
+ * bodhi_patricia_t. Keys are split 16/8/8 and every level is a bit vector
+ * plus a rank, so a lookup touches at most four cache lines no matter how
+ * many keys are stored.
+ */
+typedef struct _bodhi_poptrie_t bodhi_poptrie_t;
+
+bodhi_poptrie_t *bodhi_poptrie_compile(bodhi_patricia_t *trie);
+bodhi_poptrie_t *bodhi_poptrie_build(const uint32_t *keys, void **vals, size_t n);
+void bodhi_poptrie_free(bodhi_poptrie_t *pt);
+void *bodhi_poptrie_find_val(const bodhi_poptrie_t *pt, uint32_t key);
+size_t bodhi_poptrie_size(const bodhi_poptrie_t *pt);
+
+/*
+ * Tables are published through a slot so a rebuilt table can be swapped in
+ * while readers keep going. bodhi_poptrie_swap returns the previous table,
+ * which must not be freed until every reader that loaded it is done.
+ */
+bodhi_poptrie_t *bodhi_poptrie_load(bodhi_poptrie_t **slot);
+bodhi_poptrie_t *bodhi_poptrie_swap(bodhi_poptrie_t **slot, bodhi_poptrie_t *pt);
+
+#endif
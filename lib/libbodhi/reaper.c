@@ -0,0 +1,136 @@
+/*
+ * reaper.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include "reaper.h"
+#include "util.h"
+
+typedef struct _bodhi_reaper_job_t {
+    bodhi_reaper_fn fn;
+    void *arg;
+    struct _bodhi_reaper_job_t *next;
+} bodhi_reaper_job_t;
+
+static pthread_mutex_t _lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t _done = PTHREAD_COND_INITIALIZER;
+
+/* jobs run in the order submitted, waiters compare the two counters */
+static bodhi_reaper_job_t *_head;
+static bodhi_reaper_job_t *_tail;
+static uint64_t _submitted;
+static uint64_t _completed;
+static int _started;
+
+static void *_bodhi_reaper_main(void *p) {
+    (void) p;
+
+    pthread_mutex_lock(&_lock);
+    for (;;) {
+        bodhi_reaper_job_t *job;
+
+        while (_head == NULL) {
+            pthread_cond_wait(&_work, &_lock);
+        }
+
+        job = _head;
+        _head = job->next;
+        if (_head == NULL) {
+            _tail = NULL;
+        }
+        pthread_mutex_unlock(&_lock);
+
+        job->fn(job->arg);
+        free(job);
+
+        pthread_mutex_lock(&_lock);
+        _completed++;
+        pthread_cond_broadcast(&_done);
+    }
+
+    return NULL;
+}
+
+/* called with the lock held */
+static int _bodhi_reaper_start(void) {
+    pthread_attr_t attr;
+    pthread_t tid;
+    int ret;
+
+    if (_started) {
+        return 0;
+    }
+
+    if (pthread_attr_init(&attr) != 0) {
+        return -1;
+    }
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    ret = pthread_create(&tid, &attr, _bodhi_reaper_main, NULL);
+    pthread_attr_destroy(&attr);
+
+    if (ret != 0) {
+        return -1;
+    }
+
+    _started = 1;
+    return 0;
+}
+
+void bodhi_reaper_submit(bodhi_reaper_fn fn, void *arg) {
+    bodhi_reaper_job_t *job;
+
+    ASSERT(fn != NULL, return);
+
+    MALLOC(job, sizeof(bodhi_reaper_job_t), fn(arg); return);
+    job->fn = fn;
+    job->arg = arg;
+    job->next = NULL;
+
+    pthread_mutex_lock(&_lock);
+    if (_bodhi_reaper_start() != 0) {
+        pthread_mutex_unlock(&_lock);
+        free(job);
+        fn(arg);
+        return;
+    }
+
+    if (_tail == NULL) {
+        _head = job;
+    } else {
+        _tail->next = job;
+    }
+    _tail = job;
+    _submitted++;
+
+    pthread_cond_signal(&_work);
+    pthread_mutex_unlock(&_lock);
+}
+
+void bodhi_reaper_wait(void) {
+    uint64_t target;
+
+    pthread_mutex_lock(&_lock);
+    target = _submitted;
+    while (_completed < target) {
+        pthread_cond_wait(&_done, &_lock);
+    }
+    pthread_mutex_unlock(&_lock);
+}
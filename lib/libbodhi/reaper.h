@@ -0,0 +1,34 @@
+/*
+ * reaper.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BODHI_REAPER_H
+#define BODHI_REAPER_H
+
+/*
+ * A process wide background thread that runs teardown work handed to it,
+ * used by the *_free_detached functions. It is started on first use. If it
+ * can't be started, or the job can't be queued, the work runs on the
+ * calling thread instead, so it always gets done.
+ */
+typedef void (*bodhi_reaper_fn)(void *arg);
+
+void bodhi_reaper_submit(bodhi_reaper_fn fn, void *arg);
+/* blocks until everything submitted before the call has run */
+void bodhi_reaper_wait(void);
+
+#endif
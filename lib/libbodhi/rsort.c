@@ -0,0 +1,366 @@
+/*
+ * rsort.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "list.h"
+#include "pool.h"
+#include "util.h"
+
+/* below this many elements the threads cost more than they save */
+#define PARALLEL_MIN 65536
+
+/*
+ * Keys are pulled out once into (key, pointer) pairs, which the passes
+ * then move around without touching the elements again. Every pass is a
+ * stable counting scatter on one byte; bytes that are the same in every
+ * key are skipped, so 32 bit keys cost four passes and narrower ones less.
+ */
+typedef struct _bodhi_rsort_pair_t {
+    uint64_t key;
+    void *ptr;
+} bodhi_rsort_pair_t;
+
+#define DIGIT(k, b) ((size_t) ((k) >> ((b) * 8)) & 0xFF)
+
+/* sorts src on its low nbytes bytes, returns whichever buffer holds the result */
+static bodhi_rsort_pair_t *_bodhi_rsort_lsd(bodhi_rsort_pair_t *src, bodhi_rsort_pair_t *dst, size_t n,
+                                            int nbytes) {
+    size_t (*hist)[256];
+    size_t i;
+    int b;
+
+    if (n < 2 || nbytes == 0) {
+        return src;
+    }
+
+    /* all the histograms in one pass over the keys */
+    CALLOC(hist, (size_t) nbytes, sizeof(*hist), return NULL);
+    for (i = 0; i < n; i++) {
+        uint64_t k = src[i].key;
+        for (b = 0; b < nbytes; b++) {
+            hist[b][DIGIT(k, b)]++;
+        }
+    }
+
+    for (b = 0; b < nbytes; b++) {
+        size_t sum = 0, c;
+        bodhi_rsort_pair_t *tmp;
+
+        if (hist[b][DIGIT(src[0].key, b)] == n) {
+            continue;
+        }
+
+        for (c = 0; c < 256; c++) {
+            size_t count = hist[b][c];
+            hist[b][c] = sum;
+            sum += count;
+        }
+
+        for (i = 0; i < n; i++) {
+            dst[hist[b][DIGIT(src[i].key, b)]++] = src[i];
+        }
+
+        tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    free(hist);
+    return src;
+}
+
+/*
+ * The threaded sort partitions once on the highest byte where keys
+ * differ, each thread scattering its own slice with offsets from the
+ * combined histograms, then the threads take the 256 buckets one at a time
+ * and finish them with the serial sort on the bytes below.
+ */
+typedef struct _bodhi_rsort_job_t {
+    bodhi_rsort_pair_t *a;
+    bodhi_rsort_pair_t *tmp;
+    void **items;
+    bodhi_list_key_fn fn;
+    size_t n;
+    int nthreads;
+    int top;
+
+    uint64_t *or_bits;
+    uint64_t *and_bits;
+    size_t (*hist)[256];
+    size_t starts[257];
+    size_t next;
+    int failed;
+} bodhi_rsort_job_t;
+
+static void _bodhi_rsort_slice(bodhi_rsort_job_t *job, int thread, size_t *lo, size_t *hi) {
+    *lo = job->n * (size_t) thread / (size_t) job->nthreads;
+    *hi = job->n * (size_t) (thread + 1) / (size_t) job->nthreads;
+}
+
+static void _bodhi_rsort_extract(void *arg, int thread) {
+    bodhi_rsort_job_t *job = arg;
+    uint64_t or_bits = 0, and_bits = ~(uint64_t) 0;
+    size_t i, lo, hi;
+
+    _bodhi_rsort_slice(job, thread, &lo, &hi);
+    for (i = lo; i < hi; i++) {
+        if (job->items != NULL) {
+            job->a[i].ptr = job->items[i];
+            job->a[i].key = job->fn(job->items[i]);
+        }
+        or_bits |= job->a[i].key;
+        and_bits &= job->a[i].key;
+    }
+
+    job->or_bits[thread] = or_bits;
+    job->and_bits[thread] = and_bits;
+}
+
+static void _bodhi_rsort_count(void *arg, int thread) {
+    bodhi_rsort_job_t *job = arg;
+    size_t i, lo, hi;
+
+    _bodhi_rsort_slice(job, thread, &lo, &hi);
+    memset(job->hist[thread], 0, sizeof(job->hist[thread]));
+    for (i = lo; i < hi; i++) {
+        job->hist[thread][DIGIT(job->a[i].key, job->top)]++;
+    }
+}
+
+static void _bodhi_rsort_scatter(void *arg, int thread) {
+    bodhi_rsort_job_t *job = arg;
+    size_t *offsets = job->hist[thread];
+    size_t i, lo, hi;
+
+    _bodhi_rsort_slice(job, thread, &lo, &hi);
+    for (i = lo; i < hi; i++) {
+        job->tmp[offsets[DIGIT(job->a[i].key, job->top)]++] = job->a[i];
+    }
+}
+
+static void _bodhi_rsort_buckets(void *arg, int thread) {
+    bodhi_rsort_job_t *job = arg;
+    size_t d;
+
+    (void) thread;
+    while ((d = ATOMIC_FETCH_ADD(&job->next, 1)) < 256) {
+        size_t lo = job->starts[d];
+        size_t len = job->starts[d + 1] - lo;
+        bodhi_rsort_pair_t *res = _bodhi_rsort_lsd(job->tmp + lo, job->a + lo, len, job->top);
+
+        if (res == NULL) {
+            job->failed = 1;
+        } else if (res != job->a + lo) {
+            memcpy(job->a + lo, res, len * sizeof(bodhi_rsort_pair_t));
+        }
+    }
+}
+
+/*
+ * Sorts a, filling it from items first if items is not NULL. The result
+ * always ends up in a; returns -1 if memory ran out, leaving a unsorted.
+ */
+static int _bodhi_rsort(bodhi_rsort_pair_t *a, void **items, bodhi_list_key_fn fn, size_t n, int nthreads) {
+    bodhi_rsort_job_t job;
+    bodhi_rsort_pair_t *tmp, *res;
+    uint64_t diff = 0, and_bits = ~(uint64_t) 0;
+    int t, d, ret = 0;
+
+    if (n < PARALLEL_MIN || nthreads < 2) {
+        nthreads = 1;
+    }
+
+    MALLOC(tmp, n * sizeof(bodhi_rsort_pair_t), return -1);
+
+    memset(&job, 0, sizeof(job));
+    job.a = a;
+    job.tmp = tmp;
+    job.items = items;
+    job.fn = fn;
+    job.n = n;
+    job.nthreads = nthreads;
+    job.or_bits = malloc((size_t) nthreads * sizeof(uint64_t));
+    job.and_bits = malloc((size_t) nthreads * sizeof(uint64_t));
+    job.hist = malloc((size_t) nthreads * sizeof(*job.hist));
+    if (job.or_bits == NULL || job.and_bits == NULL || job.hist == NULL) {
+        ret = -1;
+        goto done;
+    }
+
+    bodhi_pool_run(nthreads, _bodhi_rsort_extract, &job);
+    for (t = 0; t < nthreads; t++) {
+        diff |= job.or_bits[t];
+        and_bits &= job.and_bits[t];
+    }
+    diff ^= and_bits;
+
+    /* every key the same, nothing to do */
+    if (diff == 0) {
+        goto done;
+    }
+
+    if (nthreads == 1) {
+        res = _bodhi_rsort_lsd(a, tmp, n, (int) (64 - CLZ64(diff) + 7) / 8);
+        if (res == NULL) {
+            ret = -1;
+        } else if (res != a) {
+            memcpy(a, res, n * sizeof(bodhi_rsort_pair_t));
+        }
+        goto done;
+    }
+
+    job.top = (int) (63 - CLZ64(diff)) / 8;
+    bodhi_pool_run(nthreads, _bodhi_rsort_count, &job);
+
+    /* each thread's offsets: all smaller digits, then this digit in earlier slices */
+    job.starts[0] = 0;
+    for (d = 0; d < 256; d++) {
+        size_t sum = job.starts[d];
+
+        for (t = 0; t < nthreads; t++) {
+            size_t count = job.hist[t][d];
+            job.hist[t][d] = sum;
+            sum += count;
+        }
+        job.starts[d + 1] = sum;
+    }
+
+    bodhi_pool_run(nthreads, _bodhi_rsort_scatter, &job);
+    bodhi_pool_run(nthreads, _bodhi_rsort_buckets, &job);
+    ret = job.failed ? -1 : 0;
+
+done:
+    free(job.or_bits);
+    free(job.and_bits);
+    free(job.hist);
+    free(tmp);
+    return ret;
+}
+
+int bodhi_array_rsort(void **items, size_t n, bodhi_list_key_fn fn, int nthreads) {
+    bodhi_rsort_pair_t *pairs;
+    size_t i;
+
+    ASSERT(items != NULL || n == 0, return -1);
+    ASSERT(fn != NULL, return -1);
+
+    if (n < 2) {
+        return 0;
+    }
+
+    MALLOC(pairs, n * sizeof(bodhi_rsort_pair_t), return -1);
+    if (_bodhi_rsort(pairs, items, fn, n, nthreads) != 0) {
+        free(pairs);
+        return -1;
+    }
+
+    for (i = 0; i < n; i++) {
+        items[i] = pairs[i].ptr;
+    }
+
+    free(pairs);
+    return 0;
+}
+
+/* without memory for the pairs: stable passes of 256 bucket lists */
+static bodhi_list_t *_bodhi_list_rsort_inplace(bodhi_list_t *list, bodhi_list_key_fn fn) {
+    bodhi_list_t *heads[256], *tails[256];
+    bodhi_list_t *iter, *next, *prev;
+    int b, d;
+
+    for (b = 0; b < 8; b++) {
+        memset(heads, 0, sizeof(heads));
+
+        for (iter = list; iter != NULL; iter = next) {
+            next = iter->next;
+            d = (int) DIGIT(fn(iter->data), b);
+            iter->next = NULL;
+            if (heads[d] == NULL) {
+                heads[d] = iter;
+            } else {
+                tails[d]->next = iter;
+            }
+            tails[d] = iter;
+        }
+
+        list = NULL;
+        prev = NULL;
+        for (d = 0; d < 256; d++) {
+            if (heads[d] == NULL) {
+                continue;
+            }
+            if (prev == NULL) {
+                list = heads[d];
+            } else {
+                prev->next = heads[d];
+            }
+            prev = tails[d];
+        }
+    }
+
+    /* fix the back links, the head's pointing at the tail */
+    prev = NULL;
+    for (iter = list; iter != NULL; iter = iter->next) {
+        iter->prev = prev;
+        prev = iter;
+    }
+    list->prev = prev;
+
+    return list;
+}
+
+bodhi_list_t *bodhi_list_rsort(bodhi_list_t *list, bodhi_list_key_fn fn, int nthreads) {
+    bodhi_rsort_pair_t *pairs;
+    bodhi_list_t *iter;
+    size_t n = 0, i;
+
+    ASSERT(fn != NULL, return list);
+
+    if (list == NULL || list->next == NULL) {
+        return list;
+    }
+
+    for (iter = list; iter != NULL; iter = iter->next) {
+        n++;
+    }
+
+    MALLOC(pairs, n * sizeof(bodhi_rsort_pair_t), return _bodhi_list_rsort_inplace(list, fn));
+    for (iter = list, i = 0; iter != NULL; iter = iter->next, i++) {
+        pairs[i].key = fn(iter->data);
+        pairs[i].ptr = iter;
+    }
+
+    if (_bodhi_rsort(pairs, NULL, fn, n, nthreads) != 0) {
+        free(pairs);
+        return _bodhi_list_rsort_inplace(list, fn);
+    }
+
+    for (i = 0; i < n; i++) {
+        bodhi_list_t *node = pairs[i].ptr;
+
+        node->prev = i == 0 ? pairs[n - 1].ptr : pairs[i - 1].ptr;
+        node->next = i == n - 1 ? NULL : pairs[i + 1].ptr;
+    }
+
+    iter = pairs[0].ptr;
+    free(pairs);
+    return iter;
+}
@@ -0,0 +1,438 @@
+/*
+ * snapshot.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HAVE_MMAP 1
+#endif
+
+#include "snapshot.h"
+#include "util.h"
+
+#define SNAPSHOT_MAGIC "BODHIPT"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_ENDIAN 0x01020304u
+
+typedef struct _bodhi_snapshot_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint32_t node_count;
+    uint32_t leaf_count;
+    uint64_t payload_size;
+} bodhi_snapshot_header_t;
+
+/*
+ * pos is 32 for a leaf. off is the index of the right child for a branch
+ * and the offset of the payload for a leaf; a payload is a uint32_t length
+ * followed by the bytes, padded to 8
+ */
+typedef struct _bodhi_snapshot_node_t {
+    uint32_t key;
+    uint32_t pos;
+    uint64_t off;
+} bodhi_snapshot_node_t;
+
+struct _bodhi_snapshot_t {
+    const unsigned char *base;
+    size_t len;
+    int mapped;
+
+    const bodhi_snapshot_header_t *header;
+    const bodhi_snapshot_node_t *nodes;
+    const unsigned char *payload;
+};
+
+typedef struct _bodhi_snapshot_writer_t {
+    bodhi_snapshot_node_t *nodes;
+    uint32_t node_count;
+    uint32_t leaf_count;
+
+    unsigned char *payload;
+    size_t payload_size;
+    size_t payload_alloc;
+
+    bodhi_snapshot_val_fn fn;
+    void *udata;
+} bodhi_snapshot_writer_t;
+
+#define KEY_BIT(k, i) (((k) >> (31 - (i))) & 1)
+#define PAD8(n) (((n) + 7) & ~(size_t) 7)
+
+static size_t _count_nodes(bodhi_patricia_t *node) {
+    if (node == NULL || bodhi_patricia_get_left(node) == NULL) {
+        return node != NULL && bodhi_patricia_get_pos(node) == 32;
+    }
+
+    return 1 + _count_nodes(bodhi_patricia_get_left(node)) + _count_nodes(bodhi_patricia_get_right(node));
+}
+
+static int _put_payload(bodhi_snapshot_writer_t *w, void *data, uint64_t *off) {
+    const void *bytes = NULL;
+    size_t len = 0;
+    uint32_t len32;
+    size_t need;
+
+    if (w->fn != NULL) {
+        bytes = w->fn(data, &len, w->udata);
+    }
+
+    if (bytes == NULL || len > 0xFFFFFFFFu) {
+        len = 0;
+    }
+
+    need = w->payload_size + PAD8(sizeof(uint32_t) + len);
+    if (need > w->payload_alloc) {
+        size_t new_alloc = w->payload_alloc == 0 ? 4096 : w->payload_alloc;
+        unsigned char *tmp;
+
+        while (new_alloc < need) {
+            new_alloc *= 2;
+        }
+
+        if ((tmp = realloc(w->payload, new_alloc)) == NULL) {
+            return -1;
+        }
+        w->payload = tmp;
+        w->payload_alloc = new_alloc;
+    }
+
+    *off = w->payload_size;
+    len32 = (uint32_t) len;
+    memset(w->payload + w->payload_size, 0, need - w->payload_size);
+    memcpy(w->payload + w->payload_size, &len32, sizeof(uint32_t));
+    if (len > 0) {
+        memcpy(w->payload + w->payload_size + sizeof(uint32_t), bytes, len);
+    }
+    w->payload_size = need;
+
+    return 0;
+}
+
+static int _write_node(bodhi_snapshot_writer_t *w, bodhi_patricia_t *node) {
+    uint32_t i = w->node_count++;
+
+    w->nodes[i].key = bodhi_patricia_get_key(node);
+    w->nodes[i].pos = (uint32_t) bodhi_patricia_get_pos(node);
+
+    if (w->nodes[i].pos == 32) {
+        w->leaf_count++;
+        return _put_payload(w, bodhi_patricia_get_data(node), &w->nodes[i].off);
+    }
+
+    if (_write_node(w, bodhi_patricia_get_left(node)) != 0) {
+        return -1;
+    }
+
+    w->nodes[i].off = w->node_count;
+    return _write_node(w, bodhi_patricia_get_right(node));
+}
+
+int bodhi_snapshot_write(bodhi_patricia_t *trie, const char *path, bodhi_snapshot_val_fn fn, void *udata) {
+    bodhi_snapshot_writer_t w;
+    bodhi_snapshot_header_t header;
+    size_t count = _count_nodes(trie);
+    FILE *fp;
+    int ret = -1;
+
+    ASSERT(path != NULL, return -1);
+
+    if (count > 0xFFFFFFFFu) {
+        return -1;
+    }
+
+    memset(&w, 0, sizeof(w));
+    w.fn = fn;
+    w.udata = udata;
+
+    if (count > 0) {
+        CALLOC(w.nodes, count, sizeof(bodhi_snapshot_node_t), return -1);
+        if (_write_node(&w, trie) != 0) {
+            goto cleanup;
+        }
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.endian = SNAPSHOT_ENDIAN;
+    header.node_count = w.node_count;
+    header.leaf_count = w.leaf_count;
+    header.payload_size = w.payload_size;
+
+    if ((fp = fopen(path, "wb")) == NULL) {
+        goto cleanup;
+    }
+
+    if (fwrite(&header, sizeof(header), 1, fp) == 1
+        && fwrite(w.nodes, sizeof(bodhi_snapshot_node_t), w.node_count, fp) == w.node_count
+        && fwrite(w.payload, 1, w.payload_size, fp) == w.payload_size) {
+        ret = 0;
+    }
+
+    if (fclose(fp) != 0) {
+        ret = -1;
+    }
+
+cleanup:
+    free(w.nodes);
+    free(w.payload);
+    return ret;
+}
+
+static int _load(bodhi_snapshot_t *snap, const char *path) {
+#ifdef HAVE_MMAP
+    struct stat st;
+    void *p;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        return -1;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return -1;
+    }
+
+    p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return -1;
+    }
+
+    snap->base = p;
+    snap->len = (size_t) st.st_size;
+    snap->mapped = 1;
+    return 0;
+#else
+    FILE *fp;
+    long size;
+    unsigned char *buf;
+
+    if ((fp = fopen(path, "rb")) == NULL) {
+        return -1;
+    }
+
+    if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) <= 0 || fseek(fp, 0, SEEK_SET) != 0) {
+        fclose(fp);
+        return -1;
+    }
+
+    MALLOC(buf, (size_t) size, fclose(fp); return -1);
+    if (fread(buf, 1, (size_t) size, fp) != (size_t) size) {
+        free(buf);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    snap->base = buf;
+    snap->len = (size_t) size;
+    snap->mapped = 0;
+    return 0;
+#endif
+}
+
+/*
+ * every index and payload range is checked once here, so the lookups can
+ * trust the image without bounds checks of their own. Right children come
+ * after their left subtree, which also rules out cycles.
+ */
+static int _validate(bodhi_snapshot_t *snap, uint64_t payload_size) {
+    uint32_t count = snap->header->node_count;
+    uint32_t leaves = 0;
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        const bodhi_snapshot_node_t *node = &snap->nodes[i];
+
+        if (node->pos < 32) {
+            if (node->off <= (uint64_t) i + 1 || node->off >= count) {
+                return -1;
+            }
+        } else if (node->pos == 32) {
+            uint32_t len32;
+
+            if (node->off > payload_size || payload_size - node->off < sizeof(uint32_t)) {
+                return -1;
+            }
+
+            memcpy(&len32, snap->payload + node->off, sizeof(uint32_t));
+            if (len32 > payload_size - node->off - sizeof(uint32_t)) {
+                return -1;
+            }
+            leaves++;
+        } else {
+            return -1;
+        }
+    }
+
+    return leaves == snap->header->leaf_count ? 0 : -1;
+}
+
+bodhi_snapshot_t *bodhi_snapshot_open(const char *path) {
+    bodhi_snapshot_t *ret;
+    const bodhi_snapshot_header_t *h;
+    size_t nodes_size;
+
+    ASSERT(path != NULL, return NULL);
+
+    CALLOC(ret, 1, sizeof(bodhi_snapshot_t), return NULL);
+    if (_load(ret, path) != 0) {
+        free(ret);
+        return NULL;
+    }
+
+    if (ret->len < sizeof(bodhi_snapshot_header_t)) {
+        goto error;
+    }
+
+    h = (const bodhi_snapshot_header_t *) ret->base;
+
+    if (memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0
+        || h->version != SNAPSHOT_VERSION || h->endian != SNAPSHOT_ENDIAN) {
+        goto error;
+    }
+
+    /* the sizes come from the file, so add them up without overflowing */
+    if (h->node_count > (ret->len - sizeof(bodhi_snapshot_header_t)) / sizeof(bodhi_snapshot_node_t)) {
+        goto error;
+    }
+    nodes_size = (size_t) h->node_count * sizeof(bodhi_snapshot_node_t);
+    if (h->payload_size != ret->len - sizeof(bodhi_snapshot_header_t) - nodes_size) {
+        goto error;
+    }
+
+    ret->header = h;
+    ret->nodes = (const bodhi_snapshot_node_t *) (ret->base + sizeof(bodhi_snapshot_header_t));
+    ret->payload = ret->base + sizeof(bodhi_snapshot_header_t) + nodes_size;
+
+    if (_validate(ret, h->payload_size) != 0) {
+        goto error;
+    }
+
+    return ret;
+
+error:
+    bodhi_snapshot_close(ret);
+    return NULL;
+}
+
+void bodhi_snapshot_close(bodhi_snapshot_t *snap) {
+    ASSERT(snap != NULL, return);
+
+#ifdef HAVE_MMAP
+    if (snap->mapped) {
+        munmap((void *) snap->base, snap->len);
+    } else {
+        free((void *) snap->base);
+    }
+#else
+    free((void *) snap->base);
+#endif
+    free(snap);
+}
+
+size_t bodhi_snapshot_size(bodhi_snapshot_t *snap) {
+    ASSERT(snap != NULL, return 0);
+    return snap->header->leaf_count;
+}
+
+static const void *_payload(bodhi_snapshot_t *snap, const bodhi_snapshot_node_t *node, size_t *len) {
+    uint32_t len32;
+
+    memcpy(&len32, snap->payload + node->off, sizeof(uint32_t));
+    if (len != NULL) {
+        *len = len32;
+    }
+
+    return snap->payload + node->off + sizeof(uint32_t);
+}
+
+/* descends by key's bits, which ends at the leaf closest to key */
+static const bodhi_snapshot_node_t *_descend(bodhi_snapshot_t *snap, uint32_t key) {
+    uint32_t i = 0;
+
+    if (snap->header->node_count == 0) {
+        return NULL;
+    }
+
+    while (snap->nodes[i].pos < 32) {
+        i = KEY_BIT(key, snap->nodes[i].pos) ? (uint32_t) snap->nodes[i].off : i + 1;
+    }
+
+    return &snap->nodes[i];
+}
+
+const void *bodhi_snapshot_find_val(bodhi_snapshot_t *snap, uint32_t key, size_t *len) {
+    const bodhi_snapshot_node_t *leaf;
+
+    ASSERT(snap != NULL, return NULL);
+
+    leaf = _descend(snap, key);
+    if (leaf == NULL || leaf->key != key) {
+        return NULL;
+    }
+
+    return _payload(snap, leaf, len);
+}
+
+const void *bodhi_snapshot_lpm(bodhi_snapshot_t *snap, uint32_t key, uint32_t *match, size_t *len) {
+    const bodhi_snapshot_node_t *leaf;
+
+    ASSERT(snap != NULL, return NULL);
+
+    /*
+     * a branch whose prefix already differs from key only holds keys that
+     * share exactly as many bits with it, so any leaf below it will do
+     */
+    leaf = _descend(snap, key);
+    if (leaf == NULL) {
+        return NULL;
+    }
+
+    if (match != NULL) {
+        *match = leaf->key;
+    }
+
+    return _payload(snap, leaf, len);
+}
+
+void bodhi_snapshot_loop(bodhi_snapshot_t *snap, snapshot_loop_cb cb, void *udata) {
+    uint32_t i;
+
+    ASSERT(snap != NULL, return);
+
+    /* preorder puts the leaves in key order, so this is a straight scan */
+    for (i = 0; i < snap->header->node_count; i++) {
+        if (snap->nodes[i].pos == 32) {
+            size_t len;
+            const void *val = _payload(snap, &snap->nodes[i], &len);
+            cb(snap->nodes[i].key, val, len, udata);
+        }
+    }
+}
@@ -0,0 +1,54 @@
+/*
+ * snapshot.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BODHI_SNAPSHOT_H
+#define BODHI_SNAPSHOT_H
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include <libbodhi/patricia.h>
+
+/*
+ * A flat, position independent image of a bodhi_patricia_t. Nodes are
+ * stored in preorder, so a left child always follows its parent and only
+ * the right child needs an index. Values are copied into a payload area
+ * and addressed by offset. The file is mapped read-only and queried in
+ * place. Opening makes one pass over the nodes to check every child index
+ * and payload range, and returns NULL for a truncated or corrupt file.
+ *
+ * The image uses the byte order of the machine that wrote it.
+ */
+typedef struct _bodhi_snapshot_t bodhi_snapshot_t;
+
+/* returns the bytes to store for a value and sets len, may return NULL */
+typedef const void *(*bodhi_snapshot_val_fn)(void *data, size_t *len, void *udata);
+typedef void (snapshot_loop_cb)(uint32_t key, const void *val, size_t len, void *udata);
+
+int bodhi_snapshot_write(bodhi_patricia_t *trie, const char *path, bodhi_snapshot_val_fn fn, void *udata);
+
+bodhi_snapshot_t *bodhi_snapshot_open(const char *path);
+void bodhi_snapshot_close(bodhi_snapshot_t *snap);
+size_t bodhi_snapshot_size(bodhi_snapshot_t *snap);
+const void *bodhi_snapshot_find_val(bodhi_snapshot_t *snap, uint32_t key, size_t *len);
+/* finds the stored key sharing the most leading bits with key */
+const void *bodhi_snapshot_lpm(bodhi_snapshot_t *snap, uint32_t key, uint32_t *match, size_t *len);
+/* visits every key in ascending order */
+void bodhi_snapshot_loop(bodhi_snapshot_t *snap, snapshot_loop_cb cb, void *udata);
+
+#endif
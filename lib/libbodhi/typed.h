@@ -0,0 +1,371 @@
+/*
+ * typed.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BODHI_TYPED_H
+#define BODHI_TYPED_H
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Typed containers generated by macros, for when the function pointers and
+ * void* keys of bodhi_hmap_t and bodhi_list_t cost too much. Keys and values
+ * are stored inline and hash, eq and cmp are expanded in place, so the
+ * compiler can inline them. Everything is static to the including file.
+ *
+ *   BODHI_HMAP_DECLARE(name, key_t, val_t, hash, eq)
+ *     an open addressing hash map, hash(k) giving a size_t and eq(a, b)
+ *     non-zero when two keys are equal
+ *
+ *   BODHI_LIST_DECLARE(name, T, cmp)
+ *     a doubly linked list in the layout of bodhi_list_t holding T by
+ *     value, cmp(a, b) ordering two values like strcmp
+ */
+
+#if defined(__GNUC__)
+#define BODHI_INLINE static __inline__
+#define BODHI_UNUSED __attribute__((unused))
+#else
+#define BODHI_INLINE static
+#define BODHI_UNUSED
+#endif
+
+/* the splitmix64 finalizer, a good default hash for integer keys */
+BODHI_INLINE BODHI_UNUSED size_t bodhi_hash_u64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return (size_t) (x ^ (x >> 31));
+}
+
+#define BODHI_EQ(a, b) ((a) == (b))
+#define BODHI_CMP(a, b) ((a) < (b) ? -1 : (a) > (b))
+
+#define BODHI_SLOT_EMPTY 0
+#define BODHI_SLOT_FULL 1
+#define BODHI_SLOT_DELETED 2
+
+/*
+ * Linear probing over a power of two table. Deleted slots are left as
+ * tombstones that insert reuses; the table is rebuilt once live entries
+ * and tombstones fill three quarters of it.
+ */
+#define BODHI_HMAP_DECLARE(name, key_t, val_t, hash, eq)                        \
+typedef struct name##_s {                                                       \
+    size_t alloc;                                                               \
+    size_t size;                                                                \
+    size_t used;                                                                \
+    unsigned char *flags;                                                       \
+    key_t *keys;                                                                \
+    val_t *vals;                                                                \
+} name##_t;                                                                     \
+                                                                                \
+BODHI_INLINE BODHI_UNUSED name##_t *name##_new(void) {                          \
+    return calloc(1, sizeof(name##_t));                                         \
+}                                                                               \
+                                                                                \
+BODHI_INLINE BODHI_UNUSED void name##_free(name##_t *map) {                     \
+    if (map != NULL) {                                                          \
+        free(map->flags);                                                       \
+        free(map->keys);                                                        \
+        free(map->vals);                                                        \
+        free(map);                                                              \
+    }                                                                           \
+}                                                                               \
+                                                                                \
+BODHI_INLINE BODHI_UNUSED size_t name##_size(const name##_t *map) {             \
+    return map->size;                                                           \
+}                                                                               \
+                                                                                \
+/* the slot holding key, or alloc if there is none */                          \
+BODHI_INLINE BODHI_UNUSED size_t name##_find(const name##_t *map, key_t key) {  \
+    size_t mask = map->alloc - 1;                                               \
+    size_t i;                                                                   \
+                                                                                \
+    if (map->alloc == 0) {                                                      \
+        return 0;                                                               \
+    }                                                                           \
+                                                                                \
+    for (i = (size_t) (hash(key)) & mask; ; i = (i + 1) & mask) {               \
+        if (map->flags[i] == BODHI_SLOT_EMPTY) {                                \
+            return map->alloc;                                                  \
+        }                                                                       \
+        if (map->flags[i] == BODHI_SLOT_FULL && eq(map->keys[i], key)) {        \
+            return i;                                                           \
+        }                                                                       \
+    }                                                                           \
+}                                                                               \
+                                                                                \
+BODHI_INLINE BODHI_UNUSED int name##_resize(name##_t *map, size_t alloc) {      \
+    unsigned char *flags = calloc(alloc, 1);                                    \
+    key_t *keys = malloc(alloc * sizeof(key_t));                                \
+    val_t *vals = malloc(alloc * sizeof(val_t));                                \
+    size_t mask = alloc - 1;                                                    \
+    size_t i, j;                                                                \
+                                                                                \
+    if (flags == NULL || keys == NULL || vals == NULL) {                        \
+        free(flags);                                                            \
+        free(keys);                                                             \
+        free(vals);                                                             \
+        return -1;                                                              \
+    }                                                                           \
+                                                                                \
+    for (i = 0; i < map->alloc; i++) {                                          \
+        if (map->flags[i] != BODHI_SLOT_FULL) {                                 \
+            continue;                                                           \
+        }                                                                       \
+        for (j = (size_t) (hash(map->keys[i])) & mask;                          \
+             flags[j] != BODHI_SLOT_EMPTY; j = (j + 1) & mask);                 \
+        flags[j] = BODHI_SLOT_FULL;                                             \
+        keys[j] = map->keys[i];                                                 \
+        vals[j] = map->vals[i];                                                 \
+    }                                                                           \
+                                                                                \
+    free(map->flags);                                                           \
+    free(map->keys);                                                            \
+    free(map->vals);                                                            \
+    map->flags = flags;                                                         \
+    map->keys = keys;                                                           \
+    map->vals = vals;                                                           \
+    map->alloc = alloc;                                                         \
+    map->used = map->size;                                                      \
+    return 0;                                                                   \
+}                                                                               \
+                                                                                \
+/* makes room for n entries without further resizing */                        \
+BODHI_INLINE BODHI_UNUSED int name##_reserve(name##_t *map, size_t n) {         \
+    size_t alloc = 16;                                                          \
+                                                                                \
+    while (alloc / 4 * 3 < n) {                                                 \
+        alloc *= 2;                                                             \
+    }                                                                           \
+                                                                                \
+    return alloc > map->alloc ? name##_resize(map, alloc) : 0;                  \
+}                                                                               \
+                                                                                \
+/* 0 when added, 1 when the key is already there (left untouched), -1 */       \
+BODHI_INLINE BODHI_UNUSED int name##_insert(name##_t *map, key_t key, val_t val) { \
+    size_t mask, i, tomb;                                                       \
+                                                                                \
+    if (map->used + 1 > map->alloc / 4 * 3) {                                  \
+        /* mostly tombstones: rebuild at the same size */                       \
+        size_t alloc = map->size + 1 > map->alloc / 2 ? map->alloc * 2 : map->alloc; \
+        if (name##_resize(map, alloc < 16 ? 16 : alloc) != 0) {                 \
+            return -1;                                                          \
+        }                                                                       \
+    }                                                                           \
+                                                                                \
+    mask = map->alloc - 1;                                                      \
+    tomb = map->alloc;                                                          \
+    for (i = (size_t) (hash(key)) & mask; ; i = (i + 1) & mask) {               \
+        if (map->flags[i] == BODHI_SLOT_EMPTY) {                                \
+            break;                                                              \
+        }                                                                       \
+        if (map->flags[i] == BODHI_SLOT_DELETED) {                              \
+            if (tomb == map->alloc) {                                           \
+                tomb = i;                                                       \
+            }                                                                   \
+        } else if (eq(map->keys[i], key)) {                                     \
+            return 1;                                                           \
+        }                                                                       \
+    }                                                                           \
+                                                                                \
+    if (tomb != map->alloc) {                                                   \
+        i = tomb;                                                               \
+    } else {                                                                    \
+        map->used++;                                                            \
+    }                                                                           \
+                                                                                \
+    map->flags[i] = BODHI_SLOT_FULL;                                            \
+    map->keys[i] = key;                                                         \
+    map->vals[i] = val;                                                         \
+    map->size++;                                                                \
+    return 0;                                                                   \
+}                                                                               \
+                                                                                \
+/* a pointer to the value stored for key, or NULL */                           \
+BODHI_INLINE BODHI_UNUSED val_t *name##_get(const name##_t *map, key_t key) {   \
+    size_t i = name##_find(map, key);                                           \
+    return i < map->alloc ? &map->vals[i] : NULL;                               \
+}                                                                               \
+                                                                                \
+/* 0 when removed (the value is written to retval if given), 1 if missing */   \
+BODHI_INLINE BODHI_UNUSED int name##_delete(name##_t *map, key_t key, val_t *retval) { \
+    size_t i = name##_find(map, key);                                           \
+                                                                                \
+    if (i >= map->alloc) {                                                      \
+        return 1;                                                               \
+    }                                                                           \
+    if (retval != NULL) {                                                       \
+        *retval = map->vals[i];                                                 \
+    }                                                                           \
+    map->flags[i] = BODHI_SLOT_DELETED;                                         \
+    map->size--;                                                                \
+    return 0;                                                                   \
+}                                                                               \
+                                                                                \
+/* the first slot in use at or after i, or alloc; for walking the map */       \
+BODHI_INLINE BODHI_UNUSED size_t name##_next(const name##_t *map, size_t i) {   \
+    while (i < map->alloc && map->flags[i] != BODHI_SLOT_FULL) {                \
+        i++;                                                                    \
+    }                                                                           \
+    return i;                                                                   \
+}
+
+#define BODHI_LIST_DECLARE(name, T, cmp)                                        \
+typedef struct name##_s {                                                       \
+    T data;                                                                     \
+    struct name##_s *prev;                                                      \
+    struct name##_s *next;                                                      \
+} name##_t;                                                                     \
+                                                                                \
+BODHI_INLINE BODHI_UNUSED void name##_free(name##_t *list) {                    \
+    name##_t *next;                                                             \
+                                                                                \
+    for (; list != NULL; list = next) {                                         \
+        next = list->next;                                                      \
+        free(list);                                                             \
+    }                                                                           \
+}                                                                               \
+                                                                                \
+/* appends data, returning the new head (NULL only if list was empty and    */ \
+/* the allocation failed)                                                   */ \
+BODHI_INLINE BODHI_UNUSED name##_t *name##_add(name##_t *list, T data) {        \
+    name##_t *node = malloc(sizeof(name##_t));                                  \
+                                                                                \
+    if (node == NULL) {                                                         \
+        return list;                                                            \
+    }                                                                           \
+                                                                                \
+    node->data = data;                                                          \
+    node->next = NULL;                                                          \
+    if (list == NULL) {                                                         \
+        node->prev = node;                                                      \
+        return node;                                                            \
+    }                                                                           \
+                                                                                \
+    node->prev = list->prev;                                                    \
+    list->prev->next = node;                                                    \
+    list->prev = node;                                                          \
+    return list;                                                                \
+}                                                                               \
+                                                                                \
+BODHI_INLINE BODHI_UNUSED size_t name##_count(const name##_t *list) {           \
+    size_t n = 0;                                                               \
+                                                                                \
+    for (; list != NULL; list = list->next) {                                   \
+        n++;                                                                    \
+    }                                                                           \
+    return n;                                                                   \
+}                                                                               \
+                                                                                \
+BODHI_INLINE BODHI_UNUSED name##_t *name##_find(name##_t *list, T needle) {     \
+    for (; list != NULL; list = list->next) {                                   \
+        if (cmp(list->data, needle) == 0) {                                     \
+            return list;                                                        \
+        }                                                                       \
+    }                                                                           \
+    return NULL;                                                                \
+}                                                                               \
+                                                                                \
+/* unlinks item, returning the new head; item is not freed */                  \
+BODHI_INLINE BODHI_UNUSED name##_t *name##_remove_item(name##_t *list, name##_t *item) { \
+    if (item == list) {                                                         \
+        list = item->next;                                                      \
+        if (list != NULL) {                                                     \
+            list->prev = item->prev;                                            \
+        }                                                                       \
+    } else {                                                                    \
+        item->prev->next = item->next;                                          \
+        if (item->next != NULL) {                                               \
+            item->next->prev = item->prev;                                      \
+        } else {                                                                \
+            list->prev = item->prev;                                            \
+        }                                                                       \
+    }                                                                           \
+                                                                                \
+    item->next = NULL;                                                          \
+    item->prev = item;                                                          \
+    return list;                                                                \
+}                                                                               \
+                                                                                \
+/* merges two sorted runs linked through next only, a first on ties         */ \
+BODHI_INLINE BODHI_UNUSED name##_t *name##_merge(name##_t *a, name##_t *b) {    \
+    name##_t head;                                                              \
+    name##_t *tail = &head;                                                     \
+                                                                                \
+    while (a != NULL && b != NULL) {                                            \
+        if (cmp(a->data, b->data) <= 0) {                                       \
+            tail->next = a;                                                     \
+            a = a->next;                                                        \
+        } else {                                                                \
+            tail->next = b;                                                     \
+            b = b->next;                                                        \
+        }                                                                       \
+        tail = tail->next;                                                      \
+    }                                                                           \
+    tail->next = a != NULL ? a : b;                                             \
+    return head.next;                                                           \
+}                                                                               \
+                                                                                \
+/*                                                                          */ \
+/* Stable merge sort in one pass over the list: bin k holds a sorted run of */ \
+/* 2^k nodes and every node is carried up through the full bins, like      */ \
+/* counting in binary. prev is rebuilt at the end.                          */ \
+/*                                                                          */ \
+BODHI_INLINE BODHI_UNUSED name##_t *name##_msort(name##_t *list) {              \
+    name##_t *bins[64];                                                         \
+    name##_t *carry;                                                            \
+    name##_t *prev = NULL;                                                      \
+    int used = 0;                                                               \
+    int k;                                                                      \
+                                                                                \
+    while (list != NULL) {                                                      \
+        carry = list;                                                           \
+        list = list->next;                                                      \
+        carry->next = NULL;                                                     \
+                                                                                \
+        for (k = 0; k < used && bins[k] != NULL; k++) {                         \
+            carry = name##_merge(bins[k], carry);                               \
+            bins[k] = NULL;                                                     \
+        }                                                                       \
+        if (k == used) {                                                        \
+            used++;                                                             \
+        }                                                                       \
+        bins[k] = carry;                                                        \
+    }                                                                           \
+                                                                                \
+    /* higher bins hold the earlier nodes */                                    \
+    carry = NULL;                                                               \
+    for (k = 0; k < used; k++) {                                                \
+        if (bins[k] != NULL) {                                                  \
+            carry = name##_merge(bins[k], carry);                               \
+        }                                                                       \
+    }                                                                           \
+                                                                                \
+    for (list = carry; list != NULL; list = list->next) {                       \
+        list->prev = prev;                                                      \
+        prev = list;                                                            \
+    }                                                                           \
+    if (carry != NULL) {                                                        \
+        carry->prev = prev;                                                     \
+    }                                                                           \
+    return carry;                                                               \
+}
+
+#endif
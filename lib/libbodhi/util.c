@@ -17,3 +17,35 @@
  */
 
 #include "util.h"
+
+#ifdef BODHI_STATS
+static unsigned int _bodhi_stat_next;
+static __thread unsigned int _bodhi_stat_shard; /* shard + 1, 0 until first use */
+
+unsigned int bodhi_stat_shard(void) {
+    if (_bodhi_stat_shard == 0) {
+        _bodhi_stat_shard = ATOMIC_FETCH_ADD(&_bodhi_stat_next, 1) % STAT_SHARDS + 1;
+    }
+
+    return _bodhi_stat_shard - 1;
+}
+
+uint64_t bodhi_stat_sum(bodhi_stat_shard_t *c) {
+    uint64_t sum = 0;
+    unsigned int i;
+
+    for (i = 0; i < STAT_SHARDS; i++) {
+        sum += ATOMIC_LOAD_RELAXED(&c[i].v);
+    }
+
+    return sum;
+}
+
+void bodhi_stat_clear(bodhi_stat_shard_t *c) {
+    unsigned int i;
+
+    for (i = 0; i < STAT_SHARDS; i++) {
+        ATOMIC_STORE_RELAXED(&c[i].v, 0);
+    }
+}
+#endif
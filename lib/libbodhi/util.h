@@ -19,10 +19,67 @@
 #ifndef BODHI_UTIL_H
 #define BODHI_UTIL_H
 
+#include <inttypes.h>
+
 #define MALLOC(p, s, action) do { p = malloc(s); if (p == NULL) { action; } } while(0)
 #define CALLOC(p, l, s, action) do { p = calloc(l, s); if (p == NULL) { action; } } while(0)
 #define FREE(p) do { if (p != NULL) { free(p); p = NULL; } } while(0)
 
 #define ASSERT(cond, action) do { if (!(cond)) { action; } } while(0)
 
+/* instrumentation that only exists in BODHI_STATS builds */
+#ifdef BODHI_STATS
+#define STATS(stmt) do { stmt; } while(0)
+#else
+#define STATS(stmt) do { } while(0)
+#endif
+
+/*
+ * bit twiddling and atomics map straight onto compiler builtins. The
+ * concurrent structures and the pool behind every parallel entry point
+ * need real ordering, so there is no plain C fallback; see README.
+ */
+#if !defined(__GNUC__) || !defined(__ATOMIC_RELAXED)
+#error "bodhi needs gcc >= 4.7 or clang for its __builtin and __atomic intrinsics"
+#endif
+
+#define POPCOUNT64(x) ((unsigned int) __builtin_popcountll(x))
+#define CLZ32(x) ((x) == 0 ? 32u : (unsigned int) __builtin_clz(x))
+#define CLZ64(x) ((x) == 0 ? 64u : (unsigned int) __builtin_clzll(x))
+#define CTZ32(x) ((x) == 0 ? 32u : (unsigned int) __builtin_ctz(x))
+#define CTZ64(x) ((x) == 0 ? 64u : (unsigned int) __builtin_ctzll(x))
+#define PREFETCH(p) __builtin_prefetch(p)
+
+#define ATOMIC_LOAD(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define ATOMIC_XCHG(p, v) __atomic_exchange_n(p, v, __ATOMIC_ACQ_REL)
+#define ATOMIC_CAS(p, e, v) __atomic_compare_exchange_n(p, e, v, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define ATOMIC_LOAD_RELAXED(p) __atomic_load_n(p, __ATOMIC_RELAXED)
+#define ATOMIC_STORE_RELAXED(p, v) __atomic_store_n(p, v, __ATOMIC_RELAXED)
+#define ATOMIC_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define ATOMIC_FETCH_ADD(p, v) __atomic_fetch_add(p, v, __ATOMIC_RELAXED)
+#define ATOMIC_SUB_FETCH(p, v) __atomic_sub_fetch(p, v, __ATOMIC_ACQ_REL)
+
+#ifdef BODHI_STATS
+/*
+ * A process wide event counter split over STAT_SHARDS cache lines. Every
+ * thread adds to the line bodhi_stat_shard gave it, so busy threads do not
+ * fight over one line; reading sums them all.
+ */
+#define STAT_SHARDS 16
+
+typedef struct _bodhi_stat_shard_t {
+    uint64_t v;
+    char pad[64 - sizeof(uint64_t)];
+} __attribute__((aligned(64))) bodhi_stat_shard_t;
+
+typedef bodhi_stat_shard_t bodhi_stat_counter_t[STAT_SHARDS];
+
+#define STAT_ADD(c, n) ((void) ATOMIC_FETCH_ADD(&(c)[bodhi_stat_shard()].v, (uint64_t) (n)))
+
+unsigned int bodhi_stat_shard(void);
+uint64_t bodhi_stat_sum(bodhi_stat_shard_t *c);
+void bodhi_stat_clear(bodhi_stat_shard_t *c);
+#endif
+
 #endif
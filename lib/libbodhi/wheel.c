@@ -0,0 +1,357 @@
+/*
+ * wheel.c
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include "heap.h"
+#include "util.h"
+#include "wheel.h"
+
+#define LEVELS 4
+#define SLOT_BITS 6
+#define SLOTS (1 << SLOT_BITS)
+#define SLOT_MASK (SLOTS - 1)
+#define RANGE ((uint64_t) 1 << (LEVELS * SLOT_BITS))
+
+/* slots are circular lists around a sentinel, so unlinking needs no head */
+typedef struct _bodhi_timer_link_t {
+    struct _bodhi_timer_link_t *prev;
+    struct _bodhi_timer_link_t *next;
+} bodhi_timer_link_t;
+
+struct _bodhi_timer_t {
+    bodhi_timer_link_t link;
+    uint64_t expires;
+    void *data;
+    /* set while the timer waits in the heap beyond the wheel's range */
+    bodhi_heap_node_t *far;
+    /* where it is linked, level LEVELS being the due list */
+    unsigned char level;
+    unsigned char slot;
+};
+
+/*
+ * A level l timer sits in the slot picked by bits 6l..6l+5 of its expiry
+ * and moves down a level each time the ticks reach the start of that
+ * slot's span, until it lands in level 0 where the slot is its exact tick.
+ */
+struct _bodhi_wheel_t {
+    uint64_t now;
+    size_t size;
+    size_t in_wheel;
+
+    /* a bit per non-empty slot, so advancing can jump over empty ticks */
+    uint64_t occupied[LEVELS];
+    bodhi_timer_link_t slots[LEVELS][SLOTS];
+    /* added at or before now, fired by the next advance */
+    bodhi_timer_link_t due;
+    bodhi_heap_t *far;
+};
+
+static void _link_init(bodhi_timer_link_t *head) {
+    head->prev = head;
+    head->next = head;
+}
+
+static void _link_append(bodhi_timer_link_t *head, bodhi_timer_link_t *link) {
+    link->prev = head->prev;
+    link->next = head;
+    head->prev->next = link;
+    head->prev = link;
+}
+
+static void _link_remove(bodhi_timer_link_t *link) {
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+}
+
+/* moves everything in from onto the empty list to */
+static void _link_take(bodhi_timer_link_t *to, bodhi_timer_link_t *from) {
+    if (from->next == from) {
+        _link_init(to);
+        return;
+    }
+
+    to->next = from->next;
+    to->prev = from->prev;
+    to->next->prev = to;
+    to->prev->next = to;
+    _link_init(from);
+}
+
+static int _timer_cmp(const void *a, const void *b) {
+    const bodhi_timer_t *x = a;
+    const bodhi_timer_t *y = b;
+    return x->expires < y->expires ? -1 : x->expires > y->expires;
+}
+
+bodhi_wheel_t *bodhi_wheel_new(uint64_t now) {
+    bodhi_wheel_t *ret;
+    int l, s;
+
+    CALLOC(ret, 1, sizeof(bodhi_wheel_t), return NULL);
+    ret->far = bodhi_heap_new(_timer_cmp, 0);
+    if (ret->far == NULL) {
+        free(ret);
+        return NULL;
+    }
+
+    ret->now = now;
+    for (l = 0; l < LEVELS; l++) {
+        for (s = 0; s < SLOTS; s++) {
+            _link_init(&ret->slots[l][s]);
+        }
+    }
+    _link_init(&ret->due);
+
+    return ret;
+}
+
+static void _free_list(bodhi_timer_link_t *head, bodhi_list_free_fn fn) {
+    bodhi_timer_link_t *link, *next;
+
+    for (link = head->next; link != head; link = next) {
+        bodhi_timer_t *timer = (bodhi_timer_t *) link;
+
+        next = link->next;
+        if (fn != NULL) {
+            fn(timer->data);
+        }
+        free(timer);
+    }
+}
+
+void bodhi_wheel_free(bodhi_wheel_t *wheel, bodhi_list_free_fn fn) {
+    bodhi_timer_t *timer;
+    int l, s;
+
+    ASSERT(wheel != NULL, return);
+
+    for (l = 0; l < LEVELS; l++) {
+        for (s = 0; s < SLOTS; s++) {
+            _free_list(&wheel->slots[l][s], fn);
+        }
+    }
+    _free_list(&wheel->due, fn);
+
+    while ((timer = bodhi_heap_pop(wheel->far)) != NULL) {
+        if (fn != NULL) {
+            fn(timer->data);
+        }
+        free(timer);
+    }
+
+    bodhi_heap_free(wheel->far, NULL);
+    free(wheel);
+}
+
+static int _place(bodhi_wheel_t *wheel, bodhi_timer_t *timer) {
+    uint64_t delta;
+    unsigned int level;
+
+    if (timer->expires <= wheel->now) {
+        _link_append(&wheel->due, &timer->link);
+        timer->level = LEVELS;
+        wheel->in_wheel++;
+        return 0;
+    }
+
+    delta = timer->expires - wheel->now;
+    if (delta >= RANGE) {
+        timer->far = bodhi_heap_push(wheel->far, timer);
+        return timer->far == NULL ? -1 : 0;
+    }
+
+    level = (63 - CLZ64(delta)) / SLOT_BITS;
+    timer->level = (unsigned char) level;
+    timer->slot = (unsigned char) ((timer->expires >> (level * SLOT_BITS)) & SLOT_MASK);
+    _link_append(&wheel->slots[level][timer->slot], &timer->link);
+    wheel->occupied[level] |= (uint64_t) 1 << timer->slot;
+    wheel->in_wheel++;
+    return 0;
+}
+
+bodhi_timer_t *bodhi_wheel_add(bodhi_wheel_t *wheel, uint64_t expires, void *data) {
+    bodhi_timer_t *timer;
+
+    ASSERT(wheel != NULL, return NULL);
+
+    CALLOC(timer, 1, sizeof(bodhi_timer_t), return NULL);
+    timer->expires = expires;
+    timer->data = data;
+
+    if (_place(wheel, timer) != 0) {
+        free(timer);
+        return NULL;
+    }
+
+    wheel->size++;
+    return timer;
+}
+
+void *bodhi_wheel_cancel(bodhi_wheel_t *wheel, bodhi_timer_t *timer) {
+    void *ret;
+
+    ASSERT(wheel != NULL && timer != NULL, return NULL);
+
+    if (timer->far != NULL) {
+        bodhi_heap_remove(wheel->far, timer->far);
+    } else {
+        _link_remove(&timer->link);
+        wheel->in_wheel--;
+        if (timer->level < LEVELS) {
+            bodhi_timer_link_t *head = &wheel->slots[timer->level][timer->slot];
+            if (head->next == head) {
+                wheel->occupied[timer->level] &= ~((uint64_t) 1 << timer->slot);
+            }
+        }
+    }
+
+    wheel->size--;
+    ret = timer->data;
+    free(timer);
+    return ret;
+}
+
+/*
+ * The first tick after now with work to do: a level 0 slot to fire or the
+ * start of a higher slot's span, where it cascades.
+ */
+static uint64_t _next_tick(bodhi_wheel_t *wheel, uint64_t limit) {
+    uint64_t best = limit;
+    int level;
+
+    for (level = 0; level < LEVELS; level++) {
+        uint64_t bits = wheel->occupied[level];
+        uint64_t cur = wheel->now >> (level * SLOT_BITS);
+        unsigned int r = (unsigned int) ((cur + 1) & SLOT_MASK);
+        uint64_t tick;
+
+        if (bits == 0) {
+            continue;
+        }
+
+        /* rotate so bit 0 is the slot after the current one */
+        bits = r == 0 ? bits : bits >> r | bits << (64 - r);
+        tick = (cur + 1 + CTZ64(bits)) << (level * SLOT_BITS);
+        if (tick < best) {
+            best = tick;
+        }
+    }
+
+    return best;
+}
+
+static size_t _fire(bodhi_wheel_t *wheel, bodhi_timer_link_t *head, bodhi_timer_cb cb, void *udata) {
+    bodhi_timer_link_t list;
+    size_t fired = 0;
+
+    /* timers the callbacks add go to the real slots, not this batch */
+    _link_take(&list, head);
+    while (list.next != &list) {
+        bodhi_timer_t *timer = (bodhi_timer_t *) list.next;
+        void *data = timer->data;
+
+        _link_remove(&timer->link);
+        wheel->in_wheel--;
+        wheel->size--;
+        free(timer);
+
+        if (cb != NULL) {
+            cb(data, udata);
+        }
+        fired++;
+    }
+
+    return fired;
+}
+
+static void _cascade(bodhi_wheel_t *wheel, bodhi_timer_link_t *head) {
+    bodhi_timer_link_t list;
+
+    _link_take(&list, head);
+    while (list.next != &list) {
+        bodhi_timer_t *timer = (bodhi_timer_t *) list.next;
+
+        _link_remove(&timer->link);
+        wheel->in_wheel--;
+        _place(wheel, timer);
+    }
+}
+
+size_t bodhi_wheel_advance(bodhi_wheel_t *wheel, uint64_t now, bodhi_timer_cb cb, void *udata) {
+    size_t fired = 0;
+
+    ASSERT(wheel != NULL, return 0);
+
+    while (wheel->due.next != &wheel->due) {
+        fired += _fire(wheel, &wheel->due, cb, udata);
+    }
+
+    while (wheel->now < now) {
+        bodhi_timer_t *timer;
+        uint64_t t, next;
+        int level;
+
+        /* jump over the ticks where no slot fires or cascades and no far timer comes in range */
+        next = _next_tick(wheel, now);
+        timer = bodhi_heap_peek(wheel->far);
+        if (timer != NULL && timer->expires - RANGE + 1 < next) {
+            next = timer->expires - RANGE + 1;
+        }
+        if (next - 1 > wheel->now) {
+            wheel->now = next - 1;
+        }
+
+        t = ++wheel->now;
+
+        while ((timer = bodhi_heap_peek(wheel->far)) != NULL && timer->expires - t < RANGE) {
+            bodhi_heap_pop(wheel->far);
+            timer->far = NULL;
+            _place(wheel, timer);
+        }
+
+        for (level = LEVELS - 1; level > 0; level--) {
+            if ((t & (((uint64_t) 1 << (level * SLOT_BITS)) - 1)) == 0) {
+                int slot = (int) ((t >> (level * SLOT_BITS)) & SLOT_MASK);
+
+                wheel->occupied[level] &= ~((uint64_t) 1 << slot);
+                _cascade(wheel, &wheel->slots[level][slot]);
+            }
+        }
+
+        wheel->occupied[0] &= ~((uint64_t) 1 << (t & SLOT_MASK));
+        fired += _fire(wheel, &wheel->slots[0][t & SLOT_MASK], cb, udata);
+        while (wheel->due.next != &wheel->due) {
+            fired += _fire(wheel, &wheel->due, cb, udata);
+        }
+    }
+
+    return fired;
+}
+
+size_t bodhi_wheel_size(bodhi_wheel_t *wheel) {
+    ASSERT(wheel != NULL, return 0);
+    return wheel->size;
+}
+
+uint64_t bodhi_wheel_now(bodhi_wheel_t *wheel) {
+    ASSERT(wheel != NULL, return 0);
+    return wheel->now;
+}
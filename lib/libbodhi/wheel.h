@@ -0,0 +1,54 @@
+/*
+ * wheel.h
+ *
+ * Copyright (c) 2018, Mark Weiman <mark.weiman@markzz.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BODHI_WHEEL_H
+#define BODHI_WHEEL_H
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include <libbodhi/list.h>
+
+/*
+ * A hierarchical timer wheel: four levels of 64 slots cover the next 2^24
+ * ticks with O(1) add and cancel, timers further out wait in a
+ * bodhi_heap_t until they come into range. Ticks are whatever unit the
+ * caller advances the wheel in.
+ *
+ * bodhi_wheel_advance fires every timer that expires at or before now,
+ * tick by tick, jumping over ticks with nothing to do, and returns how
+ * many fired. A timer is released before its callback runs, so the
+ * callback may add new timers but must not cancel the one it was called
+ * for.
+ */
+typedef struct _bodhi_wheel_t bodhi_wheel_t;
+typedef struct _bodhi_timer_t bodhi_timer_t;
+
+typedef void (*bodhi_timer_cb)(void *data, void *udata);
+
+bodhi_wheel_t *bodhi_wheel_new(uint64_t now);
+/* pending timers are dropped, fn is called on their data if not NULL */
+void bodhi_wheel_free(bodhi_wheel_t *wheel, bodhi_list_free_fn fn);
+bodhi_timer_t *bodhi_wheel_add(bodhi_wheel_t *wheel, uint64_t expires, void *data);
+/* returns the timer's data, the handle is invalid afterwards */
+void *bodhi_wheel_cancel(bodhi_wheel_t *wheel, bodhi_timer_t *timer);
+size_t bodhi_wheel_advance(bodhi_wheel_t *wheel, uint64_t now, bodhi_timer_cb cb, void *udata);
+size_t bodhi_wheel_size(bodhi_wheel_t *wheel);
+uint64_t bodhi_wheel_now(bodhi_wheel_t *wheel);
+
+#endif